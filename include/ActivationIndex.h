@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+
+namespace llmvis {
+
+// One entry of a neuron's top-K list: how strongly it fired and on which context
+struct TopActivation {
+    float activation;
+    uint32_t contextId;
+};
+
+// Offline pass that streams per-layer activations for a corpus and keeps the
+// top-K activating contexts of every neuron. Each worker thread owns its own
+// shard of bounded min-heaps; shards are merged once all contexts are consumed.
+class ActivationIndexBuilder {
+public:
+    // Fills layerActivations[layer] with the activations of every neuron for one context
+    using ActivationSource = std::function<void(int threadIndex, uint32_t contextId,
+                                                std::vector<std::vector<float>>& layerActivations)>;
+
+    ActivationIndexBuilder(const std::vector<int>& layerSizes, int topK);
+    ~ActivationIndexBuilder();
+
+    void build(uint32_t contextCount, const ActivationSource& source, int threadCount);
+    void setContextText(uint32_t contextId, const std::string& text);
+
+    bool write(const std::string& filePath) const;
+
+private:
+    struct Shard {
+        std::vector<TopActivation> heaps;   // topK slots per neuron
+        std::vector<uint32_t> heapSizes;    // filled slots per neuron
+    };
+
+    std::vector<int> m_layerSizes;
+    std::vector<uint64_t> m_layerOffsets;   // first global neuron index of each layer
+    uint64_t m_neuronCount;
+    int m_topK;
+    uint32_t m_contextCount;
+
+    std::vector<TopActivation> m_merged;    // topK sorted entries per neuron
+    std::vector<std::string> m_contextTexts;
+
+    void pushToShard(Shard& shard, uint64_t neuron, float activation, uint32_t contextId) const;
+    void mergeShards(std::vector<Shard>& shards);
+};
+
+// Read-only view of an index written by ActivationIndexBuilder. The file is
+// memory-mapped, so a query is just pointer arithmetic into the mapping.
+class ActivationIndex {
+public:
+    ActivationIndex();
+    ~ActivationIndex();
+
+    bool open(const std::string& filePath);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    // Entries are sorted by descending activation; count excludes unused slots
+    const TopActivation* query(int layerIndex, int neuronIndex, int& count) const;
+    std::string getContextText(uint32_t contextId) const;
+
+    int getTopK() const { return m_topK; }
+    int getLayerCount() const { return static_cast<int>(m_layerSizes.size()); }
+
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+    std::vector<unsigned char> m_fallbackBuffer; // used where mmap is unavailable
+
+    int m_topK;
+    uint32_t m_contextCount;
+    std::vector<int> m_layerSizes;
+    std::vector<uint64_t> m_layerOffsets;
+    const TopActivation* m_entries;
+    const uint64_t* m_textOffsets;
+    const char* m_text;
+};
+
+} // namespace llmvis
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+namespace llmvis {
+
+struct PyramidEntry {
+    float min;
+    float max;
+    float mean;
+};
+
+// Min/max/mean reduction of a 1-D activation vector, like mip levels: entry i
+// of level l summarizes values [i << l, (i + 1) << l), and the top level is a
+// single entry. Updates only recompute the ancestors of values that changed,
+// so a wide layer where a few neurons move costs a few entries per level
+class ActivationPyramid {
+public:
+    ActivationPyramid();
+
+    // Brings every level in line with values and returns how many of them
+    // changed. A different length rebuilds the whole pyramid
+    int update(const std::vector<float>& values);
+    void clear();
+
+    bool empty() const { return m_valueCount == 0; }
+    int getValueCount() const { return m_valueCount; }
+    int getLevelCount() const { return static_cast<int>(m_levels.size()); }
+    const std::vector<PyramidEntry>& getLevel(int level) const { return m_levels[level]; }
+
+    // Signed value of larger magnitude in an entry: reducing by it keeps a
+    // single spiking neuron visible at every level
+    static float getExtreme(const PyramidEntry& entry) {
+        return -entry.min > entry.max ? entry.min : entry.max;
+    }
+
+private:
+    struct Range {
+        int begin;
+        int end;
+    };
+
+    int m_valueCount;
+    std::vector<std::vector<PyramidEntry>> m_levels;
+    std::vector<Range> m_dirty;
+    std::vector<Range> m_parentDirty;
+
+    void rebuild(const std::vector<float>& values);
+    void reduceEntry(int level, int index);
+};
+
+} // namespace llmvis
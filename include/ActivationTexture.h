@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+
+namespace llmvis {
+
+// One layer's activations as a single-channel float texture, laid out row by
+// row over a columns x rows grid. Uploads go through a pair of pixel buffer
+// objects used in turn, so a frame never waits on the previous upload, and
+// only the rows that differ from the last upload are sent
+class ActivationTexture {
+public:
+    ActivationTexture();
+    ~ActivationTexture();
+
+    // Reallocates (to zeros) when the value count or grid width changes;
+    // returns whether it did
+    bool resize(int valueCount, int columns);
+    // Uploads the rows of values that changed since the last call and
+    // returns how many rows were sent
+    int update(const std::vector<float>& values);
+
+    GLuint getTexture() const { return m_texture; }
+    int getValueCount() const { return m_valueCount; }
+    int getColumns() const { return m_columns; }
+    // Largest magnitude uploaded so far, for normalizing the colormap
+    float getValueRange() const { return m_valueRange; }
+
+private:
+    struct RowRun {
+        int firstRow;
+        int rowCount;
+    };
+
+    GLuint m_texture;
+    GLuint m_pixelBuffers[2];
+    int m_nextPixelBuffer;
+
+    int m_valueCount;
+    int m_columns;
+    int m_rows;
+    float m_valueRange;
+
+    std::vector<float> m_uploaded;   // columns x rows, what the texture holds
+    std::vector<RowRun> m_runs;
+};
+
+} // namespace llmvis
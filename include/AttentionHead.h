@@ -1,13 +1,15 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include "AttentionStorage.h"
 
 namespace llmvis {
 
 class AttentionHead {
 public:
-    AttentionHead(int id, int dimensions);
+    AttentionHead(int id, int dimensions, unsigned int seed = 0);
     ~AttentionHead();
     
     void update(float deltaTime);
@@ -15,8 +17,44 @@ public:
                           const std::vector<float>& keyInput,
                           const std::vector<float>& valueInput);
     
+    // Incremental decode step: projects one token, caches its key/value and
+    // attends it over every cached position (causal by construction)
+    void appendToken(const float* queryInput, const float* keyInput, const float* valueInput);
+    void resetSequence();
+    int getSequenceLength() const { return m_sequenceLength; }
+    // Changes whenever the rows readers see are rewritten rather than
+    // appended to: a new sequence or a storage policy that changes them
+    unsigned int getSequenceId() const { return m_sequenceId; }
+    // Names what the query/key cache holds: a fresh id, unique across every
+    // head, each time the cache is rebuilt. Appending keeps it, as earlier
+    // rows never change, and storage policies do not touch the cache
+    uint64_t getCacheId() const { return m_cacheId; }
+    
+    // Reverse pass through the cached sequence. outputGradient and
+    // inputGradient point at this head's slice of row 0 and step by stride;
+    // query rows [rowBegin, rowEnd) carry gradient. The input gradient of
+    // rows [0, rowEnd) is accumulated into inputGradient
+    void backward(const float* outputGradient, float* inputGradient, int stride, int rowBegin, int rowEnd);
+    
+    // Output for the most recent token
     const std::vector<float>& getOutput() const;
-    const std::vector<std::vector<float>>& getAttentionWeights() const;
+    // Causal rows: row i holds the weights of query i over keys 0..i
+    const AttentionStorage& getAttentionWeights() const;
+    // Row of query over keys 0..query as stored, or recomputed from the
+    // query/key cache when the policy keeps nothing
+    void readAttentionRow(int query, float* weights) const;
+    // Adds scale times each weight of that row into sums[key]
+    void accumulateAttentionRow(int query, float scale, float* sums) const;
+    // Exact by default; lossy policies keep only each row's largest weights,
+    // and backward() then recomputes rows from the key cache. Switching away
+    // from a lossy policy rebuilds the rows from the cache as well
+    void setAttentionStoragePolicy(const AttentionStoragePolicy& policy);
+    // Exact weights of a size x size block of the causal matrix, computed from
+    // the query/key cache and each row's softmax normalizer whatever the
+    // storage policy. Block entry (r, c) is query queryBegin + r * stride over
+    // key keyBegin + c * stride, row-major; entries past the sequence or above
+    // the diagonal are zero
+    void computeAttentionTile(int queryBegin, int keyBegin, int stride, int size, float* weights) const;
     
     void setHighlighted(bool isHighlighted);
     bool isHighlighted() const;
@@ -30,7 +68,7 @@ private:
     bool m_isHighlighted;
     
     std::vector<float> m_output;
-    std::vector<std::vector<float>> m_attentionWeights;
+    AttentionStorage m_attentionWeights;
     
     // For visualization
     glm::vec3 m_position;
@@ -40,6 +78,30 @@ private:
     std::vector<std::vector<float>> m_queryMatrix;
     std::vector<std::vector<float>> m_keyMatrix;
     std::vector<std::vector<float>> m_valueMatrix;
+    
+    // Query/key/value cache, one m_dimensions-wide row per position. Queries
+    // are only needed again by backward()
+    std::vector<float> m_queryCache;
+    std::vector<float> m_keyCache;
+    std::vector<float> m_valueCache;
+    std::vector<float> m_rowNormalizers;   // log-sum-exp of each query's scaled scores
+    int m_sequenceLength;
+    unsigned int m_sequenceId;
+    uint64_t m_cacheId;
+    
+    // Gradient scratch for backward(); grows with the sequence and is reused
+    std::vector<float> m_queryGradient;
+    std::vector<float> m_keyGradient;
+    std::vector<float> m_valueGradient;
+    std::vector<float> m_scoreGradient;
+    std::vector<float> m_weightRow;
+    
+    // Softmax of the query at position over keys 0..position, from the
+    // caches; returns the row's normalizer
+    float computeWeights(int position, float* weights) const;
+    float computeScore(int queryPosition, int keyPosition) const;
+    void project(const std::vector<std::vector<float>>& matrix, const float* input, float* output) const;
+    void projectTransposed(const std::vector<std::vector<float>>& matrix, const float* gradient, float* output) const;
 };
 
 } // namespace llmvis 
\ No newline at end of file
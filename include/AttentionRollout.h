@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+namespace llmvis {
+
+class Model;
+
+// Token-to-token attribution through every attention layer. Each layer's
+// head-averaged attention is mixed with the residual identity (0.5A + 0.5I)
+// and chained with the layers below it:
+//   ROLLOUT: plain matrix product (Abnar & Zuidema's attention rollout)
+//   FLOW:    (max, min) product, i.e. the strongest bottleneck path, a cheap
+//            stand-in for max-flow attention flow
+// Attention is causal, so appending a token only adds one row per layer;
+// update() computes just the new rows instead of redoing the whole chain.
+class AttentionRollout {
+public:
+    enum class Mode {
+        ROLLOUT,
+        FLOW
+    };
+
+    AttentionRollout();
+    ~AttentionRollout();
+
+    void setMode(Mode mode);
+    Mode getMode() const { return m_mode; }
+
+    // Brings the attribution up to date with the model's current sequence
+    void update(Model* model);
+    void reset();
+
+    int getTokenCount() const { return m_tokenCount; }
+    // How much of inputToken reaches queryToken at the top attention layer
+    float getAttribution(int queryToken, int inputToken) const;
+
+private:
+    Mode m_mode;
+    int m_sequenceId;
+    int m_tokenCount;
+    int m_capacity;
+
+    // One lower-triangular m_tokenCount x m_capacity matrix per attention layer
+    std::vector<std::vector<float>> m_chain;
+    std::vector<float> m_mixed;   // scratch rows of 0.5A + 0.5I
+
+    void reserve(int tokenCount);
+};
+
+} // namespace llmvis
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace llmvis {
+
+// How much of each causal attention row to keep
+struct AttentionStoragePolicy {
+    int topK;              // at most this many of the largest weights; 0 for no limit
+    float massThreshold;   // stop once the kept weights sum to this; 1 keeps everything, 0 nothing
+
+    bool isExact() const { return topK <= 0 && massThreshold >= 1.0f; }
+    // Rows are left to be recomputed from the query/key cache
+    bool keepsNothing() const { return massThreshold <= 0.0f; }
+};
+
+// Attention weights of one head, one causal row per query. Exact policies
+// pack the lower triangle back to back (row i starts at i(i+1)/2), halving a
+// dense n x n matrix. Lossy policies keep each row's largest weights as
+// (key, weight) entries in key order, so a top-32 row costs 256 bytes at
+// any context length. Dropped weights read as zero; kept ones are not
+// renormalized, so a row's sum shows how much mass was kept. Keeping
+// nothing leaves long contexts to AttentionHead::computeAttentionTile()
+class AttentionStorage {
+public:
+    AttentionStorage();
+
+    // Re-encodes the rows already stored under the new policy. Only lossless
+    // from an exact policy; rows a lossy policy cut short stay cut short
+    void setPolicy(const AttentionStoragePolicy& policy);
+    const AttentionStoragePolicy& getPolicy() const { return m_policy; }
+    bool isExact() const { return m_policy.isExact(); }
+
+    // Appends the next query's row; weights holds getRowCount() + 1 entries
+    void appendRow(const float* weights);
+    void clear();
+
+    int getRowCount() const { return m_rows; }
+    bool empty() const { return m_rows == 0; }
+
+    // Dense row of query over keys 0..query
+    void readRow(int query, float* weights) const;
+    // Adds scale times each stored weight of the row into sums[key]
+    void accumulateRow(int query, float scale, float* sums) const;
+    float getWeight(int query, int key) const;
+
+    size_t getEntryCount() const { return m_weights.size(); }
+    size_t getMemoryBytes() const;
+
+private:
+    AttentionStoragePolicy m_policy;
+    int m_rows;
+
+    std::vector<float> m_weights;      // packed triangle, or sparse entry weights
+    std::vector<uint32_t> m_keys;      // sparse only: key of each entry
+    std::vector<size_t> m_rowStart;    // sparse only: first entry of each row, plus the end
+
+    std::vector<std::pair<float, uint32_t>> m_candidates;   // row selection scratch
+
+    static size_t packedOffset(int query) { return static_cast<size_t>(query) * (query + 1) / 2; }
+};
+
+} // namespace llmvis
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+
+namespace llmvis {
+
+class AttentionHead;
+
+// One head's causal attention pattern as a square texture, query rows from
+// the top. Rows only ever get appended during generation, so each update
+// sends just the new rows and only their keys up to the diagonal; the upper
+// triangle stays at the zeros it was allocated with. Weights are stored as
+// 8-bit sqrt(w), which keeps the small weights of long sequences visible and
+// costs one byte per key: a 2k-token step uploads about 2 KB per head
+class AttentionTexture {
+public:
+    AttentionTexture();
+    ~AttentionTexture();
+
+    // Uploads the head's rows appended since the last call and returns the
+    // bytes sent. A new sequence id, or fewer rows than before, starts over.
+    // At most 256 rows go per call; rows past the first 4096 are not shown
+    int update(const AttentionHead& head);
+
+    GLuint getTexture() const { return m_texture; }
+    int getRowCount() const { return m_rows; }
+    // Texture coordinate where the filled rows x rows block ends
+    float getFilledExtent() const { return m_capacity > 0 ? static_cast<float>(m_rows) / m_capacity : 0.0f; }
+
+private:
+    GLuint m_texture;
+    int m_capacity;
+    int m_rows;
+    unsigned int m_sequenceId;
+
+    std::vector<float> m_row;
+    std::vector<unsigned char> m_staging;   // new rows, packed up to the diagonal
+
+    void allocate(int capacity);
+};
+
+} // namespace llmvis
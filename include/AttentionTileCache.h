@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <glad/glad.h>
+
+namespace llmvis {
+
+class AttentionHead;
+
+// Heads' attention as virtual matrices of kTileSize-square tiles, computed
+// from the query/key cache the first time a view needs them and kept as
+// textures in a least-recently-used cache of fixed size, so memory does not
+// grow with context length. Level L tiles sample every 2^L-th query and key,
+// which makes a tile cost the same at any zoom. Rows of a causal matrix
+// never change once computed; only tiles at the end of the sequence are
+// recomputed as tokens arrive. Tiles are keyed on the head's cache id, so a
+// rebuilt cache, or another head reusing a freed head's memory, never hits
+// the old ones
+class AttentionTileCache {
+public:
+    static const int kTileSize = 128;
+
+    explicit AttentionTileCache(int capacity);
+    ~AttentionTileCache();
+
+    // Texture of the tile (8-bit sqrt of each weight), or 0 when it is not
+    // cached and compute is false
+    GLuint getTile(const AttentionHead* head, int level, int tileRow, int tileColumn, bool compute);
+    void clear();
+
+    int getTileCount() const { return static_cast<int>(m_tiles.size()); }
+    int getCapacity() const { return m_capacity; }
+    // Tiles computed so far, for spreading work over frames
+    int getComputeCount() const { return m_computeCount; }
+
+private:
+    struct TileKey {
+        uint64_t cacheId;
+        int level;
+        int row;
+        int column;
+
+        bool operator==(const TileKey& other) const {
+            return cacheId == other.cacheId && level == other.level && row == other.row && column == other.column;
+        }
+    };
+    struct TileKeyHash {
+        size_t operator()(const TileKey& key) const;
+    };
+    struct Tile {
+        TileKey key;
+        GLuint texture;
+        int filledRows;   // rows of the tile that existed when it was computed
+    };
+
+    int m_capacity;
+    int m_computeCount;
+    std::list<Tile> m_tiles;   // most recently used first
+    std::unordered_map<TileKey, std::list<Tile>::iterator, TileKeyHash> m_lookup;
+
+    std::vector<float> m_weights;
+    std::vector<unsigned char> m_texels;
+
+    void computeTile(const AttentionHead* head, Tile& tile);
+};
+
+} // namespace llmvis
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace llmvis {
+
+// Axis-aligned box used for visibility tests
+struct BoundingBox {
+    glm::vec3 min;
+    glm::vec3 max;
+    
+    glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+    float distanceTo(const glm::vec3& point) const;
+    // Distance along the ray to where it enters the box (0 from inside);
+    // takes 1 / direction so callers testing many boxes divide once
+    bool intersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float& distance) const;
+};
+
+// View frustum as six inward-facing planes, extracted from a combined
+// projection * view matrix. A default-constructed frustum accepts everything
+class Frustum {
+public:
+    Frustum();
+    
+    void update(const glm::mat4& viewProjection);
+    
+    // Conservative: may accept boxes just outside a corner, never rejects a visible one
+    bool intersects(const BoundingBox& box) const;
+    
+private:
+    glm::vec4 m_planes[6];
+};
+
+} // namespace llmvis
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace llmvis {
+
+// Signed distance field atlas of printable ASCII, baked on the CPU from an
+// embedded 8x8 bitmap font. Each texel holds 0.5 + d / (2 * spread), with d
+// the signed distance to the glyph outline in font pixels, so glyphs stay
+// sharp at any scale once thresholded at 0.5 in the shader
+class GlyphAtlas {
+public:
+    // Source glyph size and the distance range stored around it, in font pixels
+    static const int kGlyphSize = 8;
+    static const int kSpread = 1;
+    // Atlas texels per font pixel
+    static const int kTexelsPerPixel = 4;
+    static const int kCellSize = (kGlyphSize + 2 * kSpread) * kTexelsPerPixel;
+
+    GlyphAtlas();
+
+    void build();
+
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    const std::vector<unsigned char>& getPixels() const { return m_pixels; }
+
+    // Texture rectangle of a glyph cell, spread included; characters outside
+    // the font map to '?'
+    void getGlyphRect(char c, glm::vec2& uvMin, glm::vec2& uvMax) const;
+    // A texel inside a fully solid cell, for untextured quads in the same stream
+    glm::vec2 getSolidTexCoord() const;
+
+private:
+    int m_width;
+    int m_height;
+    std::vector<unsigned char> m_pixels;
+
+    void getCellRect(int cell, glm::vec2& uvMin, glm::vec2& uvMax) const;
+    void bakeGlyph(int cell, const unsigned char* rows);
+};
+
+} // namespace llmvis
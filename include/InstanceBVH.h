@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+namespace llmvis {
+
+// A pickable sphere: one neuron or attention head of a layer (the other
+// index is -1)
+struct PickSphere {
+    glm::vec3 center;
+    float radius;
+    int layer;
+    int neuron;
+    int head;
+};
+
+struct PickHit {
+    int layer;
+    int neuron;
+    int head;
+    float distance;   // along the ray to the sphere's surface
+};
+
+// Bounding volume hierarchy over every layer's neurons and heads, for ray
+// queries that cost a few dozen box tests instead of a scan of all instances.
+// Built once per model, with subtrees split across threads, and refit in
+// place when only positions move. Queries are const and may run on any
+// thread while no build or refit is in progress
+class InstanceBVH {
+public:
+    InstanceBVH();
+
+    void build(const std::vector<PickSphere>& spheres);
+    // Same spheres in the same order with new centres or radii: the tree
+    // keeps its shape and only its boxes are recomputed. A different count
+    // rebuilds
+    void refit(const std::vector<PickSphere>& spheres);
+
+    // Nearest sphere along the ray (direction normalized); false if none
+    bool intersect(const glm::vec3& origin, const glm::vec3& direction, PickHit& hit) const;
+
+    int getSphereCount() const { return static_cast<int>(m_spheres.size()); }
+    int getNodeCount() const { return static_cast<int>(m_nodes.size()); }
+
+private:
+    // Children of a node are allocated as a pair, so inner nodes store only
+    // the first. Children always follow their parent in the array
+    struct Node {
+        BoundingBox bounds;
+        int first;   // leaf: first sphere; inner: left child, right child at first + 1
+        int count;   // spheres of a leaf; 0 for inner nodes
+    };
+    // A sphere and its index in the build input, sorted in place while building
+    struct BuildEntry {
+        PickSphere sphere;
+        int source;
+    };
+    // Subtree handed to a worker thread, rooted at an already allocated node
+    struct BuildTask {
+        int node;
+        int begin;
+        int end;
+        BoundingBox centers;
+    };
+
+    std::vector<Node> m_nodes;
+    std::vector<PickSphere> m_spheres;   // in leaf order
+    std::vector<int> m_source;           // index of each leaf-order sphere in the build input
+
+    // Splits entries [begin, end) at their median along the widest axis of
+    // centers, a box holding their centres; leaves get at most kLeafSize
+    void buildNode(std::vector<Node>& nodes, int nodeIndex, int begin, int end, std::vector<BuildEntry>& entries,
+                   const BoundingBox& centers);
+    // Top levels on the calling thread, stopping levels deep at task roots
+    void buildTop(int nodeIndex, int begin, int end, int levels, std::vector<BuildEntry>& entries,
+                  const BoundingBox& centers, std::vector<BuildTask>& tasks);
+    // Reorders [begin, end) about the median centre on the widest axis of
+    // centers; returns the median's index and the centre boxes of both halves
+    static int partition(int begin, int end, std::vector<BuildEntry>& entries, const BoundingBox& centers,
+                         BoundingBox& leftCenters, BoundingBox& rightCenters);
+};
+
+} // namespace llmvis
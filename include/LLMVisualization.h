@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include <glm/glm.hpp>
 #include "Renderer.h"
+#include "InstanceBVH.h"
 
 namespace llmvis {
 
@@ -14,6 +15,9 @@ class Model;
 class Layer;
 class Camera;
 class SimulationController;
+class ActivationIndex;
+class ResidualIndex;
+class AttentionRollout;
 
 class LLMVisualization {
 public:
@@ -30,6 +34,8 @@ public:
     
     // Interactive methods
     void selectComponent(const glm::vec3& rayOrigin, const glm::vec3& rayDirection);
+    // Selects what a GPU pick id names (see Renderer::pollPick)
+    void selectPicked(unsigned int pickId);
     void modifySelectedComponent(const std::string& property, float value);
     void runExperiment(const std::string& experimentType);
     
@@ -49,6 +55,11 @@ private:
     std::unique_ptr<Model> m_model;
     std::unique_ptr<Camera> m_camera;
     std::unique_ptr<SimulationController> m_simulationController;
+    std::unique_ptr<ActivationIndex> m_activationIndex;
+    std::unique_ptr<ResidualIndex> m_residualIndex;
+    std::unique_ptr<AttentionRollout> m_attentionRollout;
+    std::string m_modelPath;
+    bool m_residualIndexLoaded;   // the saved index was read back whole
     
     int m_width;
     int m_height;
@@ -59,10 +70,73 @@ private:
     bool m_showPauseMenu;
     int m_selectedMenuOption;
     
+    // Current pick (-1 when nothing is selected; a whole layer or head
+    // selection has no neuron)
+    int m_selectedLayer;
+    int m_selectedNeuron;
+    // Why the picked neuron has no saliency, empty when it has one
+    std::string m_saliencyMessage;
+    
+    // Ray-query hierarchy over every neuron and head, refit when the model's
+    // layout version moves; and what the crosshair is over this frame
+    InstanceBVH m_pickHierarchy;
+    std::vector<PickSphere> m_pickSpheres;
+    unsigned int m_pickLayoutVersion;
+    bool m_hasHover;
+    PickHit m_hover;
+    
+    // Token attribution overlay (off, rollout, flow)
+    bool m_showAttribution;
+    
+    // Attention patterns of every head of one layer
+    bool m_showHeadGrid;
+    // Index into the attention storage policies cycled with K
+    int m_attentionStorageMode;
+    
+    // Pannable map of one head's full attention matrix
+    bool m_showAttentionMap;
+    int m_mapHead;
+    AttentionMapView m_mapView;
+    
+    // GPU particles flowing through the layers, and their path this frame
+    bool m_showDataFlow;
+    std::vector<DataFlowNode> m_dataFlowPath;
+    
+    // Decluttered token and neuron labels over the layers
+    bool m_showLabels;
+    
+    // Nearest recorded residuals found with N, as panel lines
+    bool m_showNeighbors;
+    std::string m_neighborTitle;
+    std::vector<std::string> m_neighborLines;
+    
     // Add these methods
+    // Selects and highlights the layer; a neuron also gets its saliency
+    void setSelection(int layerIndex, int neuron);
+    // Nearest neuron or head along the ray, else the nearest layer box
+    bool pickAlongRay(const glm::vec3& origin, const glm::vec3& direction, PickHit& hit) const;
+    void updatePickHierarchy(bool rebuild);
+    void renderHoverLabel();
     void renderPauseMenu();
     void handleMenuInput();
     bool processMenuOption(MenuOption option);
+    void renderSelectionPanel();
+    void findSimilarResiduals();
+    void renderNeighborPanel();
+    void renderLogitLens();
+    void cycleAttributionMode();
+    void renderAttribution();
+    void renderTokenSaliency();
+    // Selected attention layer, else the first one; null if there is none
+    Layer* getShownAttentionLayer(int& layerIndex);
+    void renderHeadGrid();
+    void cycleAttentionStorage();
+    void renderAttentionMap();
+    void handleAttentionMapInput();
+    // Zooms the attention map by factor about the panel's centre
+    void zoomAttentionMap(float factor);
+    // Draw calls and GL state changes of the last flushed render queue
+    void renderFrameStats();
 };
 
 } // namespace llmvis 
\ No newline at end of file
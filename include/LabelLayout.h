@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "UIBatch.h"
+
+namespace llmvis {
+
+// World-space text labels, decluttered in screen space. Candidates are
+// queued with a priority; resolve() projects them all, then walks them from
+// the highest priority down and keeps each label only if the cells of a
+// coarse screen occupancy grid it would cover are still free. Survivors go
+// into the overlay batch as glyph quads, so they cost no draw of their own
+class LabelLayout {
+public:
+    LabelLayout();
+
+    // Text centred just above anchor; higher priority wins an overlap
+    void add(const glm::vec3& anchor, const std::string& text, float priority, const glm::vec4& color);
+    void clear();
+
+    // Places the candidates on a width x height window (pixels, origin
+    // top-left) and adds the survivors to batch; returns how many were placed
+    int resolve(const glm::mat4& viewProjection, int width, int height, float scale, UIBatch& batch);
+
+    int getCandidateCount() const { return static_cast<int>(m_priorities.size()); }
+
+private:
+    // Candidates, one array per field so projection streams plain floats
+    std::vector<float> m_anchorX;
+    std::vector<float> m_anchorY;
+    std::vector<float> m_anchorZ;
+    std::vector<float> m_priorities;
+    std::vector<glm::vec4> m_colors;
+    std::string m_text;                  // every candidate's text back to back
+    std::vector<uint32_t> m_textStart;   // where each one starts, plus the end
+
+    // resolve() scratch, kept between frames
+    std::vector<glm::vec3> m_projected;            // window x, y and clip w
+    std::vector<std::pair<float, int>> m_order;   // on-screen candidates by priority
+    std::vector<uint64_t> m_occupancy;            // one bit per cell, rowWords per row
+    std::string m_label;
+
+    // Marks cells [col0, col1] x [row0, row1] taken if all of them are free
+    bool claim(int col0, int col1, int row0, int row1, int rowWords);
+};
+
+} // namespace llmvis
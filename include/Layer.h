@@ -5,6 +5,9 @@
 #include <glm/glm.hpp>
 #include "Neuron.h"
 #include "AttentionHead.h"
+#include "Frustum.h"
+#include "InstanceBVH.h"
+#include "ActivationPyramid.h"
 
 namespace llmvis {
 
@@ -18,14 +21,36 @@ enum class LayerType {
 
 class Layer {
 public:
-    Layer(LayerType type, int size);
+    Layer(LayerType type, int size, unsigned int seed = 0);
     ~Layer();
     
     void update(float deltaTime);
     void render(class Renderer* renderer);
     
+    // Processes the next token of the sequence; attention layers attend over
+    // every token seen since the last resetSequence()
     void processInput(const std::vector<float>& input);
     std::vector<float> getOutput() const;
+    const std::vector<float>& getActivations() const { return m_outputValues; }
+    // Bumped whenever processInput() changes the activations
+    unsigned int getActivationVersion() const { return m_activationVersion; }
+    int getActivationWidth() const { return static_cast<int>(m_outputValues.size()); }
+    // Min/max/mean levels over getActivations(), kept current by processInput()
+    const ActivationPyramid& getActivationPyramid() const { return m_activationPyramid; }
+    // Root mean square of getActivations(), kept current by processInput()
+    float getActivationMagnitude() const { return m_activationMagnitude; }
+    void resetSequence();
+    
+    // Reverse pass over the processed sequence using the activations recorded
+    // by processInput(). Gradients are rows x getActivationWidth(), row-major;
+    // only rows [rowBegin, rowEnd) of outputGradient are read. Writes the
+    // input gradient and returns its first row that can be non-zero
+    int backward(const float* outputGradient, float* inputGradient, int rowBegin, int rowEnd);
+    // Per-token layer inputs (embedding, feedforward) or outputs (output layer)
+    const std::vector<float>& getRecordedActivations() const { return m_recordedActivations; }
+    
+    // Per-neuron saliency shown on the neurons; empty clears it
+    void setSaliency(const std::vector<float>& saliency);
     
     void setActivation(float progress);
     void highlight(bool isHighlighted);
@@ -37,19 +62,45 @@ public:
     void highlightAttentionHead(int headIndex);
     AttentionHead* getAttentionHead(int index);
     int getAttentionHeadCount() const;
+    void setAttentionStoragePolicy(const AttentionStoragePolicy& policy);
+    // Bytes of attention weights stored across the heads
+    size_t getAttentionStorageBytes() const;
     
     // Add missing position functions
     const glm::vec3& getPosition() const { return m_position; }
+    // Lays the layer out again (heads, grid blocks, bounds); geometry baked
+    // for the old layout is replaced on the next render()
     void setPosition(const glm::vec3& position);
     
+    // Neurons drawn individually (every neuron of feedforward and output layers)
+    int getVisibleNeuronCount() const;
+    glm::vec3 getNeuronPosition(int index) const;
+    float getNeuronRadius() const;
+    // Maps one of the renderer's baked neuron instances back to this layer's
+    // grid neuron or attention head (the other is -1); false if not this layer's
+    bool findBakedNeuron(int instance, int& neuron, int& head) const;
+    // Appends the layer's neurons and heads, as drawn, labelled with layerIndex
+    void appendPickSpheres(int layerIndex, std::vector<PickSphere>& spheres) const;
+    // Bumped by setPosition() whenever the layout changes
+    unsigned int getLayoutVersion() const { return m_layoutVersion; }
+    
+    // World-space bounds of everything render() draws, for culling
+    const BoundingBox& getBounds() const { return m_bounds; }
+    
 private:
     LayerType m_type;
     int m_size;
     bool m_isHighlighted;
     float m_activationProgress;
+    unsigned int m_activationVersion;
+    unsigned int m_tintVersion;   // bumped when activations or saliency change
     
     std::vector<float> m_inputValues;
     std::vector<float> m_outputValues;
+    ActivationPyramid m_activationPyramid;
+    float m_activationMagnitude;
+    std::vector<float> m_recordedActivations;   // one row per token, see getRecordedActivations()
+    std::vector<float> m_saliency;
     
     // For attention layers
     std::vector<std::unique_ptr<AttentionHead>> m_attentionHeads;
@@ -58,6 +109,44 @@ private:
     glm::vec3 m_position;
     glm::vec3 m_scale;
     glm::vec3 m_color;
+    
+    // Layout, fixed by setPosition()
+    struct NeuronBlock {
+        BoundingBox bounds;
+        int rowBegin;
+        int rowEnd;
+        int colBegin;
+        int colEnd;
+        int first;   // offset of the block's neurons in the baked grid
+        int count;
+        glm::vec4 aggregateColor;   // the block as one sphere, by its strongest tint
+    };
+    BoundingBox m_bounds;
+    std::vector<NeuronBlock> m_neuronBlocks;
+    std::vector<glm::vec3> m_patternCenters;   // attention pattern quad of each head
+    unsigned int m_layoutVersion;
+    
+    // Geometry baked into the renderer: the grid's neurons block by block, or
+    // the heads and the connections between them. Colours are rebuilt only
+    // when the layer colour or tint inputs differ from the baked ones
+    bool m_isBaked;
+    unsigned int m_bakedGeneration;
+    unsigned int m_bakedLayout;
+    int m_bakedNeuronFirst;
+    int m_bakedConnectionFirst;
+    bool m_bakedColorsValid;
+    glm::vec4 m_bakedColor;
+    unsigned int m_bakedTintVersion;
+    std::vector<glm::vec4> m_bakedColors;
+    
+    // Neuron grid layout and its culled, level-of-detail rendering
+    int getNeuronsPerRow() const;
+    float getNeuronSpacing() const;
+    glm::vec3 getGridPosition(int row, int col) const;
+    void updateLayout();
+    void bakeGeometry(class Renderer* renderer);
+    void updateGridColors(class Renderer* renderer, const glm::vec4& color);
+    void renderNeuronGrid(class Renderer* renderer, const glm::vec4& color);
 };
 
 } // namespace llmvis 
\ No newline at end of file
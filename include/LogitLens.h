@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+namespace llmvis {
+
+struct LensPrediction {
+    int tokenId;
+    float logit;
+    float probability;
+};
+
+// Projects the residual of every layer through the final norm and the
+// unembedding in one pass. All layers share each streamed block of the
+// unembedding (a layers x d times d x vocab GEMM), and top-k selection and the
+// softmax normalizer are folded into the same pass so the full layers x vocab
+// logit matrix is never materialized.
+class LogitLens {
+public:
+    LogitLens(int modelDimensions, int vocabSize);
+    ~LogitLens();
+
+    // Stand-in weights for the demo model; real weights would be loaded instead
+    void initializeRandom(unsigned int seed);
+    bool isInitialized() const { return !m_unembedding.empty(); }
+
+    // residuals[row] must have modelDimensions entries
+    void compute(const std::vector<const std::vector<float>*>& residuals, int topK);
+    const std::vector<LensPrediction>& getPredictions(int row) const { return m_predictions[row]; }
+    int getRowCount() const { return static_cast<int>(m_predictions.size()); }
+
+    int getModelDimensions() const { return m_modelDimensions; }
+    int getVocabSize() const { return m_vocabSize; }
+
+private:
+    int m_modelDimensions;
+    int m_vocabSize;
+
+    std::vector<float> m_unembedding;   // d x vocab, row-major
+    std::vector<std::vector<LensPrediction>> m_predictions;
+};
+
+} // namespace llmvis
@@ -23,17 +23,55 @@ public:
     void createCylinder(float radius, float height, int subdivisions);
     void createQuad(float width, float height);
     
+    // Level-of-detail chains, one level per entry, coarsest first. All levels
+    // share this mesh's buffers
+    void createSphereLods(float radius, const std::vector<int>& subdivisions);
+    void createCylinderLods(float radius, float height, const std::vector<int>& subdivisions);
+    int getLodCount() const { return static_cast<int>(m_lods.size()); }
+    
+    // Draws the most detailed level
     void render();
+    // Draws instanceCount copies of one level, reading per-instance data from
+    // firstInstance on in the streams added with addInstanceAttribute()
+    void renderInstanced(int instanceCount, int level = 0, int firstInstance = 0);
+    
+    // Draw calls for callers that bind the VAO themselves (see GLStateTracker)
+    GLuint getVertexArray() const { return m_vao; }
+    void draw(int level) const;
+    void drawInstanced(int instanceCount, int level, int firstInstance) const;
+    
+    // Binds a per-instance (divisor 1) float attribute from buffer into this mesh's VAO
+    void addInstanceAttribute(GLuint buffer, GLuint location, GLint components, GLsizei stride, size_t offset);
     
 private:
+    struct LodLevel {
+        size_t firstIndex;
+        GLsizei indexCount;
+    };
+    
+    struct InstanceAttribute {
+        GLuint buffer;
+        GLuint location;
+        GLint components;
+        GLsizei stride;
+        size_t offset;
+    };
+    
     std::vector<Vertex> m_vertices;
     std::vector<unsigned int> m_indices;
+    std::vector<LodLevel> m_lods;
+    std::vector<InstanceAttribute> m_instanceAttributes;
     
     GLuint m_vao;
     GLuint m_vbo;
     GLuint m_ebo;
     
     void setupMesh();
+    void clearGeometry();
+    void appendSphere(float radius, int subdivisions);
+    void appendCylinder(float radius, float height, int subdivisions);
+    // Closes the level whose indices start at firstIndex
+    void finishLevel(size_t firstIndex, unsigned int baseVertex);
 };
 
 } // namespace llmvis 
\ No newline at end of file
@@ -4,11 +4,16 @@
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <cstdint>
 #include "Layer.h"
 #include "Common.h"
+#include "LogitLens.h"
 
 namespace llmvis {
 
+class ResidualIndex;
+struct DataFlowNode;
+
 class Model {
 public:
     Model();
@@ -17,33 +22,109 @@ public:
     bool initialize();
     void update(float deltaTime);
     void render(class Renderer* renderer);
+    // World-space labels of the visible layers: the token each attention head
+    // attends to most, neuron ids on feedforward blocks and token strings on
+    // the output grid, prioritized by activation for the renderer to declutter
+    void renderLabels(class Renderer* renderer);
     bool loadFromFile(const std::string& filePath);
     
+    // Runs a whole prompt as a new sequence, one token at a time
     void processInput(const std::string& input);
+    // Extends the current sequence by one token (a decode step)
+    void appendToken(const std::string& token);
+    int getSequenceLength() const { return static_cast<int>(m_tokens.size()); }
+    // Changes whenever processInput() starts a new sequence
+    int getSequenceId() const { return m_sequenceId; }
+    const std::vector<int>& getTokens() const { return m_tokens; }
     void highlightLayer(int layerIndex);
     void highlightAttentionHead(int layerIndex, int headIndex);
+    // Applies to every attention head, re-encoding the rows already recorded.
+    // Under the default exact policy, sequences longer than
+    // kRecomputeAttentionLength tokens keep nothing and recompute rows instead
+    void setAttentionStoragePolicy(const AttentionStoragePolicy& policy);
+    static const int kRecomputeAttentionLength = 2048;
     
     void setSimulationSpeed(float speed);
     float getSimulationSpeed() const;
     
     Layer* getLayer(int index);
     int getLayerCount() const;
+    // Layers in order as data-flow nodes, weighted by activation magnitude
+    void getDataFlowPath(std::vector<DataFlowNode>& path) const;
+    // Every layer's neurons and heads, for the picking hierarchy
+    void getPickSpheres(std::vector<PickSphere>& spheres) const;
+    // Changes whenever any layer is laid out again
+    unsigned int getLayoutVersion() const;
     
     std::string getCurrentActivation();
     
+    // When set, every processed prompt records its per-layer residuals into the index
+    void setResidualIndex(ResidualIndex* index) { m_residualIndex = index; }
+    
+    // Logit lens: each layer's top next-token guesses through the final norm and unembedding
+    void setLogitLensEnabled(bool enabled);
+    bool isLogitLensEnabled() const { return m_logitLensEnabled; }
+    const std::vector<LensPrediction>* getLogitLensPredictions(int layerIndex) const;
+    std::string getTokenString(int tokenId) const;
+    
+    // Gradient saliency of one neuron's output at the last token, from a reverse
+    // pass over the activations cached by the forward pass. Per-token saliency
+    // is |gradient . embedding|; each layer below the target receives the
+    // summed |gradient| of its outputs through Layer::setSaliency()
+    bool computeSaliency(int layerIndex, int neuronIndex);
+    // Whether computeSaliency() can run for this target; if not, reason says why
+    bool canComputeSaliency(int layerIndex, int neuronIndex, std::string& reason) const;
+    void clearSaliency();
+    const std::vector<float>& getTokenSaliency() const { return m_tokenSaliency; }
+    
 private:
     std::vector<std::unique_ptr<Layer>> m_layers;
     std::string m_currentInput;
     std::vector<float> m_embeddingData;
     std::unordered_map<std::string, int> m_tokenToIdMap;
+    std::vector<int> m_tokens;
+    int m_sequenceId;
+    uint32_t m_traceId;
     
     float m_simulationSpeed;
     int m_currentStep;
     bool m_animateDataFlow;
     
+    ResidualIndex* m_residualIndex;
+    
+    AttentionStoragePolicy m_attentionStoragePolicy;   // as last set
+    bool m_recomputingAttention;   // heads keep nothing for this long sequence
+    
+    std::unique_ptr<LogitLens> m_logitLens;
+    std::vector<int> m_logitLensRows;   // lens row per layer, -1 if not projected
+    bool m_logitLensEnabled;
+    
+    // Label candidates of one layer, rebuilt when its activations change.
+    // items holds neuron indices, or head indices for attention layers
+    struct LayerLabels {
+        bool valid;
+        unsigned int version;
+        std::vector<int> items;
+        std::vector<std::string> texts;
+        std::vector<float> priorities;   // relative to the layer's strongest
+    };
+    std::vector<LayerLabels> m_layerLabels;
+    std::vector<int> m_labelOrder;
+    std::vector<float> m_labelRow;
+    
+    // Reverse pass buffers, tokens x width; reused between calls
+    std::vector<float> m_gradient;
+    std::vector<float> m_inputGradient;
+    std::vector<float> m_tokenSaliency;
+    
     // Internal methods
     void setupDefaultModel();
     void connectLayers();
+    void updateLogitLens();
+    void updateLayerLabels(int layerIndex);
+    void forwardToken(const std::string& token);
+    void applyAttentionStoragePolicy(const AttentionStoragePolicy& policy);
+    int getTokenId(const std::string& token);
 };
 
 } // namespace llmvis 
\ No newline at end of file
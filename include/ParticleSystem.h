@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+
+namespace llmvis {
+
+// One particle as the update program reads and writes it
+struct Particle {
+    glm::vec4 positionLife;    // xyz = position, w = seconds left; dead at <= 0
+    glm::vec4 velocityTarget;  // xyz = velocity, w = index of the path node it heads for
+    glm::vec4 laneIntensity;   // xy = offset across the layers in [-1, 1], z = intensity, w = speed factor
+};
+
+// Particles that live entirely in GPU buffers. Each step() draws the
+// current buffer as points through a transform feedback program into the
+// other one with rasterization off, then swaps, so the CPU never touches a
+// particle; the caller only sets the program's uniforms. The latest state
+// is drawn as instanced billboards by getMesh()
+class ParticleSystem {
+public:
+    explicit ParticleSystem(int capacity);
+    ~ParticleSystem();
+
+    // Allocates both buffers with every particle dead
+    bool initialize();
+
+    // Runs the program (which must capture the three Particle vec4s in
+    // order) over every particle; its uniforms are already set
+    void step(GLuint updateProgram);
+
+    int getCapacity() const { return m_capacity; }
+    // Unit quad with corners at +-1 whose instances (locations 3, 4 and 5)
+    // read the particles of the last step
+    Mesh* getMesh() const { return m_meshes[m_current].get(); }
+
+private:
+    int m_capacity;
+    int m_current;   // buffer holding the latest state
+
+    GLuint m_buffers[2];
+    GLuint m_updateVAOs[2];
+    std::unique_ptr<Mesh> m_meshes[2];
+};
+
+} // namespace llmvis
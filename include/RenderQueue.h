@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace llmvis {
+
+class Shader;
+class Mesh;
+
+// Last-bound GL state. Binds matching what is already current are skipped,
+// and both kinds are counted so the effect of sorting is measurable.
+// invalidate() forgets the cache after code that binds state directly
+class GLStateTracker {
+public:
+    GLStateTracker();
+
+    void invalidate();
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void setDepthMask(bool enabled);
+    void setDepthTest(bool enabled);
+    void bindTexture(GLuint unit, GLuint texture);
+
+    void resetCounters();
+    int getStateChanges() const { return m_stateChanges; }
+    int getSkippedChanges() const { return m_skippedChanges; }
+
+private:
+    GLuint m_program;
+    GLuint m_vao;
+    int m_depthMask;   // -1 unknown, else 0/1
+    int m_depthTest;
+    bool m_programValid;
+    bool m_vaoValid;
+
+    static const int kTrackedTextureUnits = 4;
+    GLuint m_textures[kTrackedTextureUnits];
+    bool m_texturesValid;
+
+    int m_stateChanges;
+    int m_skippedChanges;
+};
+
+enum class RenderPass {
+    OPAQUE_PASS = 0,       // sorted by state, then front to back
+    TRANSPARENT_PASS = 1   // weighted blended, so sorted by state only; no depth writes
+};
+
+// Uniform handles a queued draw sets; -1 where the program has none
+struct DrawProgram {
+    Shader* shader;
+    unsigned int sortId;   // small, stable id used in the sort key
+    GLint modelLocation;
+    GLint colorLocation;
+    GLint progressLocation;
+    GLint valueRangeLocation;   // >= 0 only for programs that sample item textures
+    GLint texRectLocation;
+    GLint pickLocation;
+};
+
+struct DrawItem {
+    uint64_t key;
+    const DrawProgram* program;
+    Mesh* mesh;
+    int level;
+    int instanceCount;     // 0 draws the mesh once with the uniforms below
+    int firstInstance;
+    glm::mat4 model;
+    glm::vec4 color;
+    float progress;
+    GLuint texture;      // bound to unit 0 for programs with a value range
+    float valueRange;
+    glm::vec4 texRect;   // texture offset (xy) and scale (zw) across the mesh
+    unsigned int pickId;   // id written by the pick pass, plus the instance index; 0 = not pickable
+};
+
+// Draws gathered over a frame and submitted pass by pass in sort-key order.
+// Key layout, high to low bits:
+//   opaque:      pass(2) | program(8) | mesh(8) | level(6) | depth(24) front to back
+//   transparent: pass(2) | program(8) | mesh(8) | level(6) | 0
+// Transparent draws are resolved by order-independent blending, so they
+// need no depth order and are grouped by state like opaque ones
+class RenderQueue {
+public:
+    static uint64_t makeKey(RenderPass pass, unsigned int programId, unsigned int meshId, int level, float viewDepth);
+
+    void push(const DrawItem& item) { m_items.push_back(item); }
+    void clear() { m_items.clear(); }
+    size_t size() const { return m_items.size(); }
+
+    // Sorts and draws the items of one pass; returns the number of draw
+    // calls. Items stay queued until clear()
+    int submit(GLStateTracker& state, RenderPass pass);
+    // Draws the pickable items of both passes with depth writes on, each
+    // writing its pick id; the caller has the pick target bound
+    int submitPicking(GLStateTracker& state);
+
+private:
+    std::vector<DrawItem> m_items;
+    std::vector<std::pair<uint64_t, uint32_t>> m_order;
+};
+
+} // namespace llmvis
@@ -6,14 +6,72 @@
 #include <unordered_map>
 #include <string>
 #include <memory>
+#include <vector>
 #include "Shader.h"
 #include "Mesh.h"
 #include "Camera.h"
+#include "Frustum.h"
+#include "RenderQueue.h"
+#include "UIBatch.h"
+#include "LabelLayout.h"
+#include "ActivationTexture.h"
+#include "AttentionTexture.h"
+#include "AttentionTileCache.h"
+#include "ParticleSystem.h"
+#include "StaticInstanceBuffer.h"
 
 namespace llmvis {
 
+// Per-instance data of the instanced neuron pass
+struct NeuronInstance {
+    glm::vec4 positionSize;   // xyz = centre, w = radius
+    glm::vec4 color;
+};
+
+// Per-instance data of the instanced connection pass; the vertex shader
+// orients and stretches the unit cylinder between the two endpoints
+struct ConnectionInstance {
+    glm::vec4 fromStrength;   // xyz = start, w = strength
+    glm::vec4 toRadius;       // xyz = end, w = radius
+    glm::vec4 color;
+};
+
+// One stop on the data-flow path: a layer facing +Z, the half extent its
+// particles spread over, and how strongly it fires (its spawn weight)
+struct DataFlowNode {
+    glm::vec3 position;
+    glm::vec2 extent;
+    float magnitude;
+};
+
+// Work done by the last flushQueue(), plus the previous frame's overlay
+struct RenderStats {
+    int drawCalls;
+    int stateChanges;     // program, VAO and depth state binds issued
+    int skippedChanges;   // binds the state tracker found redundant
+    int uiQuads;          // rects, lines and glyphs in the single overlay draw
+    int activationRowsUploaded;   // heatmap texture rows sent this frame
+    int attentionBytesUploaded;   // attention pattern bytes sent this frame
+    int attentionTilesComputed;   // attention map tiles computed this frame
+    int staticBytesUploaded;      // baked geometry and colour bytes sent this frame
+    int labelCandidates;          // world-space labels queued this frame
+    int labelsPlaced;             // of those, drawn after decluttering
+};
+
+// Window onto a head's attention matrix: the (query, key) entry at the
+// panel's top-left corner and how many entries one screen pixel spans
+struct AttentionMapView {
+    float query;
+    float key;
+    float entriesPerPixel;
+};
+
 class Renderer {
 public:
+    // Pick ids read back by pollPick(): 0 is the background, ids with this
+    // bit set are baked neuron instances, others the pick name of the draw
+    static const unsigned int kPickInstanceBit = 0x80000000u;
+    
     Renderer();
     ~Renderer();
     
@@ -24,12 +82,87 @@ public:
     void setCamera(Camera* camera);
     GLFWwindow* getWindow() const { return m_window; }
     
+    // Camera frustum of the current frame (set in beginFrame) for culling
+    const Frustum& getFrustum() const { return m_frustum; }
+    glm::vec3 getCameraPosition() const;
+    
+    // The 3D render* calls below only queue work; nothing is drawn until
+    // flushQueue(), which sorts the frame's draws by state and depth
     void renderLayer(const class Layer* layer);
+    // Flat quad scaled to size, used for whole layers and far LOD
+    void renderSlab(const glm::vec3& center, const glm::vec3& size, const glm::vec4& color);
+    // Flat quad textured with the layer's activations through a diverging
+    // colormap. Only the part of the slab on screen is uploaded, from the
+    // activation pyramid level nearest one texel per pixel, and only rows that
+    // changed since it was last drawn are sent
+    void renderActivationSlab(const class Layer* layer, const glm::vec3& center, const glm::vec3& size, float alpha);
+    // A head's causal attention pattern on a size x size quad facing +Z, query
+    // rows from the top. Each frame sends only the rows appended since the last
+    void renderAttentionPattern(const class AttentionHead* head, const glm::vec3& center, float size);
     void renderNeuron(const glm::vec3& position, float size, const glm::vec4& color);
     void renderConnection(const glm::vec3& from, const glm::vec3& to, float strength, const glm::vec4& color);
-    void renderDataFlow(const glm::vec3& start, const glm::vec3& end, float progress, const glm::vec4& color);
+    // Advances the data-flow particles along path on the GPU. Dead particles
+    // respawn at a node picked in proportion to its magnitude and follow
+    // their lane through the later nodes; the CPU only sets uniforms
+    void updateDataFlow(const std::vector<DataFlowNode>& path, float deltaTime);
+    // Queues every particle as one instanced draw
+    void renderDataFlow();
+    // Text anchored at a world position, centred just above it. flushQueue()
+    // declutters the frame's labels together: where two would overlap on
+    // screen only the higher priority one is drawn
+    void renderLabel(const glm::vec3& anchor, const std::string& text, float priority, const glm::vec4& color);
+    
+    // Static geometry, baked once per model load into persistent instance
+    // buffers; each bake returns the first instance. Only colours are sent
+    // again afterwards, and only those that changed
+    int bakeNeurons(const std::vector<glm::vec4>& positionSizes);
+    // One connection per (from, to) pair of endpoints
+    int bakeConnections(const std::vector<glm::vec3>& endpoints, float strength);
+    void setBakedNeuronColors(int first, const std::vector<glm::vec4>& colors);
+    void setBakedConnectionColors(int first, const std::vector<glm::vec4>& colors);
+    // Queue baked instances [first, first + count); the LOD is picked once
+    // for the whole range, from its projected size at center. Transparent
+    // neurons are drawn in the weighted blended pass
+    void renderBakedNeurons(int first, int count, const glm::vec3& center, float radius, bool transparent);
+    void renderBakedConnections(int first, int count, const glm::vec3& center);
+    // Drops all baked geometry; layers bake again when the generation changes
+    void clearStaticGeometry();
+    // Drops the activation, attention and tile textures kept for the current
+    // model's layers and heads, before another model replaces them
+    void clearModelTextures();
+    unsigned int getStaticGeneration() const { return m_staticGeneration; }
+    void flushQueue();
+    const RenderStats& getRenderStats() const { return m_renderStats; }
+    
+    // GPU picking. Slabs, activation slabs and attention patterns queued
+    // after setPickName() report that name (0 makes them unpickable); baked
+    // neurons report their instance. A requested pixel is drawn into an
+    // integer id target by a scissored 1x1 pass of the next flushQueue() and
+    // read back through a pixel buffer once its fence signals, so it never stalls
+    void setPickName(unsigned int name);
+    // Window pixels, origin top-left
+    void requestPick(int x, int y);
+    // True once per resolved request, with the id under the pixel
+    bool pollPick(unsigned int& id);
+    bool isPickingAvailable() const { return m_pickFramebuffer != 0; }
+    
+    // 2D overlay in window pixels. Calls are recorded into one stream and drawn
+    // in call order by a single draw from endFrame(), over the 3D scene
     void renderText(const std::string& text, const glm::vec2& position, float scale, const glm::vec4& color);
     void renderRect(float x, float y, float width, float height, const glm::vec4& color);
+    void renderLine(const glm::vec2& from, const glm::vec2& to, float width, const glm::vec4& color);
+    // Same pattern as renderAttentionPattern(), as an overlay square from position
+    void renderAttentionPanel(const class AttentionHead* head, const glm::vec2& position, float size);
+    // The view's part of a head's attention matrix over a size-pixel panel,
+    // from on-demand tiles. Tiles not computed yet show their cached parent
+    // tile, and only a few are computed per frame
+    void renderAttentionMap(const class AttentionHead* head, const glm::vec2& position, const glm::vec2& size,
+                            const AttentionMapView& view);
+    const AttentionTileCache& getAttentionTiles() const { return m_attentionTiles; }
+    float measureText(const std::string& text, float scale) const { return m_uiBatch.measureText(text, scale); }
+    
+    // World position to window pixels (origin top-left); false if behind the camera
+    bool projectToScreen(const glm::vec3& worldPos, glm::vec2& screenPos) const;
     
 private:
     GLFWwindow* m_window;
@@ -38,24 +171,169 @@ private:
     
     std::unique_ptr<Shader> m_neuronShader;
     std::unique_ptr<Shader> m_connectionShader;
-    std::unique_ptr<Shader> m_textShader;
+    std::unique_ptr<Shader> m_uiShader;
+    std::unique_ptr<Shader> m_uiHeatmapShader;
     std::unique_ptr<Shader> m_dataFlowShader;
+    std::unique_ptr<Shader> m_particleUpdateShader;
+    std::unique_ptr<Shader> m_neuronInstancedShader;
+    std::unique_ptr<Shader> m_neuronImpostorShader;
+    std::unique_ptr<Shader> m_heatmapShader;
+    std::unique_ptr<Shader> m_compositeShader;
     
     std::unique_ptr<Mesh> m_sphereMesh;
     std::unique_ptr<Mesh> m_cylinderMesh;
     std::unique_ptr<Mesh> m_quadMesh;
+    std::unique_ptr<Mesh> m_impostorMesh;
+    // Same meshes with their instances read from the baked buffers
+    std::unique_ptr<Mesh> m_staticSphereMesh;
+    std::unique_ptr<Mesh> m_staticImpostorMesh;
+    std::unique_ptr<Mesh> m_staticCylinderMesh;
     
     Camera* m_camera;
+    Frustum m_frustum;
+    float m_pixelsPerUnit;   // of the current frame, see getPixelsPerUnit()
+    GLuint m_cameraUBO;
     
-    unsigned int m_fontTexture;
+    // Deferred 3D draws and the binds they need, resolved after the shaders link
+    RenderQueue m_renderQueue;
+    GLStateTracker m_stateTracker;
+    RenderStats m_renderStats;
+    DrawProgram m_neuronProgram;
+    DrawProgram m_neuronInstancedProgram;
+    DrawProgram m_neuronImpostorProgram;
+    DrawProgram m_connectionProgram;
+    DrawProgram m_dataFlowProgram;
+    DrawProgram m_heatmapProgram;
+    
+    // Texels of a heatmap grid held by a texture; the grid halves in each
+    // direction per reduction step
+    struct HeatmapWindow {
+        int reduction;
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+    // Per-layer activation textures and the layer version and window they hold
+    struct ActivationSlab {
+        std::unique_ptr<ActivationTexture> texture;
+        unsigned int version;
+        HeatmapWindow window;
+    };
+    std::unordered_map<const class Layer*, ActivationSlab> m_activationSlabs;
+    std::vector<float> m_heatmapTexels;
+    std::unordered_map<const class AttentionHead*, std::unique_ptr<AttentionTexture>> m_attentionTextures;
+    AttentionTileCache m_attentionTiles;
+    GLuint m_colormapTexture;
+    
+    // Data-flow particles and the path uniforms of their update program
+    std::unique_ptr<ParticleSystem> m_particles;
+    std::vector<glm::vec4> m_flowNodes;
+    std::vector<glm::vec4> m_flowExtents;
+    int m_particleSeed;
+    
+    GLint m_uiProjectionLocation;
+    GLint m_uiHeatmapProjectionLocation;
+    
+    // Neurons queued this frame and the stream buffer they are uploaded to
+    std::vector<NeuronInstance> m_neuronInstances;
+    GLuint m_neuronInstanceVBO;
+    size_t m_neuronInstanceCapacity;
+    std::vector<NeuronInstance> m_meshInstances;
+    std::vector<NeuronInstance> m_impostorInstances;
+    GLuint m_impostorInstanceVBO;
+    size_t m_impostorInstanceCapacity;
     
-    // For text rendering
-    GLuint m_textVBO;
-    GLuint m_textVAO;
+    // Connections queued this frame
+    std::vector<ConnectionInstance> m_connectionInstances;
+    std::vector<ConnectionInstance> m_sortedConnectionInstances;
+    GLuint m_connectionInstanceVBO;
+    size_t m_connectionInstanceCapacity;
+    
+    // Opaque scene drawn offscreen, and the weighted blended transparency
+    // targets sharing its depth; all zero when unsupported
+    GLuint m_sceneFramebuffer;
+    GLuint m_sceneColor;
+    GLuint m_sceneDepth;
+    GLuint m_oitFramebuffer;
+    GLuint m_oitAccumTexture;
+    GLuint m_oitWeightTexture;
+    GLuint m_compositeVAO;
+    
+    // Id target of the pick pass and the pixel buffer its result is read into
+    GLuint m_pickFramebuffer;
+    GLuint m_pickTexture;
+    GLuint m_pickDepth;
+    GLuint m_pickPixelBuffer;
+    unsigned int m_pickName;
+    bool m_pickRequested;
+    bool m_pickInFlight;    // read back queued, not yet mapped
+    GLsync m_pickFence;     // signaled once the read back has landed
+    bool m_pickReady;
+    glm::ivec2 m_pickPixel;   // GL window coordinates, origin bottom-left
+    unsigned int m_pickResult;
+    
+    // Baked instances and the ranges of them queued this frame, with the
+    // sphere or cylinder LOD each range was given (-1 for impostors)
+    struct BakedRange {
+        int level;
+        int first;
+        int count;
+        bool transparent;
+    };
+    std::unique_ptr<StaticInstanceBuffer> m_staticNeurons;
+    std::unique_ptr<StaticInstanceBuffer> m_staticConnections;
+    unsigned int m_staticGeneration;
+    std::vector<BakedRange> m_bakedNeuronRanges;
+    std::vector<BakedRange> m_bakedConnectionRanges;
+    
+    // Per-instance LOD scratch shared by the flushes
+    std::vector<int> m_lodLevels;
+    std::vector<int> m_lodStart;
+    
+    // SDF glyph atlas and the overlay stream drawn from it
+    GlyphAtlas m_glyphAtlas;
+    UIBatch m_uiBatch;
+    LabelLayout m_labels;
+    unsigned int m_fontTexture;
+    GLuint m_uiVBO;
+    GLuint m_uiVAO;
+    size_t m_uiVertexCapacity;
     
+    // Neurons become impostor quads or spheres from the sphere LOD chain picked
+    // by projected radius; connections pick a cylinder LOD. Each queues one
+    // instanced draw per level
+    void flushNeurons();
+    void flushConnections();
+    // Uploads what changed in the baked buffers and queues the frame's
+    // ranges, merging neighbours that share a LOD into one draw
+    void flushStaticGeometry();
+    float getViewDepth(const glm::vec3& position) const;
+    // Accumulates the transparent items offscreen and composites them over
+    // the opaque scene in one full-screen draw; returns the draw calls
+    int renderTransparentPass();
+    // Switches the 3D programs between plain and weighted colour output
+    void setWeightedBlend(bool enabled);
+    bool createRenderTargets();
+    void deleteRenderTargets();
+    // Draws the pickable items at the requested pixel and queues the read
+    // back; returns the draw calls
+    int renderPickPass();
+    bool createPickTarget();
+    void deletePickTarget();
+    void flushUI();
+    void uploadStream(GLuint buffer, size_t& capacity, const void* data, size_t bytes);
+    float getPixelsPerUnit() const;
+    // The head's texture with any new rows uploaded; null before its first token
+    AttentionTexture* updateAttentionTexture(const class AttentionHead* head);
+    // Part of an XY-plane slab on screen, as texture coordinates over the slab,
+    // and the window pixels it covers; false if none of it is
+    bool getVisibleSlabRect(const glm::vec3& center, const glm::vec3& size,
+                            glm::vec2& uvMin, glm::vec2& uvMax, float& pixelArea) const;
     void loadShaders();
     void createMeshes();
     void loadFonts();
+    void createColormap();
 };
 
 } // namespace llmvis 
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <random>
+#include <cstdint>
+#include <iosfwd>
+
+namespace llmvis {
+
+struct Neighbor {
+    float distance;   // squared L2
+    uint64_t label;
+};
+
+// Hierarchical navigable small-world graph over fixed-size float vectors.
+// Points are inserted one at a time, so the graph grows as traces are recorded.
+// Not thread-safe: a search must not overlap with an insert.
+class HnswGraph {
+public:
+    HnswGraph(int dimensions, int maxConnections = 16, int efConstruction = 200);
+    ~HnswGraph();
+
+    void add(const float* vector, uint64_t label);
+    std::vector<Neighbor> search(const float* query, int k, int ef = 64) const;
+
+    size_t size() const { return m_labels.size(); }
+    int getDimensions() const { return m_dimensions; }
+
+    void write(std::ostream& out) const;
+    // streamSize is the size of the whole stream. Rejects any count the
+    // stream cannot hold and any graph whose links or levels are inconsistent
+    bool read(std::istream& in, uint64_t streamSize);
+
+private:
+    using DistanceId = std::pair<float, uint32_t>;
+
+    int m_dimensions;
+    int m_maxConnections;        // M on upper levels
+    int m_maxConnectionsLevel0;  // 2M on level 0
+    int m_efConstruction;
+    double m_levelMultiplier;
+
+    std::vector<float> m_vectors;
+    std::vector<uint64_t> m_labels;
+    std::vector<int> m_levels;
+
+    // Each adjacency list is stored as [count, id0, id1, ...] with fixed capacity
+    std::vector<uint32_t> m_level0Links;
+    std::vector<std::vector<uint32_t>> m_upperLinks;
+
+    uint32_t m_entryPoint;
+    int m_maxLevel;
+    std::mt19937 m_rng;
+
+    mutable std::vector<uint32_t> m_visited;
+    mutable uint32_t m_visitTag;
+
+    float distance(const float* a, const float* b) const;
+    const float* vectorAt(uint32_t id) const { return &m_vectors[size_t(id) * m_dimensions]; }
+    uint32_t* linksAt(uint32_t id, int level);
+    const uint32_t* linksAt(uint32_t id, int level) const;
+    int maxLinks(int level) const { return level == 0 ? m_maxConnectionsLevel0 : m_maxConnections; }
+
+    int randomLevel();
+    uint32_t greedyDescend(const float* query, uint32_t entry, int fromLevel, int toLevel) const;
+    std::vector<DistanceId> searchLevel(const float* query, uint32_t entry, int ef, int level) const;
+    std::vector<uint32_t> selectNeighbors(const std::vector<DistanceId>& candidates, int maxCount) const;
+    void connect(uint32_t from, uint32_t to, int level);
+};
+
+// Per-layer ANN index over the residual vectors recorded for every processed
+// prompt. Labels pack (trace id << 32 | token position).
+class ResidualIndex {
+public:
+    explicit ResidualIndex(int layerCount);
+    ~ResidualIndex();
+
+    uint32_t beginTrace(const std::string& prompt);
+    void record(int layerIndex, const std::vector<float>& residual, uint64_t label);
+    std::vector<Neighbor> findSimilar(int layerIndex, const std::vector<float>& residual, int k) const;
+
+    const std::string& getTraceText(uint32_t traceId) const;
+    size_t getRecordCount(int layerIndex) const;
+
+    bool save(const std::string& filePath) const;
+    // All or nothing: on failure the index keeps what it held before
+    bool load(const std::string& filePath);
+    // True once anything was recorded since construction or the last load()
+    bool isModified() const { return m_modified; }
+
+    static uint64_t makeLabel(uint32_t traceId, uint32_t position) {
+        return (uint64_t(traceId) << 32) | position;
+    }
+
+private:
+    std::vector<std::unique_ptr<HnswGraph>> m_layers;
+    std::vector<std::string> m_traces;
+    bool m_modified;
+};
+
+} // namespace llmvis
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
@@ -13,8 +15,13 @@ public:
     
     bool loadFromFiles(const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
     bool loadFromSource(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
+    // Same, with the named vertex outputs captured by transform feedback,
+    // interleaved into one buffer in the order given
+    bool loadFromSource(const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                        const std::vector<std::string>& feedbackVaryings);
     
     void use();
+    GLuint getProgram() const { return m_programId; }
     void setUniform(const std::string& name, bool value);
     void setUniform(const std::string& name, int value);
     void setUniform(const std::string& name, float value);
@@ -23,8 +30,28 @@ public:
     void setUniform(const std::string& name, const glm::vec4& value);
     void setUniform(const std::string& name, const glm::mat4& value);
     
+    // Uniform locations are resolved once at link time; hot paths keep the
+    // handle and use the overloads below. -1 if the program has no such uniform
+    GLint getUniformLocation(const std::string& name) const;
+    void setUniform(GLint location, int value);
+    void setUniform(GLint location, unsigned int value);
+    void setUniform(GLint location, float value);
+    void setUniform(GLint location, const glm::vec2& value);
+    void setUniform(GLint location, const glm::vec3& value);
+    void setUniform(GLint location, const glm::vec4& value);
+    void setUniform(GLint location, const glm::mat4& value);
+    // Uniform arrays, from element 0
+    void setUniform(GLint location, const float* values, int count);
+    void setUniform(GLint location, const glm::vec4* values, int count);
+    
+    // Attaches a named uniform block to a binding point shared across programs
+    void bindUniformBlock(const std::string& blockName, GLuint bindingPoint);
+    
 private:
     GLuint m_programId;
+    std::unordered_map<std::string, GLint> m_uniformLocations;
+    
+    void cacheUniformLocations();
     
     bool checkCompileErrors(GLuint shader, const std::string& type);
 };
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace llmvis {
+
+// Instances whose placement is fixed once a model is loaded. Their geometry
+// (a few vec4s each) goes to the GPU once, when appended; their colours live
+// in a second buffer and only the range that changed since the last upload
+// is sent again. Both buffers keep their names across growth, so meshes can
+// bind them as instance attributes up front
+class StaticInstanceBuffer {
+public:
+    explicit StaticInstanceBuffer(int geometryVectors);
+    ~StaticInstanceBuffer();
+
+    // Generates the buffer names; storage follows on upload()
+    void createBuffers();
+
+    // Appends count instances of geometryVectors vec4s each, coloured
+    // transparent black, and returns the first one's index
+    int append(const glm::vec4* geometry, int count);
+    // Colours of instances [first, first + count); unchanged ones are skipped
+    void setColors(int first, const glm::vec4* colors, int count);
+    void clear();
+
+    // Sends new geometry and changed colours; returns the bytes sent
+    size_t upload();
+
+    int getInstanceCount() const { return static_cast<int>(m_colors.size()); }
+    GLuint getGeometryBuffer() const { return m_geometryBuffer; }
+    GLuint getColorBuffer() const { return m_colorBuffer; }
+
+private:
+    int m_geometryVectors;
+    GLuint m_geometryBuffer;
+    GLuint m_colorBuffer;
+    size_t m_capacity;          // instances the GL buffers hold
+    int m_uploadedInstances;    // instances whose geometry the GL buffer has
+
+    std::vector<glm::vec4> m_geometry;
+    std::vector<glm::vec4> m_colors;
+    int m_dirtyBegin;           // colour range changed since the last upload
+    int m_dirtyEnd;
+};
+
+} // namespace llmvis
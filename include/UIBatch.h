@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "GlyphAtlas.h"
+
+namespace llmvis {
+
+// Vertex of the 2D overlay stream: screen position, atlas coordinate, color
+struct UIVertex {
+    glm::vec2 position;
+    glm::vec2 texCoord;
+    glm::vec4 color;
+};
+
+// Single-channel texture quad in the stream, drawn through the colormap
+struct UIHeatmap {
+    unsigned int texture;
+    int firstVertex;   // its six vertices start here
+};
+
+// Immediate-mode 2D layer. Rects, lines and text are recorded in call order
+// into one vertex stream of atlas-textured quads (solid shapes sample the
+// atlas' solid cell), so a whole overlay is a single draw however many
+// widgets it has, plus one per heatmap. Coordinates are window pixels,
+// origin top-left
+class UIBatch {
+public:
+    explicit UIBatch(const GlyphAtlas& atlas);
+
+    void addRect(float x, float y, float width, float height, const glm::vec4& color);
+    void addLine(const glm::vec2& from, const glm::vec2& to, float width, const glm::vec4& color);
+    void addText(const std::string& text, const glm::vec2& position, float scale, const glm::vec4& color);
+    // Width addText would cover, for aligning labels
+    float measureText(const std::string& text, float scale) const;
+    // Quad sampling texture instead of the atlas, over [uvMin, uvMax] from its
+    // top-left corner. Each one splits the stream into another draw
+    void addHeatmap(unsigned int texture, float x, float y, float width, float height,
+                    const glm::vec2& uvMin, const glm::vec2& uvMax, float alpha);
+
+    const std::vector<UIVertex>& getVertices() const { return m_vertices; }
+    const std::vector<UIHeatmap>& getHeatmaps() const { return m_heatmaps; }
+    int getQuadCount() const { return static_cast<int>(m_vertices.size() / 6); }
+    void clear() {
+        m_vertices.clear();
+        m_heatmaps.clear();
+    }
+
+private:
+    const GlyphAtlas& m_atlas;
+    std::vector<UIVertex> m_vertices;
+    std::vector<UIHeatmap> m_heatmaps;
+
+    // Corners in order around the quad; uv maps min to max axis-aligned
+    void addQuad(const glm::vec2* corners, const glm::vec2& uvMin, const glm::vec2& uvMax, const glm::vec4& color);
+};
+
+} // namespace llmvis
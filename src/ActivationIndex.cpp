@@ -0,0 +1,360 @@
+#include "ActivationIndex.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace llmvis {
+
+namespace {
+
+const char kIndexMagic[8] = { 'L', 'L', 'M', 'V', 'T', 'O', 'P', 'K' };
+const uint32_t kIndexVersion = 1;
+const uint32_t kEmptySlot = std::numeric_limits<uint32_t>::max();
+
+// On-disk layout:
+//   IndexHeader
+//   uint32_t layerSizes[layerCount]         (padded to 8 bytes)
+//   TopActivation entries[neurons * topK]   (sorted descending, empty slots marked)
+//   uint64_t textOffsets[contextCount + 1]
+//   char text[]
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t topK;
+    uint32_t layerCount;
+    uint32_t contextCount;
+    uint64_t entriesOffset;
+    uint64_t textOffsetsOffset;
+    uint64_t textOffset;
+};
+
+// Min-heap on activation so the weakest of the current top-K sits at the front
+bool heapGreater(const TopActivation& a, const TopActivation& b) {
+    return a.activation > b.activation;
+}
+
+uint64_t alignTo8(uint64_t value) {
+    return (value + 7) & ~uint64_t(7);
+}
+
+} // namespace
+
+ActivationIndexBuilder::ActivationIndexBuilder(const std::vector<int>& layerSizes, int topK)
+    : m_layerSizes(layerSizes)
+    , m_neuronCount(0)
+    , m_topK(std::max(1, topK))
+    , m_contextCount(0)
+{
+    m_layerOffsets.reserve(layerSizes.size());
+    for (int size : layerSizes) {
+        m_layerOffsets.push_back(m_neuronCount);
+        m_neuronCount += size;
+    }
+}
+
+ActivationIndexBuilder::~ActivationIndexBuilder() {
+}
+
+void ActivationIndexBuilder::pushToShard(Shard& shard, uint64_t neuron, float activation, uint32_t contextId) const {
+    TopActivation* heap = &shard.heaps[neuron * m_topK];
+    uint32_t& size = shard.heapSizes[neuron];
+
+    if (size < static_cast<uint32_t>(m_topK)) {
+        heap[size++] = { activation, contextId };
+        std::push_heap(heap, heap + size, heapGreater);
+    } else if (activation > heap[0].activation) {
+        // Replace the weakest entry
+        std::pop_heap(heap, heap + size, heapGreater);
+        heap[size - 1] = { activation, contextId };
+        std::push_heap(heap, heap + size, heapGreater);
+    }
+}
+
+void ActivationIndexBuilder::build(uint32_t contextCount, const ActivationSource& source, int threadCount) {
+    m_contextCount = contextCount;
+    m_contextTexts.resize(contextCount);
+
+    threadCount = std::max(1, threadCount);
+    std::vector<Shard> shards(threadCount);
+    std::atomic<uint32_t> nextContext(0);
+
+    auto worker = [&](int threadIndex) {
+        Shard& shard = shards[threadIndex];
+        shard.heaps.resize(m_neuronCount * m_topK);
+        shard.heapSizes.assign(m_neuronCount, 0);
+
+        std::vector<std::vector<float>> activations(m_layerSizes.size());
+
+        // Contexts are handed out dynamically so uneven prompt lengths balance out
+        uint32_t contextId;
+        while ((contextId = nextContext.fetch_add(1)) < contextCount) {
+            source(threadIndex, contextId, activations);
+
+            for (size_t layer = 0; layer < m_layerSizes.size(); ++layer) {
+                const std::vector<float>& values = activations[layer];
+                size_t count = std::min(values.size(), static_cast<size_t>(m_layerSizes[layer]));
+                uint64_t base = m_layerOffsets[layer];
+
+                for (size_t i = 0; i < count; ++i) {
+                    pushToShard(shard, base + i, values[i], contextId);
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    mergeShards(shards);
+}
+
+void ActivationIndexBuilder::mergeShards(std::vector<Shard>& shards) {
+    m_merged.assign(m_neuronCount * m_topK, { 0.0f, kEmptySlot });
+
+    std::vector<TopActivation> candidates;
+    candidates.reserve(shards.size() * m_topK);
+
+    for (uint64_t neuron = 0; neuron < m_neuronCount; ++neuron) {
+        candidates.clear();
+        for (const Shard& shard : shards) {
+            const TopActivation* heap = &shard.heaps[neuron * m_topK];
+            candidates.insert(candidates.end(), heap, heap + shard.heapSizes[neuron]);
+        }
+
+        size_t keep = std::min(candidates.size(), static_cast<size_t>(m_topK));
+        std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end(), heapGreater);
+        std::copy(candidates.begin(), candidates.begin() + keep, m_merged.begin() + neuron * m_topK);
+    }
+}
+
+void ActivationIndexBuilder::setContextText(uint32_t contextId, const std::string& text) {
+    if (contextId >= m_contextTexts.size()) {
+        m_contextTexts.resize(contextId + 1);
+        m_contextCount = std::max(m_contextCount, contextId + 1);
+    }
+    m_contextTexts[contextId] = text;
+}
+
+bool ActivationIndexBuilder::write(const std::string& filePath) const {
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to open activation index for writing: " << filePath << std::endl;
+        return false;
+    }
+
+    IndexHeader header;
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexVersion;
+    header.topK = m_topK;
+    header.layerCount = static_cast<uint32_t>(m_layerSizes.size());
+    header.contextCount = m_contextCount;
+    header.entriesOffset = alignTo8(sizeof(IndexHeader) + sizeof(uint32_t) * m_layerSizes.size());
+    header.textOffsetsOffset = header.entriesOffset + sizeof(TopActivation) * m_merged.size();
+    header.textOffset = header.textOffsetsOffset + sizeof(uint64_t) * (uint64_t(m_contextCount) + 1);
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<uint32_t> sizes(m_layerSizes.begin(), m_layerSizes.end());
+    file.write(reinterpret_cast<const char*>(sizes.data()), sizeof(uint32_t) * sizes.size());
+
+    static const char padding[8] = {};
+    uint64_t written = sizeof(IndexHeader) + sizeof(uint32_t) * sizes.size();
+    file.write(padding, header.entriesOffset - written);
+
+    file.write(reinterpret_cast<const char*>(m_merged.data()), sizeof(TopActivation) * m_merged.size());
+
+    std::vector<uint64_t> textOffsets(uint64_t(m_contextCount) + 1, 0);
+    for (uint32_t i = 0; i < m_contextCount; ++i) {
+        size_t length = i < m_contextTexts.size() ? m_contextTexts[i].size() : 0;
+        textOffsets[i + 1] = textOffsets[i] + length;
+    }
+    file.write(reinterpret_cast<const char*>(textOffsets.data()), sizeof(uint64_t) * textOffsets.size());
+
+    for (uint32_t i = 0; i < m_contextCount && i < m_contextTexts.size(); ++i) {
+        file.write(m_contextTexts[i].data(), m_contextTexts[i].size());
+    }
+
+    if (!file) {
+        std::cerr << "Failed to write activation index: " << filePath << std::endl;
+        return false;
+    }
+
+    std::cout << "Wrote activation index (" << m_neuronCount << " neurons, top-" << m_topK
+              << ", " << m_contextCount << " contexts) to " << filePath << std::endl;
+    return true;
+}
+
+ActivationIndex::ActivationIndex()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_topK(0)
+    , m_contextCount(0)
+    , m_entries(nullptr)
+    , m_textOffsets(nullptr)
+    , m_text(nullptr)
+{
+}
+
+ActivationIndex::~ActivationIndex() {
+    close();
+}
+
+bool ActivationIndex::open(const std::string& filePath) {
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(IndexHeader))) {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map activation index: " << filePath << std::endl;
+        return false;
+    }
+
+    m_data = static_cast<const unsigned char*>(mapping);
+    m_size = info.st_size;
+#else
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    m_fallbackBuffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(m_fallbackBuffer.data()), m_fallbackBuffer.size());
+    m_data = m_fallbackBuffer.data();
+    m_size = m_fallbackBuffer.size();
+#endif
+
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(m_data);
+    if (m_size < sizeof(IndexHeader) ||
+        std::memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+        header->version != kIndexVersion || header->topK == 0) {
+        std::cerr << "Invalid activation index: " << filePath << std::endl;
+        close();
+        return false;
+    }
+
+    // Every section must lie inside the file, in order, before anything in
+    // it is read; sizes are checked against the bytes left so nothing overflows
+    uint64_t size = m_size;
+    uint64_t sizesEnd = sizeof(IndexHeader) + sizeof(uint32_t) * uint64_t(header->layerCount);
+    bool valid = sizesEnd <= size && header->entriesOffset >= sizesEnd && header->entriesOffset <= size &&
+                 header->entriesOffset % alignof(TopActivation) == 0;
+    uint64_t neuronCount = 0;
+    if (valid) {
+        const uint32_t* sizes = reinterpret_cast<const uint32_t*>(m_data + sizeof(IndexHeader));
+        for (uint32_t i = 0; i < header->layerCount; ++i) {
+            valid = valid && sizes[i] <= static_cast<uint32_t>(std::numeric_limits<int>::max());
+            neuronCount += sizes[i];
+        }
+        uint64_t entrySlots = (size - header->entriesOffset) / sizeof(TopActivation);
+        valid = valid && neuronCount <= entrySlots / header->topK;
+    }
+    if (valid) {
+        uint64_t entriesEnd = header->entriesOffset + neuronCount * header->topK * sizeof(TopActivation);
+        valid = header->textOffsetsOffset >= entriesEnd && header->textOffsetsOffset <= size &&
+                header->textOffsetsOffset % alignof(uint64_t) == 0 &&
+                uint64_t(header->contextCount) + 1 <= (size - header->textOffsetsOffset) / sizeof(uint64_t);
+    }
+    if (valid) {
+        uint64_t textOffsetsEnd = header->textOffsetsOffset + (uint64_t(header->contextCount) + 1) * sizeof(uint64_t);
+        valid = header->textOffset >= textOffsetsEnd && header->textOffset <= size;
+    }
+    if (valid) {
+        // Text offsets never decrease and the last one ends inside the file
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*>(m_data + header->textOffsetsOffset);
+        uint64_t textSize = size - header->textOffset;
+        for (uint32_t i = 0; i <= header->contextCount && valid; ++i) {
+            valid = offsets[i] <= textSize && (i == 0 || offsets[i] >= offsets[i - 1]);
+        }
+    }
+    if (!valid) {
+        std::cerr << "Truncated or corrupt activation index: " << filePath << std::endl;
+        close();
+        return false;
+    }
+
+    m_topK = header->topK;
+    m_contextCount = header->contextCount;
+
+    const uint32_t* sizes = reinterpret_cast<const uint32_t*>(m_data + sizeof(IndexHeader));
+    neuronCount = 0;
+    for (uint32_t i = 0; i < header->layerCount; ++i) {
+        m_layerSizes.push_back(sizes[i]);
+        m_layerOffsets.push_back(neuronCount);
+        neuronCount += sizes[i];
+    }
+
+    m_entries = reinterpret_cast<const TopActivation*>(m_data + header->entriesOffset);
+    m_textOffsets = reinterpret_cast<const uint64_t*>(m_data + header->textOffsetsOffset);
+    m_text = reinterpret_cast<const char*>(m_data + header->textOffset);
+    return true;
+}
+
+void ActivationIndex::close() {
+#ifndef _WIN32
+    if (m_data && m_fallbackBuffer.empty()) {
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+    }
+#endif
+    m_fallbackBuffer.clear();
+    m_data = nullptr;
+    m_size = 0;
+    m_topK = 0;
+    m_contextCount = 0;
+    m_layerSizes.clear();
+    m_layerOffsets.clear();
+    m_entries = nullptr;
+    m_textOffsets = nullptr;
+    m_text = nullptr;
+}
+
+const TopActivation* ActivationIndex::query(int layerIndex, int neuronIndex, int& count) const {
+    count = 0;
+    if (!m_data || layerIndex < 0 || layerIndex >= static_cast<int>(m_layerSizes.size()) ||
+        neuronIndex < 0 || neuronIndex >= m_layerSizes[layerIndex]) {
+        return nullptr;
+    }
+
+    const TopActivation* entries = m_entries + (m_layerOffsets[layerIndex] + neuronIndex) * m_topK;
+    while (count < m_topK && entries[count].contextId != kEmptySlot) {
+        count++;
+    }
+    return entries;
+}
+
+std::string ActivationIndex::getContextText(uint32_t contextId) const {
+    if (!m_data || contextId >= m_contextCount) {
+        return std::string();
+    }
+    return std::string(m_text + m_textOffsets[contextId], m_textOffsets[contextId + 1] - m_textOffsets[contextId]);
+}
+
+} // namespace llmvis
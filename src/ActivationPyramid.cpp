@@ -0,0 +1,98 @@
+#include "ActivationPyramid.h"
+#include <algorithm>
+
+namespace llmvis {
+
+ActivationPyramid::ActivationPyramid()
+    : m_valueCount(0)
+{
+}
+
+void ActivationPyramid::clear() {
+    m_valueCount = 0;
+    m_levels.clear();
+}
+
+int ActivationPyramid::update(const std::vector<float>& values) {
+    if (static_cast<int>(values.size()) != m_valueCount) {
+        rebuild(values);
+        return m_valueCount;
+    }
+
+    // Runs of leaves that changed
+    std::vector<PyramidEntry>& leaves = m_levels[0];
+    m_dirty.clear();
+    int changed = 0;
+    for (int i = 0; i < m_valueCount; i++) {
+        float value = values[i];
+        if (value == leaves[i].mean) continue;
+        leaves[i] = { value, value, value };
+        changed++;
+        if (!m_dirty.empty() && m_dirty.back().end == i) {
+            m_dirty.back().end++;
+        } else {
+            m_dirty.push_back({ i, i + 1 });
+        }
+    }
+
+    // Walk each run up to the root; neighbouring runs meet in a shared parent
+    for (int level = 1; level < getLevelCount() && !m_dirty.empty(); level++) {
+        m_parentDirty.clear();
+        for (const Range& range : m_dirty) {
+            Range parent = { range.begin >> 1, ((range.end - 1) >> 1) + 1 };
+            if (!m_parentDirty.empty() && m_parentDirty.back().end >= parent.begin) {
+                m_parentDirty.back().end = std::max(m_parentDirty.back().end, parent.end);
+            } else {
+                m_parentDirty.push_back(parent);
+            }
+        }
+        for (const Range& range : m_parentDirty) {
+            for (int i = range.begin; i < range.end; i++) {
+                reduceEntry(level, i);
+            }
+        }
+        m_dirty.swap(m_parentDirty);
+    }
+    return changed;
+}
+
+void ActivationPyramid::rebuild(const std::vector<float>& values) {
+    m_valueCount = static_cast<int>(values.size());
+    m_levels.clear();
+    if (values.empty()) return;
+
+    m_levels.emplace_back(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        m_levels[0][i] = { values[i], values[i], values[i] };
+    }
+    for (int level = 1; m_levels.back().size() > 1; level++) {
+        m_levels.emplace_back((m_levels.back().size() + 1) / 2);
+        for (int i = 0; i < static_cast<int>(m_levels[level].size()); i++) {
+            reduceEntry(level, i);
+        }
+    }
+}
+
+void ActivationPyramid::reduceEntry(int level, int index) {
+    const std::vector<PyramidEntry>& children = m_levels[level - 1];
+    const PyramidEntry& left = children[index * 2];
+    int right = index * 2 + 1;
+    if (right >= static_cast<int>(children.size())) {
+        m_levels[level][index] = left;
+        return;
+    }
+
+    // The last child of a level may cover fewer values than the rest, so
+    // weight the means by how many values each child spans
+    int span = 1 << (level - 1);
+    float leftCount = static_cast<float>(span);
+    float rightCount = static_cast<float>(std::min(span, m_valueCount - right * span));
+    const PyramidEntry& other = children[right];
+
+    PyramidEntry& entry = m_levels[level][index];
+    entry.min = std::min(left.min, other.min);
+    entry.max = std::max(left.max, other.max);
+    entry.mean = (left.mean * leftCount + other.mean * rightCount) / (leftCount + rightCount);
+}
+
+} // namespace llmvis
@@ -0,0 +1,130 @@
+#include "ActivationTexture.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace llmvis {
+
+ActivationTexture::ActivationTexture()
+    : m_texture(0)
+    , m_nextPixelBuffer(0)
+    , m_valueCount(0)
+    , m_columns(0)
+    , m_rows(0)
+    , m_valueRange(0.0f)
+{
+    m_pixelBuffers[0] = 0;
+    m_pixelBuffers[1] = 0;
+}
+
+ActivationTexture::~ActivationTexture() {
+    if (m_texture) {
+        glDeleteTextures(1, &m_texture);
+        m_texture = 0;
+    }
+    if (m_pixelBuffers[0]) {
+        glDeleteBuffers(2, m_pixelBuffers);
+        m_pixelBuffers[0] = m_pixelBuffers[1] = 0;
+    }
+}
+
+bool ActivationTexture::resize(int valueCount, int columns) {
+    columns = std::max(1, std::min(columns, std::max(valueCount, 1)));
+    if (m_texture && valueCount == m_valueCount && columns == m_columns) return false;
+
+    m_valueCount = valueCount;
+    m_columns = columns;
+    m_rows = std::max(1, (valueCount + columns - 1) / columns);
+    m_valueRange = 0.0f;
+    m_uploaded.assign(static_cast<size_t>(m_columns) * m_rows, 0.0f);
+
+    if (!m_texture) {
+        glGenTextures(1, &m_texture);
+        glGenBuffers(2, m_pixelBuffers);
+    }
+
+    // Start from zeros; the first update() then sends only non-zero rows.
+    // Nearest filtering keeps one texel per neuron
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_columns, m_rows, 0, GL_RED, GL_FLOAT, m_uploaded.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
+
+int ActivationTexture::update(const std::vector<float>& values) {
+    if (!m_texture) return 0;
+
+    int count = std::min(static_cast<int>(values.size()), m_valueCount);
+    size_t rowBytes = static_cast<size_t>(m_columns) * sizeof(float);
+
+    // Runs of consecutive rows that differ from what the texture holds
+    m_runs.clear();
+    float range = 0.0f;
+    for (int row = 0; row < m_rows; row++) {
+        int begin = row * m_columns;
+        int end = std::min(begin + m_columns, count);
+        bool dirty = false;
+        for (int i = begin; i < end; i++) {
+            range = std::max(range, std::fabs(values[i]));
+            dirty = dirty || values[i] != m_uploaded[i];
+        }
+        if (!dirty) continue;
+
+        if (!m_runs.empty() && m_runs.back().firstRow + m_runs.back().rowCount == row) {
+            m_runs.back().rowCount++;
+        } else {
+            m_runs.push_back({ row, 1 });
+        }
+    }
+    m_valueRange = range;
+    if (m_runs.empty()) return 0;
+
+    int dirtyRows = 0;
+    for (const RowRun& run : m_runs) {
+        dirtyRows += run.rowCount;
+    }
+
+    // Pack the runs back to back into the next pixel buffer; orphaning it
+    // lets the driver hand out fresh storage instead of syncing
+    GLuint pixelBuffer = m_pixelBuffers[m_nextPixelBuffer];
+    m_nextPixelBuffer = 1 - m_nextPixelBuffer;
+    size_t bytes = dirtyRows * rowBytes;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+    float* mapped = static_cast<float*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (!mapped) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return 0;
+    }
+
+    size_t offset = 0;
+    for (const RowRun& run : m_runs) {
+        size_t first = static_cast<size_t>(run.firstRow) * m_columns;
+        size_t length = static_cast<size_t>(run.rowCount) * m_columns;
+        size_t valid = std::min(length, static_cast<size_t>(std::max(count - static_cast<int>(first), 0)));
+        std::copy(values.begin() + first, values.begin() + first + valid, m_uploaded.begin() + first);
+        std::memcpy(mapped + offset, &m_uploaded[first], length * sizeof(float));
+        offset += length;
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // With an unpack buffer bound, the data pointer is an offset into it
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    offset = 0;
+    for (const RowRun& run : m_runs) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, run.firstRow, m_columns, run.rowCount, GL_RED, GL_FLOAT,
+                        (void*)(offset * sizeof(float)));
+        offset += static_cast<size_t>(run.rowCount) * m_columns;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    return dirtyRows;
+}
+
+} // namespace llmvis
@@ -2,20 +2,34 @@
 #include <algorithm>
 #include <cmath>
 #include <random>
+#include <limits>
+#include <atomic>
 
 namespace llmvis {
 
-AttentionHead::AttentionHead(int id, int dimensions)
+namespace {
+
+// Source of cache ids; heads on other threads draw from it too
+std::atomic<uint64_t> s_nextCacheId(1);
+
+} // namespace
+
+AttentionHead::AttentionHead(int id, int dimensions, unsigned int seed)
     : m_id(id)
     , m_dimensions(dimensions)
     , m_isHighlighted(false)
     , m_position(0.0f)
     , m_visualScale(1.0f)
+    , m_sequenceLength(0)
+    , m_sequenceId(0)
+    , m_cacheId(s_nextCacheId++)
 {
-    // Initialize random matrices (for visualization purposes)
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(-0.5f, 0.5f);
+    // Initialize random matrices (for visualization purposes). Seeded so that
+    // separately loaded copies of the model compute identical activations, and
+    // scaled so projections keep roughly unit variance
+    std::mt19937 gen(seed * 1000u + static_cast<unsigned int>(id));
+    float range = std::sqrt(3.0f / std::max(1, dimensions));
+    std::uniform_real_distribution<float> dis(-range, range);
     
     // Query matrix
     m_queryMatrix.resize(dimensions);
@@ -46,7 +60,7 @@ AttentionHead::AttentionHead(int id, int dimensions)
     
     // Initialize output and attention weights
     m_output.resize(dimensions, 0.0f);
-    m_attentionWeights.resize(1); // Will be resized during computation
+    m_attentionWeights.clear(); // Grows one row per appended token
 }
 
 AttentionHead::~AttentionHead() {
@@ -59,46 +73,188 @@ void AttentionHead::update(float deltaTime) {
 void AttentionHead::computeAttention(const std::vector<float>& queryInput, 
                                     const std::vector<float>& keyInput,
                                     const std::vector<float>& valueInput) {
-    // Simplified attention mechanism for visualization
-    // In a real implementation, this would be a proper self-attention calculation
+    // Full causal self-attention: replay the sequence through the decode step
+    resetSequence();
     
     int sequenceLength = queryInput.size() / m_dimensions;
-    
-    // Resize attention weights matrix
-    m_attentionWeights.resize(sequenceLength);
-    for (auto& row : m_attentionWeights) {
-        row.resize(sequenceLength, 0.0f);
+    for (int i = 0; i < sequenceLength; i++) {
+        size_t offset = static_cast<size_t>(i) * m_dimensions;
+        appendToken(&queryInput[offset], &keyInput[offset], &valueInput[offset]);
     }
+}
+
+void AttentionHead::appendToken(const float* queryInput, const float* keyInput, const float* valueInput) {
+    int position = m_sequenceLength++;
     
-    // Compute query, key, value projections (simplified)
-    std::vector<float> queryProjection(m_dimensions, 0.0f);
-    std::vector<float> keyProjection(m_dimensions, 0.0f);
-    std::vector<float> valueProjection(m_dimensions, 0.0f);
+    m_queryCache.resize(static_cast<size_t>(m_sequenceLength) * m_dimensions);
+    m_keyCache.resize(static_cast<size_t>(m_sequenceLength) * m_dimensions);
+    m_valueCache.resize(static_cast<size_t>(m_sequenceLength) * m_dimensions);
+    float* query = &m_queryCache[static_cast<size_t>(position) * m_dimensions];
+    project(m_queryMatrix, queryInput, query);
+    project(m_keyMatrix, keyInput, &m_keyCache[static_cast<size_t>(position) * m_dimensions]);
+    project(m_valueMatrix, valueInput, &m_valueCache[static_cast<size_t>(position) * m_dimensions]);
     
-    // Just for visualization, use random projections
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+    m_weightRow.resize(m_sequenceLength);
+    m_rowNormalizers.push_back(computeWeights(position, m_weightRow.data()));
     
-    // Fill attention weights with random values (for visualization)
+    // Weighted sum of cached values
+    std::fill(m_output.begin(), m_output.end(), 0.0f);
+    for (int j = 0; j < m_sequenceLength; j++) {
+        const float* value = &m_valueCache[static_cast<size_t>(j) * m_dimensions];
+        for (int d = 0; d < m_dimensions; d++) {
+            m_output[d] += m_weightRow[j] * value[d];
+        }
+    }
+    
+    m_attentionWeights.appendRow(m_weightRow.data());
+}
+
+float AttentionHead::computeWeights(int position, float* weights) const {
+    // Scores against every cached key with an online softmax normalizer: the
+    // running sum is rescaled whenever a larger score comes along
+    float maxScore = -std::numeric_limits<float>::infinity();
     float sum = 0.0f;
-    for (int i = 0; i < sequenceLength; i++) {
-        for (int j = 0; j < sequenceLength; j++) {
-            m_attentionWeights[i][j] = dis(gen);
-            sum += m_attentionWeights[i][j];
+    for (int j = 0; j <= position; j++) {
+        float score = computeScore(position, j);
+        weights[j] = score;
+        if (score > maxScore) {
+            sum = sum * std::exp(maxScore - score) + 1.0f;
+            maxScore = score;
+        } else {
+            sum += std::exp(score - maxScore);
         }
     }
     
-    // Normalize attention weights (softmax-like)
-    for (int i = 0; i < sequenceLength; i++) {
-        for (int j = 0; j < sequenceLength; j++) {
-            m_attentionWeights[i][j] /= sum;
+    for (int j = 0; j <= position; j++) {
+        weights[j] = std::exp(weights[j] - maxScore) / sum;
+    }
+    return maxScore + std::log(sum);
+}
+
+float AttentionHead::computeScore(int queryPosition, int keyPosition) const {
+    const float* query = &m_queryCache[static_cast<size_t>(queryPosition) * m_dimensions];
+    const float* key = &m_keyCache[static_cast<size_t>(keyPosition) * m_dimensions];
+    float score = 0.0f;
+    for (int d = 0; d < m_dimensions; d++) {
+        score += query[d] * key[d];
+    }
+    return score / std::sqrt(static_cast<float>(m_dimensions));
+}
+
+void AttentionHead::computeAttentionTile(int queryBegin, int keyBegin, int stride, int size, float* weights) const {
+    for (int r = 0; r < size; r++) {
+        int query = queryBegin + r * stride;
+        float* row = weights + static_cast<size_t>(r) * size;
+        for (int c = 0; c < size; c++) {
+            int key = keyBegin + c * stride;
+            bool causal = query < m_sequenceLength && key <= query;
+            row[c] = causal ? std::exp(computeScore(query, key) - m_rowNormalizers[query]) : 0.0f;
+        }
+    }
+}
+
+void AttentionHead::resetSequence() {
+    m_sequenceLength = 0;
+    m_sequenceId++;
+    m_cacheId = s_nextCacheId++;
+    m_queryCache.clear();
+    m_keyCache.clear();
+    m_valueCache.clear();
+    m_rowNormalizers.clear();
+    m_attentionWeights.clear();
+    std::fill(m_output.begin(), m_output.end(), 0.0f);
+}
+
+void AttentionHead::backward(const float* outputGradient, float* inputGradient, int stride, int rowBegin, int rowEnd) {
+    rowEnd = std::min(rowEnd, m_sequenceLength);
+    if (rowBegin >= rowEnd) return;
+    
+    size_t size = static_cast<size_t>(rowEnd) * m_dimensions;
+    if (m_queryGradient.size() < size) {
+        m_queryGradient.resize(size);
+        m_keyGradient.resize(size);
+        m_valueGradient.resize(size);
+    }
+    if (m_scoreGradient.size() < static_cast<size_t>(rowEnd)) {
+        m_scoreGradient.resize(rowEnd);
+    }
+    if (m_weightRow.size() < static_cast<size_t>(rowEnd)) {
+        m_weightRow.resize(rowEnd);
+    }
+    std::fill(m_queryGradient.begin(), m_queryGradient.begin() + size, 0.0f);
+    std::fill(m_keyGradient.begin(), m_keyGradient.begin() + size, 0.0f);
+    std::fill(m_valueGradient.begin(), m_valueGradient.begin() + size, 0.0f);
+    
+    // Softmax and weighted-sum gradients from the cached weights, queries,
+    // keys and values. Weights come from storage when it holds them exactly,
+    // otherwise they are recomputed from the caches
+    float scale = 1.0f / std::sqrt(static_cast<float>(m_dimensions));
+    for (int i = rowBegin; i < rowEnd; i++) {
+        const float* gradient = outputGradient + static_cast<size_t>(i) * stride;
+        float* weights = m_weightRow.data();
+        if (m_attentionWeights.isExact()) {
+            m_attentionWeights.readRow(i, weights);
+        } else {
+            computeWeights(i, weights);
+        }
+        float* scoreGradient = m_scoreGradient.data();
+        
+        float weightedSum = 0.0f;
+        for (int j = 0; j <= i; j++) {
+            const float* value = &m_valueCache[static_cast<size_t>(j) * m_dimensions];
+            float* valueGradient = &m_valueGradient[static_cast<size_t>(j) * m_dimensions];
+            float dot = 0.0f;
+            for (int d = 0; d < m_dimensions; d++) {
+                dot += gradient[d] * value[d];
+                valueGradient[d] += weights[j] * gradient[d];
+            }
+            scoreGradient[j] = dot;
+            weightedSum += weights[j] * dot;
+        }
+        
+        const float* query = &m_queryCache[static_cast<size_t>(i) * m_dimensions];
+        float* queryGradient = &m_queryGradient[static_cast<size_t>(i) * m_dimensions];
+        for (int j = 0; j <= i; j++) {
+            float score = weights[j] * (scoreGradient[j] - weightedSum) * scale;
+            const float* key = &m_keyCache[static_cast<size_t>(j) * m_dimensions];
+            float* keyGradient = &m_keyGradient[static_cast<size_t>(j) * m_dimensions];
+            for (int d = 0; d < m_dimensions; d++) {
+                queryGradient[d] += score * key[d];
+                keyGradient[d] += score * query[d];
+            }
         }
     }
     
-    // Create output based on attention (simplified for visualization)
+    // Back through the projections; query, key and value all read the same input
+    for (int j = 0; j < rowEnd; j++) {
+        size_t offset = static_cast<size_t>(j) * m_dimensions;
+        float* gradient = inputGradient + static_cast<size_t>(j) * stride;
+        if (j >= rowBegin) {
+            projectTransposed(m_queryMatrix, &m_queryGradient[offset], gradient);
+        }
+        projectTransposed(m_keyMatrix, &m_keyGradient[offset], gradient);
+        projectTransposed(m_valueMatrix, &m_valueGradient[offset], gradient);
+    }
+}
+
+void AttentionHead::project(const std::vector<std::vector<float>>& matrix, const float* input, float* output) const {
+    for (int i = 0; i < m_dimensions; i++) {
+        const std::vector<float>& row = matrix[i];
+        float sum = 0.0f;
+        for (int j = 0; j < m_dimensions; j++) {
+            sum += row[j] * input[j];
+        }
+        output[i] = sum;
+    }
+}
+
+void AttentionHead::projectTransposed(const std::vector<std::vector<float>>& matrix, const float* gradient, float* output) const {
     for (int i = 0; i < m_dimensions; i++) {
-        m_output[i] = dis(gen) * 2.0f - 1.0f;
+        const std::vector<float>& row = matrix[i];
+        float scale = gradient[i];
+        for (int j = 0; j < m_dimensions; j++) {
+            output[j] += row[j] * scale;
+        }
     }
 }
 
@@ -106,10 +262,51 @@ const std::vector<float>& AttentionHead::getOutput() const {
     return m_output;
 }
 
-const std::vector<std::vector<float>>& AttentionHead::getAttentionWeights() const {
+const AttentionStorage& AttentionHead::getAttentionWeights() const {
     return m_attentionWeights;
 }
 
+void AttentionHead::readAttentionRow(int query, float* weights) const {
+    std::fill(weights, weights + query + 1, 0.0f);
+    accumulateAttentionRow(query, 1.0f, weights);
+}
+
+void AttentionHead::accumulateAttentionRow(int query, float scale, float* sums) const {
+    if (!m_attentionWeights.getPolicy().keepsNothing()) {
+        m_attentionWeights.accumulateRow(query, scale, sums);
+        return;
+    }
+    if (query < 0 || query >= m_sequenceLength) return;
+    
+    // Same weights as computeWeights(), from the row's saved normalizer
+    for (int key = 0; key <= query; key++) {
+        sums[key] += std::exp(computeScore(query, key) - m_rowNormalizers[query]) * scale;
+    }
+}
+
+void AttentionHead::setAttentionStoragePolicy(const AttentionStoragePolicy& policy) {
+    // Exact rows read back the same whether they are stored or recomputed
+    const AttentionStoragePolicy& previous = m_attentionWeights.getPolicy();
+    bool sameRows = (previous.isExact() || previous.keepsNothing()) && (policy.isExact() || policy.keepsNothing());
+    
+    if (m_attentionWeights.isExact()) {
+        m_attentionWeights.setPolicy(policy);
+    } else {
+        // Lossy rows are missing weights; rebuild each from the query/key
+        // cache the way appendToken() computed it
+        m_attentionWeights.clear();
+        m_attentionWeights.setPolicy(policy);
+        m_weightRow.resize(m_sequenceLength);
+        for (int i = 0; i < m_sequenceLength; i++) {
+            computeWeights(i, m_weightRow.data());
+            m_attentionWeights.appendRow(m_weightRow.data());
+        }
+    }
+    if (!sameRows) {
+        m_sequenceId++;
+    }
+}
+
 void AttentionHead::setHighlighted(bool isHighlighted) {
     m_isHighlighted = isHighlighted;
 }
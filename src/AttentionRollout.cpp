@@ -0,0 +1,186 @@
+#include "AttentionRollout.h"
+#include "Model.h"
+#include "Layer.h"
+#include <algorithm>
+#include <thread>
+
+namespace llmvis {
+
+namespace {
+
+// Rows per parallel work item and source rows per cache block
+const int kRowBlock = 16;
+const int kInnerBlock = 64;
+
+struct SumProduct {
+    float operator()(float acc, float a, float b) const { return acc + a * b; }
+};
+
+struct MaxMin {
+    float operator()(float acc, float a, float b) const { return std::max(acc, std::min(a, b)); }
+};
+
+// c[i][k] = combine over j of (a[i][j], b[j][k]) for rows [rowBegin, rowEnd).
+// Both inputs are lower triangular, so only k <= j <= i contributes. Source
+// rows are walked in blocks that stay cached while a block of output rows
+// consumes them, and the k loop is branch-free so it vectorizes.
+template <typename Combine>
+void chainRows(const float* a, const float* b, float* c, int stride, int rowBegin, int rowEnd) {
+    Combine combine;
+
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        std::fill(c + static_cast<size_t>(i) * stride, c + static_cast<size_t>(i) * stride + i + 1, 0.0f);
+    }
+
+    for (int j0 = 0; j0 < rowEnd; j0 += kInnerBlock) {
+        int j1 = std::min(j0 + kInnerBlock, rowEnd);
+        for (int i = std::max(rowBegin, j0); i < rowEnd; ++i) {
+            float* out = c + static_cast<size_t>(i) * stride;
+            const float* aRow = a + static_cast<size_t>(i) * stride;
+            int jEnd = std::min(j1, i + 1);
+            for (int j = j0; j < jEnd; ++j) {
+                float weight = aRow[j];
+                if (weight == 0.0f) continue;
+                const float* bRow = b + static_cast<size_t>(j) * stride;
+                for (int k = 0; k <= j; ++k) {
+                    out[k] = combine(out[k], weight, bRow[k]);
+                }
+            }
+        }
+    }
+}
+
+template <typename Combine>
+void chainRowsParallel(const float* a, const float* b, float* c, int stride, int rowBegin, int rowEnd) {
+    int blocks = (rowEnd - rowBegin + kRowBlock - 1) / kRowBlock;
+    int threadCount = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), blocks));
+
+    // Later rows are longer, so blocks are dealt round-robin to balance the work
+    auto worker = [&](int threadIndex) {
+        for (int block = threadIndex; block < blocks; block += threadCount) {
+            int begin = rowBegin + block * kRowBlock;
+            chainRows<Combine>(a, b, c, stride, begin, std::min(begin + kRowBlock, rowEnd));
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace
+
+AttentionRollout::AttentionRollout()
+    : m_mode(Mode::ROLLOUT)
+    , m_sequenceId(-1)
+    , m_tokenCount(0)
+    , m_capacity(0)
+{
+}
+
+AttentionRollout::~AttentionRollout() {
+}
+
+void AttentionRollout::setMode(Mode mode) {
+    if (mode != m_mode) {
+        m_mode = mode;
+        reset();
+    }
+}
+
+void AttentionRollout::reset() {
+    m_sequenceId = -1;
+    m_tokenCount = 0;
+    m_chain.clear();
+}
+
+void AttentionRollout::reserve(int tokenCount) {
+    if (tokenCount <= m_capacity) return;
+
+    // Grow geometrically and re-stride the rows already computed
+    int capacity = std::max(tokenCount, std::max(16, m_capacity * 2));
+    for (auto& matrix : m_chain) {
+        std::vector<float> grown(static_cast<size_t>(capacity) * capacity, 0.0f);
+        for (int i = 0; i < m_tokenCount; ++i) {
+            std::copy(matrix.begin() + static_cast<size_t>(i) * m_capacity,
+                      matrix.begin() + static_cast<size_t>(i) * m_capacity + i + 1,
+                      grown.begin() + static_cast<size_t>(i) * capacity);
+        }
+        matrix.swap(grown);
+    }
+    m_mixed.assign(static_cast<size_t>(capacity) * capacity, 0.0f);
+    m_capacity = capacity;
+}
+
+void AttentionRollout::update(Model* model) {
+    if (!model) return;
+
+    std::vector<Layer*> attentionLayers;
+    for (int i = 0; i < model->getLayerCount(); ++i) {
+        Layer* layer = model->getLayer(i);
+        if (layer->getType() == LayerType::ATTENTION && layer->getAttentionHeadCount() > 0) {
+            attentionLayers.push_back(layer);
+        }
+    }
+
+    // A new prompt invalidates everything; otherwise keep the rows we have
+    if (model->getSequenceId() != m_sequenceId || m_chain.size() != attentionLayers.size()) {
+        m_tokenCount = 0;
+        m_capacity = 0;
+        m_chain.assign(attentionLayers.size(), std::vector<float>());
+        m_sequenceId = model->getSequenceId();
+    }
+
+    int tokenCount = attentionLayers.empty() ? 0 : attentionLayers[0]->getAttentionHead(0)->getSequenceLength();
+    if (tokenCount <= m_tokenCount) return;
+
+    reserve(tokenCount);
+    int rowBegin = m_tokenCount;
+    int stride = m_capacity;
+
+    for (size_t l = 0; l < attentionLayers.size(); ++l) {
+        Layer* layer = attentionLayers[l];
+        int headCount = layer->getAttentionHeadCount();
+        float headScale = 0.5f / headCount;
+
+        // New rows of 0.5 * mean-over-heads(A) + 0.5 * I
+        for (int i = rowBegin; i < tokenCount; ++i) {
+            float* row = &m_mixed[static_cast<size_t>(i) * stride];
+            std::fill(row, row + i + 1, 0.0f);
+            for (int h = 0; h < headCount; ++h) {
+                layer->getAttentionHead(h)->accumulateAttentionRow(i, headScale, row);
+            }
+            row[i] += 0.5f;
+        }
+
+        float* out = m_chain[l].data();
+        if (l == 0) {
+            // Chaining onto the identity
+            for (int i = rowBegin; i < tokenCount; ++i) {
+                std::copy(&m_mixed[static_cast<size_t>(i) * stride], &m_mixed[static_cast<size_t>(i) * stride] + i + 1,
+                          out + static_cast<size_t>(i) * stride);
+            }
+        } else if (m_mode == Mode::ROLLOUT) {
+            chainRowsParallel<SumProduct>(m_mixed.data(), m_chain[l - 1].data(), out, stride, rowBegin, tokenCount);
+        } else {
+            chainRowsParallel<MaxMin>(m_mixed.data(), m_chain[l - 1].data(), out, stride, rowBegin, tokenCount);
+        }
+    }
+
+    m_tokenCount = tokenCount;
+}
+
+float AttentionRollout::getAttribution(int queryToken, int inputToken) const {
+    if (m_chain.empty() || queryToken < 0 || queryToken >= m_tokenCount ||
+        inputToken < 0 || inputToken > queryToken) {
+        return 0.0f;
+    }
+    return m_chain.back()[static_cast<size_t>(queryToken) * m_capacity + inputToken];
+}
+
+} // namespace llmvis
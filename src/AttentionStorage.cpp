@@ -0,0 +1,114 @@
+#include "AttentionStorage.h"
+#include <algorithm>
+#include <functional>
+
+namespace llmvis {
+
+AttentionStorage::AttentionStorage()
+    : m_policy({ 0, 1.0f })
+    , m_rows(0)
+{
+    m_rowStart.push_back(0);
+}
+
+void AttentionStorage::setPolicy(const AttentionStoragePolicy& policy) {
+    // Move what is stored aside, then read it back one row at a time and
+    // append each row under the new policy, so only one dense row is live
+    AttentionStorage previous;
+    previous.m_policy = m_policy;
+    previous.m_rows = m_rows;
+    previous.m_weights.swap(m_weights);
+    previous.m_keys.swap(m_keys);
+    previous.m_rowStart.swap(m_rowStart);
+
+    clear();
+    m_policy = policy;
+    std::vector<float> row(previous.m_rows);
+    for (int i = 0; i < previous.m_rows; i++) {
+        previous.readRow(i, row.data());
+        appendRow(row.data());
+    }
+}
+
+void AttentionStorage::appendRow(const float* weights) {
+    int length = m_rows + 1;
+    m_rows++;
+
+    if (isExact()) {
+        m_weights.insert(m_weights.end(), weights, weights + length);
+        return;
+    }
+    if (m_policy.massThreshold <= 0.0f) {
+        m_rowStart.push_back(m_weights.size());
+        return;
+    }
+
+    // Largest weights first, up to the top-k limit and the mass threshold
+    m_candidates.resize(length);
+    for (int key = 0; key < length; key++) {
+        m_candidates[key] = std::make_pair(weights[key], static_cast<uint32_t>(key));
+    }
+    int limit = m_policy.topK > 0 ? std::min(m_policy.topK, length) : length;
+    std::partial_sort(m_candidates.begin(), m_candidates.begin() + limit, m_candidates.end(),
+                      std::greater<std::pair<float, uint32_t>>());
+
+    int kept = 0;
+    float mass = 0.0f;
+    while (kept < limit && mass < m_policy.massThreshold && m_candidates[kept].first > 0.0f) {
+        mass += m_candidates[kept].first;
+        kept++;
+    }
+
+    // Entries in key order, so rows read front to back
+    std::sort(m_candidates.begin(), m_candidates.begin() + kept,
+              [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.second < b.second; });
+    for (int i = 0; i < kept; i++) {
+        m_weights.push_back(m_candidates[i].first);
+        m_keys.push_back(m_candidates[i].second);
+    }
+    m_rowStart.push_back(m_weights.size());
+}
+
+void AttentionStorage::clear() {
+    m_rows = 0;
+    m_weights.clear();
+    m_keys.clear();
+    m_rowStart.assign(1, 0);
+}
+
+void AttentionStorage::readRow(int query, float* weights) const {
+    std::fill(weights, weights + query + 1, 0.0f);
+    accumulateRow(query, 1.0f, weights);
+}
+
+void AttentionStorage::accumulateRow(int query, float scale, float* sums) const {
+    if (query < 0 || query >= m_rows) return;
+
+    if (isExact()) {
+        const float* row = &m_weights[packedOffset(query)];
+        for (int key = 0; key <= query; key++) {
+            sums[key] += row[key] * scale;
+        }
+        return;
+    }
+
+    for (size_t i = m_rowStart[query]; i < m_rowStart[query + 1]; i++) {
+        sums[m_keys[i]] += m_weights[i] * scale;
+    }
+}
+
+float AttentionStorage::getWeight(int query, int key) const {
+    if (query < 0 || query >= m_rows || key < 0 || key > query) return 0.0f;
+    if (isExact()) return m_weights[packedOffset(query) + key];
+
+    auto begin = m_keys.begin() + m_rowStart[query];
+    auto end = m_keys.begin() + m_rowStart[query + 1];
+    auto found = std::lower_bound(begin, end, static_cast<uint32_t>(key));
+    return (found != end && *found == static_cast<uint32_t>(key)) ? m_weights[found - m_keys.begin()] : 0.0f;
+}
+
+size_t AttentionStorage::getMemoryBytes() const {
+    return m_weights.size() * sizeof(float) + m_keys.size() * sizeof(uint32_t) + m_rowStart.size() * sizeof(size_t);
+}
+
+} // namespace llmvis
@@ -0,0 +1,102 @@
+#include "AttentionTexture.h"
+#include "AttentionHead.h"
+#include <algorithm>
+#include <cmath>
+
+namespace llmvis {
+
+namespace {
+
+const int kInitialCapacity = 64;
+const int kMaxRows = 4096;
+// Rows sent per update; recomputed rows are not free, so a long sequence
+// fills in over a few frames
+const int kMaxRowsPerUpdate = 256;
+
+unsigned char encodeWeight(float weight) {
+    return static_cast<unsigned char>(std::sqrt(std::min(std::max(weight, 0.0f), 1.0f)) * 255.0f + 0.5f);
+}
+
+} // namespace
+
+AttentionTexture::AttentionTexture()
+    : m_texture(0)
+    , m_capacity(0)
+    , m_rows(0)
+    , m_sequenceId(0)
+{
+}
+
+AttentionTexture::~AttentionTexture() {
+    if (m_texture) {
+        glDeleteTextures(1, &m_texture);
+        m_texture = 0;
+    }
+}
+
+int AttentionTexture::update(const AttentionHead& head) {
+    unsigned int sequenceId = head.getSequenceId();
+    int rows = std::min(head.getAttentionWeights().getRowCount(), kMaxRows);
+    if (m_texture && sequenceId == m_sequenceId && rows == m_rows) return 0;
+
+    // A restarted sequence rewrites rows from the top. Its rows overwrite
+    // everything up to their diagonals, so the upper triangle is still zero
+    if (sequenceId != m_sequenceId || rows < m_rows) {
+        m_sequenceId = sequenceId;
+        m_rows = 0;
+    }
+
+    // Grow by doubling; the old rows are sent again into the new storage
+    if (rows > m_capacity) {
+        int capacity = std::max(m_capacity, kInitialCapacity);
+        while (capacity < rows) {
+            capacity *= 2;
+        }
+        allocate(capacity);
+        m_rows = 0;
+    }
+    rows = std::min(rows, m_rows + kMaxRowsPerUpdate);
+
+    m_staging.clear();
+    m_row.resize(rows);
+    for (int row = m_rows; row < rows; row++) {
+        head.readAttentionRow(row, m_row.data());
+        for (int key = 0; key <= row; key++) {
+            m_staging.push_back(encodeWeight(m_row[key]));
+        }
+    }
+
+    // Rows of odd length need byte alignment
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    size_t offset = 0;
+    for (int row = m_rows; row < rows; row++) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, row + 1, 1, GL_RED, GL_UNSIGNED_BYTE, &m_staging[offset]);
+        offset += row + 1;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    m_rows = rows;
+    return static_cast<int>(m_staging.size());
+}
+
+void AttentionTexture::allocate(int capacity) {
+    m_capacity = capacity;
+    if (!m_texture) {
+        glGenTextures(1, &m_texture);
+    }
+
+    std::vector<unsigned char> zeros(static_cast<size_t>(capacity) * capacity, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, capacity, capacity, 0, GL_RED, GL_UNSIGNED_BYTE, zeros.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+} // namespace llmvis
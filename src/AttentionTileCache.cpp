@@ -0,0 +1,103 @@
+#include "AttentionTileCache.h"
+#include "AttentionHead.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace llmvis {
+
+namespace {
+
+// Rows of a tile whose queries the head has already processed
+int countFilledRows(const AttentionHead* head, int level, int tileRow) {
+    int stride = 1 << level;
+    int firstQuery = tileRow * (AttentionTileCache::kTileSize << level);
+    int rows = (head->getSequenceLength() - firstQuery + stride - 1) / stride;
+    return std::max(0, std::min(rows, static_cast<int>(AttentionTileCache::kTileSize)));
+}
+
+} // namespace
+
+size_t AttentionTileCache::TileKeyHash::operator()(const TileKey& key) const {
+    size_t hash = std::hash<uint64_t>()(key.cacheId);
+    hash = hash * 31 + static_cast<size_t>(key.level);
+    hash = hash * 31 + static_cast<size_t>(key.row);
+    hash = hash * 31 + static_cast<size_t>(key.column);
+    return hash;
+}
+
+AttentionTileCache::AttentionTileCache(int capacity)
+    : m_capacity(std::max(capacity, 1))
+    , m_computeCount(0)
+{
+}
+
+AttentionTileCache::~AttentionTileCache() {
+    clear();
+}
+
+GLuint AttentionTileCache::getTile(const AttentionHead* head, int level, int tileRow, int tileColumn, bool compute) {
+    TileKey key = { head->getCacheId(), level, tileRow, tileColumn };
+    auto found = m_lookup.find(key);
+    if (found != m_lookup.end()) {
+        m_tiles.splice(m_tiles.begin(), m_tiles, found->second);
+        Tile& tile = *found->second;
+        // Tiles on the sequence's growing edge pick up the rows added since
+        if (compute && tile.filledRows < countFilledRows(head, level, tileRow)) {
+            computeTile(head, tile);
+        }
+        return tile.texture;
+    }
+    if (!compute) return 0;
+
+    // Once full, the least recently used tile gives up its texture
+    Tile tile;
+    tile.key = key;
+    if (static_cast<int>(m_tiles.size()) >= m_capacity) {
+        tile.texture = m_tiles.back().texture;
+        m_lookup.erase(m_tiles.back().key);
+        m_tiles.pop_back();
+    } else {
+        glGenTextures(1, &tile.texture);
+        glBindTexture(GL_TEXTURE_2D, tile.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, kTileSize, kTileSize, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    m_tiles.push_front(tile);
+    m_lookup[key] = m_tiles.begin();
+    computeTile(head, m_tiles.front());
+    return tile.texture;
+}
+
+void AttentionTileCache::clear() {
+    for (const Tile& tile : m_tiles) {
+        glDeleteTextures(1, &tile.texture);
+    }
+    m_tiles.clear();
+    m_lookup.clear();
+}
+
+void AttentionTileCache::computeTile(const AttentionHead* head, Tile& tile) {
+    int stride = 1 << tile.key.level;
+    int span = kTileSize << tile.key.level;
+    m_weights.resize(static_cast<size_t>(kTileSize) * kTileSize);
+    head->computeAttentionTile(tile.key.row * span, tile.key.column * span, stride, kTileSize, m_weights.data());
+    tile.filledRows = countFilledRows(head, tile.key.level, tile.key.row);
+    m_computeCount++;
+
+    m_texels.resize(m_weights.size());
+    for (size_t i = 0; i < m_weights.size(); i++) {
+        m_texels[i] = static_cast<unsigned char>(std::sqrt(std::min(m_weights[i], 1.0f)) * 255.0f + 0.5f);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, tile.texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, kTileSize, kTileSize, GL_RED, GL_UNSIGNED_BYTE, m_texels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+} // namespace llmvis
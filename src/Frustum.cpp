@@ -0,0 +1,66 @@
+#include "Frustum.h"
+#include <algorithm>
+
+namespace llmvis {
+
+float BoundingBox::distanceTo(const glm::vec3& point) const {
+    glm::vec3 closest = glm::clamp(point, min, max);
+    return glm::length(point - closest);
+}
+
+bool BoundingBox::intersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float& distance) const {
+    glm::vec3 t0 = (min - origin) * inverseDirection;
+    glm::vec3 t1 = (max - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+    distance = entry;
+    return entry <= exit;
+}
+
+Frustum::Frustum() {
+    for (glm::vec4& plane : m_planes) {
+        plane = glm::vec4(0.0f);
+    }
+}
+
+void Frustum::update(const glm::mat4& viewProjection) {
+    // Gribb/Hartmann: each plane is the last row of the matrix plus or minus one
+    // of the others (glm is column-major, so row i is m[0][i], m[1][i], ...)
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+    
+    m_planes[0] = rows[3] + rows[0];   // left
+    m_planes[1] = rows[3] - rows[0];   // right
+    m_planes[2] = rows[3] + rows[1];   // bottom
+    m_planes[3] = rows[3] - rows[1];   // top
+    m_planes[4] = rows[3] + rows[2];   // near
+    m_planes[5] = rows[3] - rows[2];   // far
+    
+    for (glm::vec4& plane : m_planes) {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f) {
+            plane /= length;
+        }
+    }
+}
+
+bool Frustum::intersects(const BoundingBox& box) const {
+    for (const glm::vec4& plane : m_planes) {
+        // The box corner furthest along the plane normal
+        glm::vec3 corner(
+            plane.x >= 0.0f ? box.max.x : box.min.x,
+            plane.y >= 0.0f ? box.max.y : box.min.y,
+            plane.z >= 0.0f ? box.max.z : box.min.z
+        );
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace llmvis
@@ -0,0 +1,241 @@
+#include "InstanceBVH.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace llmvis {
+
+namespace {
+
+const int kLeafSize = 4;
+// Below this many spheres per worker, threads cost more than they save
+const int kMinSpheresPerThread = 16384;
+const int kMaxTraversalDepth = 64;
+
+BoundingBox emptyBox() {
+    BoundingBox box;
+    box.min = glm::vec3(std::numeric_limits<float>::max());
+    box.max = glm::vec3(-std::numeric_limits<float>::max());
+    return box;
+}
+
+void growBox(BoundingBox& box, const PickSphere& sphere) {
+    box.min = glm::min(box.min, sphere.center - glm::vec3(sphere.radius));
+    box.max = glm::max(box.max, sphere.center + glm::vec3(sphere.radius));
+}
+
+BoundingBox unionBox(const BoundingBox& a, const BoundingBox& b) {
+    BoundingBox box;
+    box.min = glm::min(a.min, b.min);
+    box.max = glm::max(a.max, b.max);
+    return box;
+}
+
+} // namespace
+
+InstanceBVH::InstanceBVH() {
+}
+
+int InstanceBVH::partition(int begin, int end, std::vector<BuildEntry>& entries, const BoundingBox& centers,
+                           BoundingBox& leftCenters, BoundingBox& rightCenters) {
+    // The centre box is the parent's cut at its split rather than measured;
+    // it may be loose, which only costs split quality, never correctness
+    glm::vec3 extent = centers.max - centers.min;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(entries.begin() + begin, entries.begin() + mid, entries.begin() + end,
+                     [axis](const BuildEntry& a, const BuildEntry& b) { return a.sphere.center[axis] < b.sphere.center[axis]; });
+    leftCenters = centers;
+    rightCenters = centers;
+    leftCenters.max[axis] = rightCenters.min[axis] = entries[mid].sphere.center[axis];
+    return mid;
+}
+
+void InstanceBVH::buildNode(std::vector<Node>& nodes, int nodeIndex, int begin, int end, std::vector<BuildEntry>& entries,
+                            const BoundingBox& centers) {
+    if (end - begin <= kLeafSize) {
+        BoundingBox bounds = emptyBox();
+        for (int i = begin; i < end; i++) {
+            growBox(bounds, entries[i].sphere);
+        }
+        nodes[nodeIndex] = { bounds, begin, end - begin };
+        return;
+    }
+
+    BoundingBox leftCenters;
+    BoundingBox rightCenters;
+    int mid = partition(begin, end, entries, centers, leftCenters, rightCenters);
+
+    int left = static_cast<int>(nodes.size());
+    nodes.resize(nodes.size() + 2);
+    buildNode(nodes, left, begin, mid, entries, leftCenters);
+    buildNode(nodes, left + 1, mid, end, entries, rightCenters);
+    nodes[nodeIndex] = { unionBox(nodes[left].bounds, nodes[left + 1].bounds), left, 0 };
+}
+
+void InstanceBVH::buildTop(int nodeIndex, int begin, int end, int levels, std::vector<BuildEntry>& entries,
+                           const BoundingBox& centers, std::vector<BuildTask>& tasks) {
+    if (levels == 0 || end - begin <= kLeafSize) {
+        tasks.push_back({ nodeIndex, begin, end, centers });
+        return;
+    }
+
+    BoundingBox leftCenters;
+    BoundingBox rightCenters;
+    int mid = partition(begin, end, entries, centers, leftCenters, rightCenters);
+
+    // Inner bounds are filled in once the subtrees below are built
+    int left = static_cast<int>(m_nodes.size());
+    m_nodes[nodeIndex] = { emptyBox(), left, 0 };
+    m_nodes.resize(m_nodes.size() + 2);
+    buildTop(left, begin, mid, levels - 1, entries, leftCenters, tasks);
+    buildTop(left + 1, mid, end, levels - 1, entries, rightCenters, tasks);
+}
+
+void InstanceBVH::build(const std::vector<PickSphere>& spheres) {
+    int count = static_cast<int>(spheres.size());
+    m_nodes.clear();
+    m_spheres.clear();
+    m_source.clear();
+    if (count == 0) return;
+    std::vector<BuildEntry> entries(count);
+    BoundingBox centers = emptyBox();
+    for (int i = 0; i < count; i++) {
+        entries[i] = { spheres[i], i };
+        centers.min = glm::min(centers.min, spheres[i].center);
+        centers.max = glm::max(centers.max, spheres[i].center);
+    }
+
+    // Split the top levels here until there is a subtree per worker
+    int threadCount = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()),
+                                           count / kMinSpheresPerThread));
+    int levels = 0;
+    while ((1 << levels) < threadCount) {
+        levels++;
+    }
+    std::vector<BuildTask> tasks;
+    m_nodes.resize(1);
+    buildTop(0, 0, count, levels, entries, centers, tasks);
+
+    // Each subtree goes into its own array, root first, and is appended after
+    std::vector<std::vector<Node>> subtrees(tasks.size());
+    auto worker = [&](int threadIndex) {
+        for (size_t t = threadIndex; t < tasks.size(); t += threadCount) {
+            subtrees[t].resize(1);
+            buildNode(subtrees[t], 0, tasks[t].begin, tasks[t].end, entries, tasks[t].centers);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Local child indices count from the subtree root, which takes the
+    // task's slot instead of being appended; the top levels' bounds follow
+    int topCount = static_cast<int>(m_nodes.size());
+    for (size_t t = 0; t < tasks.size(); t++) {
+        int offset = static_cast<int>(m_nodes.size()) - 1;
+        for (Node& node : subtrees[t]) {
+            if (node.count == 0) node.first += offset;
+        }
+        m_nodes[tasks[t].node] = subtrees[t][0];
+        m_nodes.insert(m_nodes.end(), subtrees[t].begin() + 1, subtrees[t].end());
+    }
+    for (int i = topCount - 1; i >= 0; i--) {
+        if (m_nodes[i].count == 0) {
+            m_nodes[i].bounds = unionBox(m_nodes[m_nodes[i].first].bounds, m_nodes[m_nodes[i].first + 1].bounds);
+        }
+    }
+
+    m_spheres.resize(count);
+    m_source.resize(count);
+    for (int i = 0; i < count; i++) {
+        m_spheres[i] = entries[i].sphere;
+        m_source[i] = entries[i].source;
+    }
+}
+
+void InstanceBVH::refit(const std::vector<PickSphere>& spheres) {
+    if (spheres.size() != m_source.size()) {
+        build(spheres);
+        return;
+    }
+    for (size_t i = 0; i < m_source.size(); i++) {
+        m_spheres[i] = spheres[m_source[i]];
+    }
+
+    // Children follow their parents, so a reverse sweep sees them first
+    for (int i = static_cast<int>(m_nodes.size()) - 1; i >= 0; i--) {
+        Node& node = m_nodes[i];
+        if (node.count > 0) {
+            node.bounds = emptyBox();
+            for (int s = node.first; s < node.first + node.count; s++) {
+                growBox(node.bounds, m_spheres[s]);
+            }
+        } else {
+            node.bounds = unionBox(m_nodes[node.first].bounds, m_nodes[node.first + 1].bounds);
+        }
+    }
+}
+
+bool InstanceBVH::intersect(const glm::vec3& origin, const glm::vec3& direction, PickHit& hit) const {
+    if (m_nodes.empty()) return false;
+    glm::vec3 inverseDirection = 1.0f / direction;
+    float closest = std::numeric_limits<float>::max();
+    int closestSphere = -1;
+
+    float entry;
+    if (!m_nodes[0].bounds.intersectRay(origin, inverseDirection, entry)) return false;
+
+    int stack[kMaxTraversalDepth];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = m_nodes[stack[--stackSize]];
+        if (node.count > 0) {
+            for (int s = node.first; s < node.first + node.count; s++) {
+                const PickSphere& sphere = m_spheres[s];
+                glm::vec3 toCenter = sphere.center - origin;
+                float t = glm::dot(toCenter, direction);
+                float distSq = glm::dot(toCenter, toCenter) - t * t;
+                float radiusSq = sphere.radius * sphere.radius;
+                if (distSq > radiusSq) continue;
+                float halfChord = std::sqrt(radiusSq - distSq);
+                if (t + halfChord < 0.0f) continue;
+                float distance = std::max(t - halfChord, 0.0f);
+                if (distance < closest) {
+                    closest = distance;
+                    closestSphere = s;
+                }
+            }
+            continue;
+        }
+
+        // Nearer child on top of the stack; children behind the best hit are skipped
+        float leftEntry;
+        float rightEntry;
+        bool hitLeft = m_nodes[node.first].bounds.intersectRay(origin, inverseDirection, leftEntry) && leftEntry < closest;
+        bool hitRight = m_nodes[node.first + 1].bounds.intersectRay(origin, inverseDirection, rightEntry) && rightEntry < closest;
+        if (hitLeft && hitRight) {
+            bool leftFirst = leftEntry <= rightEntry;
+            stack[stackSize++] = leftFirst ? node.first + 1 : node.first;
+            stack[stackSize++] = leftFirst ? node.first : node.first + 1;
+        } else if (hitLeft) {
+            stack[stackSize++] = node.first;
+        } else if (hitRight) {
+            stack[stackSize++] = node.first + 1;
+        }
+    }
+
+    if (closestSphere < 0) return false;
+    const PickSphere& sphere = m_spheres[closestSphere];
+    hit = { sphere.layer, sphere.neuron, sphere.head, closest };
+    return true;
+}
+
+} // namespace llmvis
@@ -3,18 +3,46 @@
 #include "Model.h"
 #include "Camera.h"
 #include "SimulationController.h"
+#include "ActivationIndex.h"
+#include "ResidualIndex.h"
+#include "AttentionRollout.h"
+#include "Layer.h"
 #include <iostream>
 #include <GLFW/glfw3.h>
+#include <limits>
+#include <algorithm>
 
 namespace llmvis {
 
+namespace {
+
+// Side of the attention map panel in pixels
+const float kAttentionMapSize = 512.0f;
+
+} // namespace
+
 LLMVisualization::LLMVisualization() 
-    : m_width(0)
+    : m_residualIndexLoaded(false)
+    , m_width(0)
     , m_height(0)
     , m_simulationSpeed(1.0f)
     , m_isPaused(false)
     , m_showPauseMenu(false)
     , m_selectedMenuOption(0)
+    , m_selectedLayer(-1)
+    , m_selectedNeuron(-1)
+    , m_pickLayoutVersion(0)
+    , m_hasHover(false)
+    , m_hover({ -1, -1, -1, 0.0f })
+    , m_showAttribution(false)
+    , m_showHeadGrid(false)
+    , m_attentionStorageMode(0)
+    , m_showAttentionMap(false)
+    , m_mapHead(0)
+    , m_mapView({ 0.0f, 0.0f, 1.0f })
+    , m_showDataFlow(false)
+    , m_showLabels(true)
+    , m_showNeighbors(false)
 {
 }
 
@@ -28,6 +56,13 @@ LLMVisualization::~LLMVisualization() {
         glfwSetInputMode(m_renderer->getWindow(), GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
     
+    // Persist recorded residual traces so the index keeps growing across
+    // sessions. A saved index that failed to load is only replaced when
+    // there is something new to put in its place
+    if (m_residualIndex && !m_modelPath.empty() && (m_residualIndexLoaded || m_residualIndex->isModified())) {
+        m_residualIndex->save(m_modelPath + ".hnsw");
+    }
+    
     // Important: destroy in the correct order
     // First clear the simulation controller (which might reference the model)
     m_simulationController.reset();
@@ -37,6 +72,9 @@ LLMVisualization::~LLMVisualization() {
     
     // Clear the model
     m_model.reset();
+    m_activationIndex.reset();
+    m_residualIndex.reset();
+    m_attentionRollout.reset();
     
     // Renderer must be destroyed last, as it holds the OpenGL context
     m_renderer.reset();
@@ -64,6 +102,8 @@ bool LLMVisualization::initialize(int width, int height) {
     // Initialize simulation controller
     m_simulationController = std::make_unique<SimulationController>(m_model.get());
     
+    m_attentionRollout = std::make_unique<AttentionRollout>();
+    
     static Camera* s_cameraInstance = nullptr;
     s_cameraInstance = m_camera.get();
 
@@ -105,9 +145,29 @@ void LLMVisualization::update(float deltaTime) {
     // Update simulation controller
     m_simulationController->update(deltaTime);
     
+    // Layers laid out again move their neurons; the hierarchy follows
+    if (m_model->getLayoutVersion() != m_pickLayoutVersion) {
+        updatePickHierarchy(false);
+    }
+    
+    // Whatever is under the crosshair, for the hover label
+    glm::vec3 crosshairRay = m_camera->getRayDirection(m_width * 0.5f, m_height * 0.5f, m_width, m_height);
+    m_hasHover = pickAlongRay(m_camera->getPosition(), crosshairRay, m_hover);
+    
     // Update model if not paused
     if (!m_isPaused) {
         m_model->update(deltaTime * m_simulationSpeed);
+        
+        // Particles follow the layers' current magnitudes
+        if (m_showDataFlow) {
+            m_model->getDataFlowPath(m_dataFlowPath);
+            m_renderer->updateDataFlow(m_dataFlowPath, deltaTime * m_simulationSpeed);
+        }
+    }
+    
+    // Only rows for tokens appended since the last frame are computed
+    if (m_showAttribution) {
+        m_attentionRollout->update(m_model.get());
     }
 }
 
@@ -115,8 +175,34 @@ void LLMVisualization::render() {
     // Begin frame
     m_renderer->beginFrame();
     
-    // Render model
+    // Render model; its draws are queued, then sorted and submitted at once
     m_model->render(m_renderer.get());
+    if (m_showDataFlow) {
+        m_renderer->renderDataFlow();
+    }
+    if (m_showLabels) {
+        m_model->renderLabels(m_renderer.get());
+    }
+    m_renderer->flushQueue();
+    renderFrameStats();
+    renderHoverLabel();
+    
+    // Overlay per-layer logit lens predictions
+    renderLogitLens();
+    
+    // Token-to-token attribution through the attention layers
+    renderAttribution();
+    
+    // Gradient saliency of the prompt tokens for the picked neuron
+    renderTokenSaliency();
+    
+    // Attention patterns of one layer's heads
+    renderHeadGrid();
+    renderAttentionMap();
+    
+    // Render top-activating contexts of the picked neuron
+    renderSelectionPanel();
+    renderNeighborPanel();
     
     // Render pause menu if active
     if (m_showPauseMenu) {
@@ -131,6 +217,24 @@ void LLMVisualization::loadModel(const std::string& modelPath) {
     if (!m_model->loadFromFile(modelPath)) {
         std::cerr << "Failed to load model from " << modelPath << std::endl;
     }
+    
+    // The new layers bake their geometry on first render, and build their
+    // textures and attention tiles afresh
+    m_renderer->clearStaticGeometry();
+    m_renderer->clearModelTextures();
+    updatePickHierarchy(true);
+    
+    // Pick up a precomputed top-activating-examples index if one sits next to the model
+    m_activationIndex = std::make_unique<ActivationIndex>();
+    if (!m_activationIndex->open(modelPath + ".topk")) {
+        m_activationIndex.reset();
+    }
+    
+    // Residual ANN index, extended with every prompt processed from here on
+    m_modelPath = modelPath;
+    m_residualIndex = std::make_unique<ResidualIndex>(m_model->getLayerCount());
+    m_residualIndexLoaded = m_residualIndex->load(modelPath + ".hnsw");
+    m_model->setResidualIndex(m_residualIndex.get());
 }
 
 void LLMVisualization::setSimulationSpeed(float speed) {
@@ -201,6 +305,125 @@ void LLMVisualization::processInput() {
         spacePressed = false;
     }
     
+    // Pick whatever is under the crosshair with the left mouse button, from
+    // the renderer's id buffer when it has one
+    static bool clickPressed = false;
+    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+        if (!clickPressed) {
+            if (m_renderer->isPickingAvailable()) {
+                m_renderer->requestPick(m_width / 2, m_height / 2);
+            } else {
+                selectComponent(m_camera->getPosition(),
+                                m_camera->getRayDirection(m_width * 0.5f, m_height * 0.5f, m_width, m_height));
+            }
+            clickPressed = true;
+        }
+    } else {
+        clickPressed = false;
+    }
+    unsigned int pickId;
+    if (m_renderer->pollPick(pickId)) {
+        selectPicked(pickId);
+    }
+    
+    // Find earlier traces with a similar residual at the selected layer
+    static bool nPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) {
+        if (!nPressed) {
+            m_showNeighbors = !m_showNeighbors;
+            if (m_showNeighbors) {
+                findSimilarResiduals();
+            }
+            nPressed = true;
+        }
+    } else {
+        nPressed = false;
+    }
+    
+    // Toggle the logit lens overlay
+    static bool lPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) {
+        if (!lPressed) {
+            m_model->setLogitLensEnabled(!m_model->isLogitLensEnabled());
+            lPressed = true;
+        }
+    } else {
+        lPressed = false;
+    }
+    
+    // Cycle the attribution overlay: off -> rollout -> flow -> off
+    static bool rPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
+        if (!rPressed) {
+            cycleAttributionMode();
+            rPressed = true;
+        }
+    } else {
+        rPressed = false;
+    }
+    
+    // Toggle the attention head grid
+    static bool hPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) {
+        if (!hPressed) {
+            m_showHeadGrid = !m_showHeadGrid;
+            hPressed = true;
+        }
+    } else {
+        hPressed = false;
+    }
+    
+    // Cycle how attention weights are stored: exact -> top-k -> mass threshold -> recomputed
+    static bool kPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) {
+        if (!kPressed) {
+            cycleAttentionStorage();
+            kPressed = true;
+        }
+    } else {
+        kPressed = false;
+    }
+    
+    // Toggle the data-flow particles
+    static bool fPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
+        if (!fPressed) {
+            m_showDataFlow = !m_showDataFlow;
+            fPressed = true;
+        }
+    } else {
+        fPressed = false;
+    }
+    
+    // Toggle the world-space token and neuron labels
+    static bool tPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
+        if (!tPressed) {
+            m_showLabels = !m_showLabels;
+            tPressed = true;
+        }
+    } else {
+        tPressed = false;
+    }
+    
+    // Open or close the attention map, fitted to the whole matrix
+    static bool mPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+        if (!mPressed) {
+            m_showAttentionMap = !m_showAttentionMap;
+            m_mapView = { 0.0f, 0.0f, std::max(1.0f, static_cast<float>(m_model->getSequenceLength())) / kAttentionMapSize };
+            mPressed = true;
+        }
+    } else {
+        mPressed = false;
+    }
+    
+    // While the map is open the arrows and +/- pan and zoom it instead
+    if (m_showAttentionMap) {
+        handleAttentionMapInput();
+        return;
+    }
+    
     // Step forward with right arrow
     if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
         m_simulationController->stepForward();
@@ -223,8 +446,94 @@ void LLMVisualization::processInput() {
 }
 
 void LLMVisualization::selectComponent(const glm::vec3& rayOrigin, const glm::vec3& rayDirection) {
-    // Implementation of ray casting to select components will go here
-    // For simplicity, placeholder only
+    PickHit hit;
+    if (!pickAlongRay(rayOrigin, rayDirection, hit)) {
+        setSelection(-1, -1);
+        return;
+    }
+    if (hit.head >= 0) {
+        m_mapHead = hit.head;
+    }
+    setSelection(hit.layer, hit.neuron);
+}
+
+bool LLMVisualization::pickAlongRay(const glm::vec3& origin, const glm::vec3& direction, PickHit& hit) const {
+    if (m_pickHierarchy.intersect(origin, direction, hit)) return true;
+    
+    // Slabs have no spheres; a handful of layer boxes is cheap to scan
+    float closest = std::numeric_limits<float>::max();
+    glm::vec3 inverseDirection = 1.0f / direction;
+    hit = { -1, -1, -1, 0.0f };
+    for (int i = 0; i < m_model->getLayerCount(); i++) {
+        float distance;
+        if (m_model->getLayer(i)->getBounds().intersectRay(origin, inverseDirection, distance) && distance < closest) {
+            closest = distance;
+            hit = { i, -1, -1, distance };
+        }
+    }
+    return hit.layer >= 0;
+}
+
+void LLMVisualization::updatePickHierarchy(bool rebuild) {
+    m_model->getPickSpheres(m_pickSpheres);
+    if (rebuild) {
+        m_pickHierarchy.build(m_pickSpheres);
+    } else {
+        m_pickHierarchy.refit(m_pickSpheres);
+    }
+    m_pickLayoutVersion = m_model->getLayoutVersion();
+}
+
+void LLMVisualization::renderHoverLabel() {
+    if (!m_hasHover || m_showPauseMenu) return;
+    
+    std::string label = "Layer " + std::to_string(m_hover.layer);
+    if (m_hover.neuron >= 0) {
+        label += " neuron " + std::to_string(m_hover.neuron);
+    } else if (m_hover.head >= 0) {
+        label += " head " + std::to_string(m_hover.head);
+    }
+    m_renderer->renderText(label, glm::vec2(m_width * 0.5f + 12.0f, m_height * 0.5f + 12.0f), 0.6f,
+                           glm::vec4(1.0f, 1.0f, 1.0f, 0.9f));
+}
+
+void LLMVisualization::selectPicked(unsigned int pickId) {
+    int layerIndex = -1;
+    int neuron = -1;
+    int head = -1;
+    if (pickId & Renderer::kPickInstanceBit) {
+        int instance = static_cast<int>(pickId & ~Renderer::kPickInstanceBit);
+        for (int i = 0; i < m_model->getLayerCount(); i++) {
+            if (m_model->getLayer(i)->findBakedNeuron(instance, neuron, head)) {
+                layerIndex = i;
+                break;
+            }
+        }
+    } else if (pickId > 0 && static_cast<int>(pickId) <= m_model->getLayerCount()) {
+        layerIndex = static_cast<int>(pickId) - 1;
+    }
+    
+    // A picked head is the one the attention map shows
+    if (head >= 0) {
+        m_mapHead = head;
+    }
+    setSelection(layerIndex, neuron);
+}
+
+void LLMVisualization::setSelection(int layerIndex, int neuron) {
+    m_selectedLayer = layerIndex;
+    m_selectedNeuron = neuron;
+    if (m_selectedLayer >= 0) {
+        m_model->highlightLayer(m_selectedLayer);
+    }
+    
+    // Which tokens and upstream neurons drive the pick at the last token
+    m_saliencyMessage.clear();
+    if (m_selectedNeuron >= 0 && m_model->canComputeSaliency(m_selectedLayer, m_selectedNeuron, m_saliencyMessage)) {
+        m_model->computeSaliency(m_selectedLayer, m_selectedNeuron);
+    } else {
+        m_model->clearSaliency();
+    }
 }
 
 void LLMVisualization::modifySelectedComponent(const std::string& property, float value) {
@@ -251,13 +560,6 @@ void LLMVisualization::runExperiment(const std::string& experimentType) {
 void LLMVisualization::renderPauseMenu() {
     if (!m_showPauseMenu) return;
     
-    // Enable blending for transparent UI
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    
-    // Disable depth test for UI elements
-    glDisable(GL_DEPTH_TEST);
-    
     // Draw dark semi-transparent background
     m_renderer->renderRect(m_width/2 - 200, m_height/2 - 200, 400, 400, 
                           glm::vec4(0.1f, 0.1f, 0.2f, 0.9f));
@@ -268,7 +570,7 @@ void LLMVisualization::renderPauseMenu() {
                           2.0f, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
     
     // Menu options
-    const std::vector<std::string> options = {
+    static const char* const options[] = {
         "Resume", "Settings", "About", "Quit"
     };
     
@@ -276,7 +578,7 @@ void LLMVisualization::renderPauseMenu() {
     float yStart = m_height/2 - 80;
     float ySpacing = 40;
     
-    for (size_t i = 0; i < options.size(); ++i) {
+    for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); ++i) {
         float y = yStart + i * ySpacing;
         
         // Highlight selected option
@@ -288,9 +590,293 @@ void LLMVisualization::renderPauseMenu() {
                               glm::vec2(m_width/2 - 50, y), 
                               1.5f, color);
     }
+}
+
+void LLMVisualization::renderSelectionPanel() {
+    if (m_selectedNeuron < 0 || !m_activationIndex) return;
+    
+    int count = 0;
+    const TopActivation* top = m_activationIndex->query(m_selectedLayer, m_selectedNeuron, count);
+    if (!top || count == 0) return;
+    
+    const int maxRows = 5;
+    int rows = std::min(count, maxRows);
+    m_renderer->renderRect(10, 10, 420, 30 + rows * 20, glm::vec4(0.1f, 0.1f, 0.2f, 0.8f));
+    m_renderer->renderText("Top contexts", glm::vec2(20, 15), 1.0f, glm::vec4(1.0f));
+    
+    for (int i = 0; i < rows; i++) {
+        std::string line = std::to_string(top[i].activation).substr(0, 5) + " " +
+                           m_activationIndex->getContextText(top[i].contextId);
+        m_renderer->renderText(line.substr(0, 32), glm::vec2(20, 35 + i * 20), 0.8f,
+                               glm::vec4(0.8f, 0.8f, 0.8f, 1.0f));
+    }
+}
+
+void LLMVisualization::renderLogitLens() {
+    if (!m_model->isLogitLensEnabled()) return;
+    
+    for (int i = 0; i < m_model->getLayerCount(); i++) {
+        const std::vector<LensPrediction>* predictions = m_model->getLogitLensPredictions(i);
+        if (!predictions || predictions->empty()) continue;
+        
+        // Label just above the layer
+        glm::vec2 screenPos;
+        if (!m_renderer->projectToScreen(m_model->getLayer(i)->getPosition() + glm::vec3(0.0f, 1.2f, 0.0f), screenPos)) {
+            continue;
+        }
+        
+        for (size_t j = 0; j < predictions->size(); j++) {
+            const LensPrediction& prediction = (*predictions)[j];
+            std::string label = m_model->getTokenString(prediction.tokenId) + " " +
+                                std::to_string(static_cast<int>(prediction.probability * 1000.0f));
+            glm::vec4 color = j == 0 ? glm::vec4(1.0f, 0.8f, 0.2f, 1.0f) : glm::vec4(0.8f, 0.8f, 0.8f, 0.8f);
+            m_renderer->renderText(label, screenPos + glm::vec2(0.0f, j * 14.0f), 0.6f, color);
+        }
+    }
+}
+
+void LLMVisualization::renderFrameStats() {
+    const RenderStats& stats = m_renderer->getRenderStats();
+    std::string line = "draws " + std::to_string(stats.drawCalls) +
+                       "  state changes " + std::to_string(stats.stateChanges) +
+                       " (" + std::to_string(stats.skippedChanges) + " skipped)" +
+                       "  ui quads " + std::to_string(stats.uiQuads) +
+                       "  heatmap rows " + std::to_string(stats.activationRowsUploaded) +
+                       "  attention bytes " + std::to_string(stats.attentionBytesUploaded) +
+                       "  tiles " + std::to_string(stats.attentionTilesComputed) +
+                       "  static bytes " + std::to_string(stats.staticBytesUploaded) +
+                       "  labels " + std::to_string(stats.labelsPlaced) + "/" + std::to_string(stats.labelCandidates);
+    
+    m_renderer->renderText(line, glm::vec2(m_width - m_renderer->measureText(line, 0.6f) - 10.0f, 10.0f), 0.6f,
+                           glm::vec4(0.7f, 0.7f, 0.7f, 1.0f));
+}
+
+void LLMVisualization::cycleAttributionMode() {
+    if (!m_showAttribution) {
+        m_showAttribution = true;
+        m_attentionRollout->setMode(AttentionRollout::Mode::ROLLOUT);
+    } else if (m_attentionRollout->getMode() == AttentionRollout::Mode::ROLLOUT) {
+        m_attentionRollout->setMode(AttentionRollout::Mode::FLOW);
+    } else {
+        m_showAttribution = false;
+    }
+}
+
+void LLMVisualization::renderAttribution() {
+    if (!m_showAttribution) return;
+    
+    int tokenCount = m_attentionRollout->getTokenCount();
+    if (tokenCount == 0) return;
+    
+    // Most recent tokens only; one cell per (query, input) pair
+    const int maxTokens = 48;
+    const float cellSize = 6.0f;
+    int first = std::max(0, tokenCount - maxTokens);
+    int shown = tokenCount - first;
+    float x0 = m_width - 20.0f - shown * cellSize;
+    float y0 = m_height - 40.0f - shown * cellSize;
+    
+    m_renderer->renderRect(x0 - 10, y0 - 30, shown * cellSize + 20, shown * cellSize + 40,
+                           glm::vec4(0.1f, 0.1f, 0.2f, 0.8f));
+    const char* title = m_attentionRollout->getMode() == AttentionRollout::Mode::ROLLOUT ? "Rollout" : "Flow";
+    m_renderer->renderText(title, glm::vec2(x0, y0 - 25), 0.8f, glm::vec4(1.0f));
+    
+    for (int query = first; query < tokenCount; query++) {
+        // Scale each row by its largest entry so later rows stay readable
+        float rowMax = 0.0f;
+        for (int input = first; input <= query; input++) {
+            rowMax = std::max(rowMax, m_attentionRollout->getAttribution(query, input));
+        }
+        if (rowMax <= 0.0f) continue;
+        
+        for (int input = first; input <= query; input++) {
+            float value = m_attentionRollout->getAttribution(query, input) / rowMax;
+            m_renderer->renderRect(x0 + (input - first) * cellSize, y0 + (query - first) * cellSize,
+                                   cellSize - 1.0f, cellSize - 1.0f,
+                                   glm::vec4(value, value * 0.6f, 0.2f, 0.9f));
+        }
+    }
+}
+
+void LLMVisualization::renderTokenSaliency() {
+    const std::vector<float>& saliency = m_model->getTokenSaliency();
+    const std::vector<int>& tokens = m_model->getTokens();
+    if (m_selectedNeuron >= 0 && !m_saliencyMessage.empty()) {
+        std::string line = "No saliency: " + m_saliencyMessage;
+        m_renderer->renderRect(10, m_height - 50.0f, m_renderer->measureText(line, 0.8f) + 20.0f, 40,
+                               glm::vec4(0.1f, 0.1f, 0.2f, 0.8f));
+        m_renderer->renderText(line, glm::vec2(20, m_height - 38.0f), 0.8f, glm::vec4(1.0f, 0.6f, 0.1f, 1.0f));
+        return;
+    }
+    if (saliency.empty() || saliency.size() != tokens.size()) return;
+    
+    // Last tokens of the prompt, bar length relative to the strongest one
+    const int maxRows = 12;
+    int first = std::max(0, static_cast<int>(tokens.size()) - maxRows);
+    int rows = static_cast<int>(tokens.size()) - first;
+    float maxSaliency = *std::max_element(saliency.begin() + first, saliency.end());
+    if (maxSaliency <= 0.0f) maxSaliency = 1.0f;
+    
+    float y0 = m_height - 40.0f - rows * 18.0f;
+    m_renderer->renderRect(10, y0 - 30, 300, rows * 18 + 40, glm::vec4(0.1f, 0.1f, 0.2f, 0.8f));
+    m_renderer->renderText("Token saliency", glm::vec2(20, y0 - 25), 0.8f, glm::vec4(1.0f));
+    
+    for (int i = 0; i < rows; i++) {
+        int token = first + i;
+        float y = y0 + i * 18.0f;
+        m_renderer->renderRect(120, y, 170 * saliency[token] / maxSaliency, 12,
+                               glm::vec4(1.0f, 0.6f, 0.1f, 0.9f));
+        m_renderer->renderText(m_model->getTokenString(tokens[token]).substr(0, 12), glm::vec2(20, y), 0.6f,
+                               glm::vec4(0.8f, 0.8f, 0.8f, 1.0f));
+    }
+}
+
+Layer* LLMVisualization::getShownAttentionLayer(int& layerIndex) {
+    Layer* layer = nullptr;
+    layerIndex = -1;
+    for (int i = 0; i < m_model->getLayerCount(); i++) {
+        Layer* candidate = m_model->getLayer(i);
+        if (!candidate || candidate->getType() != LayerType::ATTENTION) continue;
+        if (!layer || i == m_selectedLayer) {
+            layer = candidate;
+            layerIndex = i;
+        }
+    }
+    return layer;
+}
+
+void LLMVisualization::renderHeadGrid() {
+    if (!m_showHeadGrid) return;
+    
+    int layerIndex;
+    Layer* layer = getShownAttentionLayer(layerIndex);
+    if (!layer || layer->getAttentionHeadCount() == 0) return;
+    
+    const int columns = 4;
+    const float cellSize = 96.0f;
+    const float gap = 6.0f;
+    int headCount = layer->getAttentionHeadCount();
+    int rows = (headCount + columns - 1) / columns;
+    float x0 = 20.0f;
+    float y0 = m_height - 20.0f - rows * (cellSize + gap);
+    
+    m_renderer->renderRect(x0 - 10, y0 - 30, columns * (cellSize + gap) + 14, rows * (cellSize + gap) + 36,
+                           glm::vec4(0.1f, 0.1f, 0.2f, 0.8f));
+    // Long sequences may recompute rows whatever K last chose
+    const AttentionStoragePolicy& policy = layer->getAttentionHead(0)->getAttentionWeights().getPolicy();
+    static const char* const storageNames[] = { "exact", "top 32", "90% mass", "recomputed" };
+    int storageMode = policy.keepsNothing() ? 3 : m_attentionStorageMode;
+    std::string title = "Layer " + std::to_string(layerIndex) + " heads  " + storageNames[storageMode] +
+                        "  " + std::to_string(layer->getAttentionStorageBytes() / 1024) + " KB";
+    m_renderer->renderText(title, glm::vec2(x0, y0 - 25), 0.8f, glm::vec4(1.0f));
+    
+    for (int h = 0; h < headCount; h++) {
+        glm::vec2 position(x0 + (h % columns) * (cellSize + gap), y0 + (h / columns) * (cellSize + gap));
+        m_renderer->renderAttentionPanel(layer->getAttentionHead(h), position, cellSize);
+    }
+}
+
+void LLMVisualization::cycleAttentionStorage() {
+    // Exact, the 32 largest weights of each row, 90% of each row's mass, or
+    // nothing, with rows and tiles recomputed from the query/key cache
+    static const AttentionStoragePolicy policies[] = { { 0, 1.0f }, { 32, 1.0f }, { 0, 0.9f }, { 0, 0.0f } };
+    m_attentionStorageMode = (m_attentionStorageMode + 1) % 4;
+    m_model->setAttentionStoragePolicy(policies[m_attentionStorageMode]);
+    
+    // Rollout rows were built from the old weights
+    m_attentionRollout->reset();
+}
+
+void LLMVisualization::renderAttentionMap() {
+    if (!m_showAttentionMap) return;
+    
+    int layerIndex;
+    Layer* layer = getShownAttentionLayer(layerIndex);
+    if (!layer || layer->getAttentionHeadCount() == 0) return;
+    m_mapHead = std::min(m_mapHead, layer->getAttentionHeadCount() - 1);
+    
+    glm::vec2 position(m_width - 20.0f - kAttentionMapSize, 60.0f);
+    const AttentionTileCache& tiles = m_renderer->getAttentionTiles();
+    std::string title = "Layer " + std::to_string(layerIndex) + " head " + std::to_string(m_mapHead) +
+                        "  tiles " + std::to_string(tiles.getTileCount()) + "/" + std::to_string(tiles.getCapacity());
+    
+    m_renderer->renderRect(position.x - 10, position.y - 30, kAttentionMapSize + 20, kAttentionMapSize + 40,
+                           glm::vec4(0.1f, 0.1f, 0.2f, 0.8f));
+    m_renderer->renderText(title, glm::vec2(position.x, position.y - 25), 0.8f, glm::vec4(1.0f));
+    m_renderer->renderAttentionMap(layer->getAttentionHead(m_mapHead), position,
+                                   glm::vec2(kAttentionMapSize), m_mapView);
+}
+
+void LLMVisualization::handleAttentionMapInput() {
+    GLFWwindow* window = m_renderer->getWindow();
+    
+    // A fixed number of pixels per frame at any zoom
+    float step = 8.0f * m_mapView.entriesPerPixel;
+    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) m_mapView.key += step;
+    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) m_mapView.key -= step;
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) m_mapView.query += step;
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) m_mapView.query -= step;
+    if (glfwGetKey(window, GLFW_KEY_EQUAL) == GLFW_PRESS) zoomAttentionMap(1.0f / 1.05f);
+    if (glfwGetKey(window, GLFW_KEY_MINUS) == GLFW_PRESS) zoomAttentionMap(1.05f);
+    
+    // Previous and next head
+    static bool bracketPressed = false;
+    bool previous = glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS;
+    bool next = glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS;
+    if (previous || next) {
+        if (!bracketPressed) {
+            m_mapHead = previous ? std::max(0, m_mapHead - 1) : m_mapHead + 1;
+            bracketPressed = true;
+        }
+    } else {
+        bracketPressed = false;
+    }
+}
+
+void LLMVisualization::zoomAttentionMap(float factor) {
+    // From 32 pixels per entry out to twice the whole matrix
+    float maxEntriesPerPixel = 2.0f * std::max(1.0f, static_cast<float>(m_model->getSequenceLength())) / kAttentionMapSize;
+    float entriesPerPixel = std::min(std::max(m_mapView.entriesPerPixel * factor, 1.0f / 32.0f), maxEntriesPerPixel);
+    
+    float half = 0.5f * kAttentionMapSize;
+    m_mapView.query += half * (m_mapView.entriesPerPixel - entriesPerPixel);
+    m_mapView.key += half * (m_mapView.entriesPerPixel - entriesPerPixel);
+    m_mapView.entriesPerPixel = entriesPerPixel;
+}
+
+void LLMVisualization::findSimilarResiduals() {
+    if (!m_residualIndex || m_model->getLayerCount() == 0) return;
+    
+    int layerIndex = m_selectedLayer >= 0 ? m_selectedLayer : m_model->getLayerCount() - 1;
+    std::vector<float> residual = m_model->getLayer(layerIndex)->getOutput();
+    std::vector<Neighbor> neighbors = m_residualIndex->findSimilar(layerIndex, residual, 8);
+    
+    m_neighborTitle = "Nearest residuals, layer " + std::to_string(layerIndex) + " (" +
+                      std::to_string(m_residualIndex->getRecordCount(layerIndex)) + " recorded)";
+    m_neighborLines.clear();
+    for (const Neighbor& neighbor : neighbors) {
+        uint32_t traceId = static_cast<uint32_t>(neighbor.label >> 32);
+        uint32_t position = static_cast<uint32_t>(neighbor.label & 0xffffffffu);
+        m_neighborLines.push_back(std::to_string(neighbor.distance).substr(0, 6) + " @" + std::to_string(position) +
+                                  " " + m_residualIndex->getTraceText(traceId));
+    }
+}
+
+void LLMVisualization::renderNeighborPanel() {
+    if (!m_showNeighbors) return;
+    
+    // Below the top contexts panel
+    int rows = std::max(static_cast<int>(m_neighborLines.size()), 1);
+    m_renderer->renderRect(10, 150, 420, 30 + rows * 20, glm::vec4(0.1f, 0.1f, 0.2f, 0.8f));
+    m_renderer->renderText(m_neighborTitle, glm::vec2(20, 155), 0.8f, glm::vec4(1.0f));
     
-    // Restore OpenGL state
-    glEnable(GL_DEPTH_TEST);
+    if (m_neighborLines.empty()) {
+        m_renderer->renderText("nothing recorded yet", glm::vec2(20, 175), 0.8f, glm::vec4(0.8f, 0.8f, 0.8f, 1.0f));
+    }
+    for (size_t i = 0; i < m_neighborLines.size(); i++) {
+        m_renderer->renderText(m_neighborLines[i].substr(0, 40), glm::vec2(20, 175 + i * 20), 0.8f,
+                               glm::vec4(0.8f, 0.8f, 0.8f, 1.0f));
+    }
 }
 
 void LLMVisualization::handleMenuInput() {
@@ -0,0 +1,138 @@
+#include "LabelLayout.h"
+#include <algorithm>
+#include <cmath>
+
+namespace llmvis {
+
+namespace {
+
+// Occupancy grid resolution in window pixels; labels reserve whole cells
+const int kCellSize = 8;
+// Pixels between an anchor and the bottom of its label
+const float kAnchorGap = 4.0f;
+// Anchors this close to the camera plane or behind it are dropped
+const float kMinClipW = 1e-4f;
+
+uint64_t columnMask(int word, int col0, int col1) {
+    int low = word == (col0 >> 6) ? (col0 & 63) : 0;
+    int high = word == (col1 >> 6) ? (col1 & 63) : 63;
+    return (~0ull >> (63 - high)) & (~0ull << low);
+}
+
+} // namespace
+
+LabelLayout::LabelLayout() {
+    m_textStart.push_back(0);
+}
+
+void LabelLayout::add(const glm::vec3& anchor, const std::string& text, float priority, const glm::vec4& color) {
+    m_anchorX.push_back(anchor.x);
+    m_anchorY.push_back(anchor.y);
+    m_anchorZ.push_back(anchor.z);
+    m_priorities.push_back(priority);
+    m_colors.push_back(color);
+    m_text += text;
+    m_textStart.push_back(static_cast<uint32_t>(m_text.size()));
+}
+
+void LabelLayout::clear() {
+    m_anchorX.clear();
+    m_anchorY.clear();
+    m_anchorZ.clear();
+    m_priorities.clear();
+    m_colors.clear();
+    m_text.clear();
+    m_textStart.resize(1);
+}
+
+bool LabelLayout::claim(int col0, int col1, int row0, int row1, int rowWords) {
+    int word0 = col0 >> 6;
+    int word1 = col1 >> 6;
+    for (int row = row0; row <= row1; row++) {
+        const uint64_t* cells = &m_occupancy[static_cast<size_t>(row) * rowWords];
+        for (int word = word0; word <= word1; word++) {
+            if (cells[word] & columnMask(word, col0, col1)) return false;
+        }
+    }
+    for (int row = row0; row <= row1; row++) {
+        uint64_t* cells = &m_occupancy[static_cast<size_t>(row) * rowWords];
+        for (int word = word0; word <= word1; word++) {
+            cells[word] |= columnMask(word, col0, col1);
+        }
+    }
+    return true;
+}
+
+int LabelLayout::resolve(const glm::mat4& viewProjection, int width, int height, float scale, UIBatch& batch) {
+    int count = getCandidateCount();
+    if (count == 0 || width <= 0 || height <= 0) return 0;
+
+    // Project every anchor to window pixels and clip w. The loop is
+    // branch-free over separate float arrays, so it vectorizes; anchors on
+    // or behind the camera plane get meaningless pixels and are dropped after
+    m_projected.resize(count);
+    const float* anchorX = m_anchorX.data();
+    const float* anchorY = m_anchorY.data();
+    const float* anchorZ = m_anchorZ.data();
+    glm::vec3* projected = m_projected.data();
+    // Rows x, y and w of the matrix (glm is column-major)
+    float xx = viewProjection[0][0], xy = viewProjection[1][0], xz = viewProjection[2][0], xw = viewProjection[3][0];
+    float yx = viewProjection[0][1], yy = viewProjection[1][1], yz = viewProjection[2][1], yw = viewProjection[3][1];
+    float wx = viewProjection[0][3], wy = viewProjection[1][3], wz = viewProjection[2][3], ww = viewProjection[3][3];
+    float halfWidth = 0.5f * width;
+    float halfHeight = 0.5f * height;
+    for (int i = 0; i < count; i++) {
+        float x = anchorX[i];
+        float y = anchorY[i];
+        float z = anchorZ[i];
+        float cx = xx * x + xy * y + xz * z + xw;
+        float cy = yx * x + yy * y + yz * z + yw;
+        float cw = wx * x + wy * y + wz * z + ww;
+        float inverseW = 1.0f / cw;
+        projected[i].x = (cx * inverseW + 1.0f) * halfWidth;
+        projected[i].y = (1.0f - cy * inverseW) * halfHeight;
+        projected[i].z = cw;
+    }
+
+    // Candidates with their anchor on screen, highest priority first
+    m_order.clear();
+    for (int i = 0; i < count; i++) {
+        const glm::vec3& screen = projected[i];
+        if (screen.z <= kMinClipW) continue;
+        if (screen.x < 0.0f || screen.x >= width || screen.y < 0.0f || screen.y >= height) continue;
+        m_order.emplace_back(m_priorities[i], i);
+    }
+    std::sort(m_order.begin(), m_order.end(),
+              [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+
+    int columns = (width + kCellSize - 1) / kCellSize;
+    int rows = (height + kCellSize - 1) / kCellSize;
+    int rowWords = (columns + 63) / 64;
+    m_occupancy.assign(static_cast<size_t>(rows) * rowWords, 0);
+
+    // Monospace glyphs in square cells: one advance gives every size
+    float advance = batch.measureText(" ", scale);
+    int placed = 0;
+    for (const auto& entry : m_order) {
+        int i = entry.second;
+        uint32_t begin = m_textStart[i];
+        uint32_t length = m_textStart[i + 1] - begin;
+        if (length == 0) continue;
+
+        float labelWidth = length * advance;
+        float left = projected[i].x - 0.5f * labelWidth;
+        float top = projected[i].y - kAnchorGap - advance;
+        int col0 = std::max(0, static_cast<int>(std::floor(left / kCellSize)));
+        int col1 = std::min(columns - 1, static_cast<int>(std::floor((left + labelWidth) / kCellSize)));
+        int row0 = std::max(0, static_cast<int>(std::floor(top / kCellSize)));
+        int row1 = std::min(rows - 1, static_cast<int>(std::floor((top + advance) / kCellSize)));
+        if (!claim(col0, col1, row0, row1, rowWords)) continue;
+
+        m_label.assign(m_text, begin, length);
+        batch.addText(m_label, glm::vec2(left, top), scale, m_colors[i]);
+        placed++;
+    }
+    return placed;
+}
+
+} // namespace llmvis
@@ -1,17 +1,53 @@
 #include "Layer.h"
 #include "Renderer.h"
 #include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <thread>
 
 namespace llmvis {
 
-Layer::Layer(LayerType type, int size)
+namespace {
+
+const float kNeuronGridExtent = 2.0f;
+const float kOutputGridExtent = 3.0f;
+const float kMaxNeuronSpacing = 0.2f;
+
+// Neuron grids are culled and LOD'd in square blocks of this many neurons per side
+const int kNeuronBlockSize = 16;
+// Within this distance a block shows individual neurons, beyond it one aggregate
+const float kNeuronLodDistance = 6.0f;
+// Beyond this distance a whole layer is drawn as a single slab
+const float kSlabLodDistance = 40.0f;
+
+// Attention heads sit on a ring, each with its pattern just outside it
+const float kHeadRingRadius = 1.0f;
+const float kHeadRadius = 0.2f;
+const float kPatternOffset = 0.45f;
+const float kPatternSize = 0.4f;
+const float kHeadConnectionStrength = 0.5f;
+
+} // namespace
+
+Layer::Layer(LayerType type, int size, unsigned int seed)
     : m_type(type)
     , m_size(size)
     , m_isHighlighted(false)
     , m_activationProgress(0.0f)
+    , m_activationVersion(0)
+    , m_tintVersion(0)
+    , m_activationMagnitude(0.0f)
     , m_position(0.0f)
     , m_scale(1.0f)
+    , m_layoutVersion(0)
+    , m_isBaked(false)
+    , m_bakedGeneration(0)
+    , m_bakedLayout(0)
+    , m_bakedNeuronFirst(0)
+    , m_bakedConnectionFirst(0)
+    , m_bakedColorsValid(false)
+    , m_bakedColor(0.0f)
+    , m_bakedTintVersion(0)
 {
     // Initialize input and output values
     m_inputValues.resize(size, 0.0f);
@@ -26,7 +62,7 @@ Layer::Layer(LayerType type, int size)
             m_color = glm::vec3(0.8f, 0.3f, 0.3f); // Red
             // Create attention heads
             for (int i = 0; i < 8; i++) { // Assuming 8 attention heads
-                m_attentionHeads.push_back(std::make_unique<AttentionHead>(i, size / 8));
+                m_attentionHeads.push_back(std::make_unique<AttentionHead>(i, size / 8, seed));
             }
             break;
         case LayerType::FEEDFORWARD:
@@ -39,6 +75,8 @@ Layer::Layer(LayerType type, int size)
             m_color = glm::vec3(0.8f, 0.4f, 0.8f); // Purple
             break;
     }
+    
+    updateLayout();
 }
 
 Layer::~Layer() {
@@ -68,6 +106,8 @@ void Layer::render(Renderer* renderer) {
     // Scale based on layer size
     float sizeScale = std::log10(m_size) * 0.2f;
     
+    bakeGeometry(renderer);
+    
     // Render based on layer type
     switch (m_type) {
         case LayerType::EMBEDDING:
@@ -75,80 +115,149 @@ void Layer::render(Renderer* renderer) {
             renderer->renderLayer(this);
             break;
         case LayerType::ATTENTION:
-            // Render attention heads
-            for (int i = 0; i < m_attentionHeads.size(); i++) {
-                auto& head = m_attentionHeads[i];
-                
-                // Position the head in a circular arrangement
-                float angle = (static_cast<float>(i) / m_attentionHeads.size()) * 2.0f * 3.14159f;
-                float radius = 1.0f;
-                glm::vec3 headPos = m_position + glm::vec3(cos(angle) * radius, sin(angle) * radius, 0.0f);
-                
-                head->setPosition(headPos);
-                
-                // Render the head
-                float headSize = 0.2f;
-                glm::vec4 headColor = head->isHighlighted() ? glm::vec4(1.0f) : glm::vec4(color);
-                renderer->renderNeuron(headPos, headSize, headColor);
-                
-                // Render connections between heads
-                if (i > 0) {
-                    glm::vec3 prevHeadPos = m_attentionHeads[i-1]->getPosition();
-                    renderer->renderConnection(prevHeadPos, headPos, 0.5f, color);
-                }
+            // Far away the head ring collapses to a slab
+            if (m_bounds.distanceTo(renderer->getCameraPosition()) > kSlabLodDistance) {
+                renderer->renderSlab(m_position, glm::vec3(2.4f, 2.4f, 1.0f), color);
+                break;
+            }
+            
+            // Heads and the connections between them are baked; only their
+            // colours can change
+            m_bakedColors.clear();
+            for (auto& head : m_attentionHeads) {
+                m_bakedColors.push_back(head->isHighlighted() ? glm::vec4(1.0f) : color);
+            }
+            renderer->setBakedNeuronColors(m_bakedNeuronFirst, m_bakedColors);
+            renderer->renderBakedNeurons(m_bakedNeuronFirst, static_cast<int>(m_attentionHeads.size()), m_position, kHeadRadius,
+                                         color.a < 1.0f);
+            
+            if (m_attentionHeads.size() > 1) {
+                m_bakedColors.assign(m_attentionHeads.size() - 1, color);
+                renderer->setBakedConnectionColors(m_bakedConnectionFirst, m_bakedColors);
+                renderer->renderBakedConnections(m_bakedConnectionFirst, static_cast<int>(m_bakedColors.size()), m_position);
+            }
+            
+            // Each head's attention pattern just outside the ring
+            for (size_t i = 0; i < m_attentionHeads.size(); i++) {
+                renderer->renderAttentionPattern(m_attentionHeads[i].get(), m_patternCenters[i], kPatternSize);
             }
             break;
         case LayerType::FEEDFORWARD:
-            // Render as a collection of neurons
-            // For simplicity, just render a representation rather than each neuron
-            {
-                int neuronsPerRow = static_cast<int>(sqrt(std::min(100, m_size)));
-                float spacing = 0.2f;
-                
-                for (int i = 0; i < std::min(100, m_size); i++) {
-                    int row = i / neuronsPerRow;
-                    int col = i % neuronsPerRow;
-                    
-                    glm::vec3 neuronPos = m_position + glm::vec3(
-                        (col - neuronsPerRow / 2) * spacing,
-                        (row - neuronsPerRow / 2) * spacing,
-                        0.0f
-                    );
-                    
-                    renderer->renderNeuron(neuronPos, 0.05f, color);
-                }
-            }
+            // Render as a collection of neurons, queued for the instanced pass
+            renderNeuronGrid(renderer, color);
             break;
         case LayerType::NORMALIZATION:
             // Render as a thin rectangular slab
             renderer->renderLayer(this);
             break;
         case LayerType::OUTPUT:
-            // Render as a large output grid
-            renderer->renderLayer(this);
+            // Render as a large output grid, one neuron per vocabulary entry;
+            // only the first getActivationWidth() of them carry probabilities.
+            // At full vocab size these go through the renderer's impostor path
+            renderNeuronGrid(renderer, color);
             break;
     }
 }
 
+void Layer::renderNeuronGrid(Renderer* renderer, const glm::vec4& color) {
+    glm::vec3 eye = renderer->getCameraPosition();
+    
+    // Far away the whole grid is a single heatmap quad of its activations
+    if (m_bounds.distanceTo(eye) > kSlabLodDistance) {
+        renderer->renderActivationSlab(this, m_bounds.getCenter(), m_bounds.max - m_bounds.min, color.a);
+        return;
+    }
+    updateGridColors(renderer, color);
+    
+    // Cull square blocks of the grid; nearby blocks draw their baked neurons,
+    // the rest one aggregate sphere carrying the block's strongest tint
+    const Frustum& frustum = renderer->getFrustum();
+    float radius = getNeuronRadius();
+    for (const NeuronBlock& block : m_neuronBlocks) {
+        if (!frustum.intersects(block.bounds)) continue;
+        
+        if (block.bounds.distanceTo(eye) > kNeuronLodDistance) {
+            glm::vec3 extent = block.bounds.max - block.bounds.min;
+            renderer->renderNeuron(block.bounds.getCenter(), std::min(extent.x, extent.y) * 0.35f, block.aggregateColor);
+            continue;
+        }
+        renderer->renderBakedNeurons(m_bakedNeuronFirst + block.first, block.count, block.bounds.getCenter(), radius,
+                                     color.a < 1.0f);
+    }
+}
+
+void Layer::updateGridColors(Renderer* renderer, const glm::vec4& color) {
+    if (m_bakedColorsValid && color == m_bakedColor && m_tintVersion == m_bakedTintVersion) return;
+    
+    // Tint by saliency (feedforward) or by probability (output), relative to the strongest
+    const std::vector<float>& tintValues = m_type == LayerType::OUTPUT ? m_outputValues : m_saliency;
+    glm::vec3 tintColor = m_type == LayerType::OUTPUT ? glm::vec3(1.0f) : glm::vec3(1.0f, 0.6f, 0.1f);
+    int neuronsPerRow = getNeuronsPerRow();
+    int neuronCount = getVisibleNeuronCount();
+    int tintCount = std::min(neuronCount, static_cast<int>(tintValues.size()));
+    float maxTint = 0.0f;
+    for (int i = 0; i < tintCount; i++) {
+        maxTint = std::max(maxTint, tintValues[i]);
+    }
+    auto tinted = [&](float value) {
+        if (maxTint <= 0.0f) return color;
+        return glm::vec4(glm::mix(glm::vec3(color), tintColor, value / maxTint), color.a);
+    };
+    
+    // Baked order: block by block, row-major within each
+    m_bakedColors.resize(neuronCount);
+    for (NeuronBlock& block : m_neuronBlocks) {
+        int slot = block.first;
+        float blockTint = 0.0f;
+        for (int row = block.rowBegin; row < block.rowEnd; row++) {
+            for (int col = block.colBegin; col < block.colEnd; col++) {
+                int index = row * neuronsPerRow + col;
+                if (index >= neuronCount) break;
+                float value = index < tintCount ? tintValues[index] : 0.0f;
+                blockTint = std::max(blockTint, value);
+                m_bakedColors[slot++] = tinted(value);
+            }
+        }
+        block.aggregateColor = tinted(blockTint);
+    }
+    renderer->setBakedNeuronColors(m_bakedNeuronFirst, m_bakedColors);
+    
+    m_bakedColorsValid = true;
+    m_bakedColor = color;
+    m_bakedTintVersion = m_tintVersion;
+}
+
 void Layer::processInput(const std::vector<float>& input) {
     // Store input values
     m_inputValues = input;
+    m_activationVersion++;
+    m_tintVersion++;
     
     // Process based on layer type
     switch (m_type) {
         case LayerType::EMBEDDING: {
             // Simple pass-through for embedding (in real implementation, would convert token to embedding)
             m_outputValues = input;
+            m_recordedActivations.insert(m_recordedActivations.end(), input.begin(), input.end());
             break;
         }
         
         case LayerType::ATTENTION: {
-            // In a real implementation, this would compute attention
+            // Each head reads its own slice of the residual; head outputs are
+            // concatenated and added back onto the residual stream
+            m_outputValues = input;
             m_outputValues.resize(m_size, 0.0f);
             
-            // For visualization, just use dummy values for now
-            for (size_t i = 0; i < m_outputValues.size(); ++i) {
-                m_outputValues[i] = sin(i * 0.1f) * 0.5f + 0.5f;
+            std::vector<float> padded = m_outputValues;
+            for (size_t h = 0; h < m_attentionHeads.size(); ++h) {
+                size_t headSize = m_size / m_attentionHeads.size();
+                const float* slice = &padded[h * headSize];
+                m_attentionHeads[h]->appendToken(slice, slice, slice);
+                
+                const std::vector<float>& headOutput = m_attentionHeads[h]->getOutput();
+                for (size_t i = 0; i < headSize; ++i) {
+                    m_outputValues[h * headSize + i] += headOutput[i];
+                }
             }
             break;
         }
@@ -159,6 +268,7 @@ void Layer::processInput(const std::vector<float>& input) {
             for (size_t i = 0; i < input.size(); ++i) {
                 m_outputValues[i] = std::max(0.0f, input[i]);
             }
+            m_recordedActivations.insert(m_recordedActivations.end(), input.begin(), input.end());
             break;
         }
         
@@ -196,15 +306,118 @@ void Layer::processInput(const std::vector<float>& input) {
             for (size_t i = 0; i < m_outputValues.size(); ++i) {
                 m_outputValues[i] /= sum;
             }
+            m_recordedActivations.insert(m_recordedActivations.end(), m_outputValues.begin(), m_outputValues.end());
             break;
         }
     }
+    
+    m_activationPyramid.update(m_outputValues);
+    
+    float sumSquares = 0.0f;
+    for (float value : m_outputValues) {
+        sumSquares += value * value;
+    }
+    m_activationMagnitude = m_outputValues.empty() ? 0.0f : std::sqrt(sumSquares / m_outputValues.size());
 }
 
 std::vector<float> Layer::getOutput() const {
     return m_outputValues;
 }
 
+void Layer::resetSequence() {
+    for (auto& head : m_attentionHeads) {
+        head->resetSequence();
+    }
+    m_recordedActivations.clear();
+}
+
+int Layer::backward(const float* outputGradient, float* inputGradient, int rowBegin, int rowEnd) {
+    const size_t width = m_outputValues.size();
+    
+    switch (m_type) {
+        case LayerType::EMBEDDING: {
+            std::copy(outputGradient + rowBegin * width, outputGradient + rowEnd * width, inputGradient + rowBegin * width);
+            return rowBegin;
+        }
+        
+        case LayerType::ATTENTION: {
+            // Residual path, then each head adds the gradient through its slice.
+            // Causal attention spreads the gradient to every earlier row
+            std::fill(inputGradient, inputGradient + rowBegin * width, 0.0f);
+            std::copy(outputGradient + rowBegin * width, outputGradient + rowEnd * width, inputGradient + rowBegin * width);
+            
+            // Heads write disjoint slices, so they run in parallel
+            int headCount = static_cast<int>(m_attentionHeads.size());
+            int headSize = static_cast<int>(width) / std::max(1, headCount);
+            int threadCount = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), headCount));
+            
+            auto worker = [&](int threadIndex) {
+                for (int h = threadIndex; h < headCount; h += threadCount) {
+                    m_attentionHeads[h]->backward(outputGradient + h * headSize, inputGradient + h * headSize,
+                                                  static_cast<int>(width), rowBegin, rowEnd);
+                }
+            };
+            
+            std::vector<std::thread> threads;
+            for (int i = 1; i < threadCount; ++i) {
+                threads.emplace_back(worker, i);
+            }
+            worker(0);
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            return 0;
+        }
+        
+        case LayerType::FEEDFORWARD: {
+            // ReLU passes gradient only where its recorded input was positive
+            for (size_t i = rowBegin * width; i < rowEnd * width; ++i) {
+                inputGradient[i] = m_recordedActivations[i] > 0.0f ? outputGradient[i] : 0.0f;
+            }
+            return rowBegin;
+        }
+        
+        case LayerType::NORMALIZATION: {
+            // Mean-centering is linear: subtract the mean gradient
+            for (int row = rowBegin; row < rowEnd; ++row) {
+                const float* gradient = outputGradient + row * width;
+                float sum = 0.0f;
+                for (size_t i = 0; i < width; ++i) {
+                    sum += gradient[i];
+                }
+                float mean = sum / width;
+                for (size_t i = 0; i < width; ++i) {
+                    inputGradient[row * width + i] = gradient[i] - mean;
+                }
+            }
+            return rowBegin;
+        }
+        
+        case LayerType::OUTPUT: {
+            // Softmax Jacobian from the recorded probabilities
+            for (int row = rowBegin; row < rowEnd; ++row) {
+                const float* gradient = outputGradient + row * width;
+                const float* probabilities = &m_recordedActivations[row * width];
+                float dot = 0.0f;
+                for (size_t i = 0; i < width; ++i) {
+                    dot += probabilities[i] * gradient[i];
+                }
+                for (size_t i = 0; i < width; ++i) {
+                    inputGradient[row * width + i] = probabilities[i] * (gradient[i] - dot);
+                }
+            }
+            return rowBegin;
+        }
+    }
+    
+    return rowBegin;
+}
+
+void Layer::setSaliency(const std::vector<float>& saliency) {
+    m_saliency = saliency;
+    m_tintVersion++;
+}
+
 void Layer::setActivation(float progress) {
     m_activationProgress = progress;
 }
@@ -239,8 +452,195 @@ int Layer::getAttentionHeadCount() const {
     return 0;
 }
 
+void Layer::setAttentionStoragePolicy(const AttentionStoragePolicy& policy) {
+    for (auto& head : m_attentionHeads) {
+        head->setAttentionStoragePolicy(policy);
+    }
+}
+
+size_t Layer::getAttentionStorageBytes() const {
+    size_t bytes = 0;
+    for (const auto& head : m_attentionHeads) {
+        bytes += head->getAttentionWeights().getMemoryBytes();
+    }
+    return bytes;
+}
+
 void Layer::setPosition(const glm::vec3& position) {
     m_position = position;
+    updateLayout();
+}
+
+void Layer::updateLayout() {
+    m_layoutVersion++;
+    
+    // Heads evenly spaced on the ring
+    m_patternCenters.clear();
+    for (size_t i = 0; i < m_attentionHeads.size(); i++) {
+        float angle = (static_cast<float>(i) / m_attentionHeads.size()) * 2.0f * 3.14159f;
+        glm::vec3 outward = glm::vec3(std::cos(angle), std::sin(angle), 0.0f);
+        glm::vec3 headPos = m_position + outward * kHeadRingRadius;
+        m_attentionHeads[i]->setPosition(headPos);
+        m_patternCenters.push_back(headPos + outward * kPatternOffset);
+    }
+    
+    // Square blocks of the neuron grid, for culling and LOD
+    m_neuronBlocks.clear();
+    int neuronCount = getVisibleNeuronCount();
+    int neuronsPerRow = getNeuronsPerRow();
+    int rowCount = (neuronCount + neuronsPerRow - 1) / neuronsPerRow;
+    float radius = getNeuronRadius();
+    int first = 0;
+    for (int blockRow = 0; blockRow < rowCount; blockRow += kNeuronBlockSize) {
+        for (int blockCol = 0; blockCol < neuronsPerRow; blockCol += kNeuronBlockSize) {
+            if (blockRow * neuronsPerRow + blockCol >= neuronCount) break;
+            NeuronBlock block;
+            block.rowBegin = blockRow;
+            block.rowEnd = std::min(blockRow + kNeuronBlockSize, rowCount);
+            block.colBegin = blockCol;
+            block.colEnd = std::min(blockCol + kNeuronBlockSize, neuronsPerRow);
+            block.bounds.min = getGridPosition(block.rowBegin, block.colBegin) - glm::vec3(radius);
+            block.bounds.max = getGridPosition(block.rowEnd - 1, block.colEnd - 1) + glm::vec3(radius);
+            block.first = first;
+            block.count = 0;
+            for (int row = block.rowBegin; row < block.rowEnd; row++) {
+                int rowNeurons = std::min(block.colEnd, neuronCount - row * neuronsPerRow) - block.colBegin;
+                block.count += std::max(rowNeurons, 0);
+            }
+            block.aggregateColor = glm::vec4(m_color, 1.0f);
+            first += block.count;
+            m_neuronBlocks.push_back(block);
+        }
+    }
+    
+    // Bounds of everything render() draws
+    switch (m_type) {
+        case LayerType::FEEDFORWARD:
+        case LayerType::OUTPUT:
+            m_bounds.min = getGridPosition(0, 0) - glm::vec3(radius);
+            m_bounds.max = getGridPosition(std::max(rowCount, 1) - 1, neuronsPerRow - 1) + glm::vec3(radius);
+            break;
+        case LayerType::ATTENTION:
+            // Head ring plus the head spheres
+            m_bounds.min = m_position - glm::vec3(1.2f, 1.2f, 0.2f);
+            m_bounds.max = m_position + glm::vec3(1.2f, 1.2f, 0.2f);
+            break;
+        case LayerType::EMBEDDING:
+            m_bounds.min = m_position - glm::vec3(1.0f, 1.0f, 0.05f);
+            m_bounds.max = m_position + glm::vec3(1.0f, 1.0f, 0.05f);
+            break;
+        case LayerType::NORMALIZATION:
+            m_bounds.min = m_position - glm::vec3(0.75f, 0.1f, 0.05f);
+            m_bounds.max = m_position + glm::vec3(0.75f, 0.1f, 0.05f);
+            break;
+    }
+}
+
+void Layer::bakeGeometry(Renderer* renderer) {
+    if (m_isBaked && m_bakedGeneration == renderer->getStaticGeneration() && m_bakedLayout == m_layoutVersion) return;
+    m_isBaked = true;
+    m_bakedGeneration = renderer->getStaticGeneration();
+    m_bakedLayout = m_layoutVersion;
+    m_bakedColorsValid = false;
+    
+    // Grid neurons in block order, so each block is one contiguous range
+    std::vector<glm::vec4> positionSizes;
+    int neuronsPerRow = getNeuronsPerRow();
+    int neuronCount = getVisibleNeuronCount();
+    float radius = getNeuronRadius();
+    for (const NeuronBlock& block : m_neuronBlocks) {
+        for (int row = block.rowBegin; row < block.rowEnd; row++) {
+            for (int col = block.colBegin; col < block.colEnd; col++) {
+                if (row * neuronsPerRow + col >= neuronCount) break;
+                positionSizes.push_back(glm::vec4(getGridPosition(row, col), radius));
+            }
+        }
+    }
+    
+    // Attention heads, chained in ring order
+    std::vector<glm::vec3> endpoints;
+    for (size_t i = 0; i < m_attentionHeads.size(); i++) {
+        positionSizes.push_back(glm::vec4(m_attentionHeads[i]->getPosition(), kHeadRadius));
+        if (i > 0) {
+            endpoints.push_back(m_attentionHeads[i - 1]->getPosition());
+            endpoints.push_back(m_attentionHeads[i]->getPosition());
+        }
+    }
+    
+    m_bakedNeuronFirst = renderer->bakeNeurons(positionSizes);
+    m_bakedConnectionFirst = renderer->bakeConnections(endpoints, kHeadConnectionStrength);
+}
+
+bool Layer::findBakedNeuron(int instance, int& neuron, int& head) const {
+    int local = instance - m_bakedNeuronFirst;
+    int gridCount = getVisibleNeuronCount();
+    if (!m_isBaked || local < 0 || local >= gridCount + static_cast<int>(m_attentionHeads.size())) return false;
+    
+    neuron = -1;
+    head = -1;
+    if (local >= gridCount) {
+        head = local - gridCount;
+        return true;
+    }
+    
+    // Baked block by block, row-major inside each block
+    for (const NeuronBlock& block : m_neuronBlocks) {
+        if (local < block.first || local >= block.first + block.count) continue;
+        int width = block.colEnd - block.colBegin;
+        int offset = local - block.first;
+        neuron = (block.rowBegin + offset / width) * getNeuronsPerRow() + block.colBegin + offset % width;
+        return true;
+    }
+    return false;
+}
+
+void Layer::appendPickSpheres(int layerIndex, std::vector<PickSphere>& spheres) const {
+    int neuronCount = getVisibleNeuronCount();
+    float radius = getNeuronRadius();
+    for (int i = 0; i < neuronCount; i++) {
+        spheres.push_back({ getNeuronPosition(i), radius, layerIndex, i, -1 });
+    }
+    for (size_t i = 0; i < m_attentionHeads.size(); i++) {
+        spheres.push_back({ m_attentionHeads[i]->getPosition(), kHeadRadius, layerIndex, -1, static_cast<int>(i) });
+    }
+}
+
+int Layer::getVisibleNeuronCount() const {
+    if (m_type == LayerType::FEEDFORWARD || m_type == LayerType::OUTPUT) {
+        return m_size;
+    }
+    return 0;
+}
+
+int Layer::getNeuronsPerRow() const {
+    return std::max(1, static_cast<int>(sqrt(getVisibleNeuronCount())));
+}
+
+float Layer::getNeuronSpacing() const {
+    // Large grids are packed tighter so every layer keeps roughly the same footprint
+    float extent = m_type == LayerType::OUTPUT ? kOutputGridExtent : kNeuronGridExtent;
+    return std::min(kMaxNeuronSpacing, extent / getNeuronsPerRow());
+}
+
+glm::vec3 Layer::getGridPosition(int row, int col) const {
+    // Square grid centred on the layer position
+    int neuronsPerRow = getNeuronsPerRow();
+    float spacing = getNeuronSpacing();
+    
+    return m_position + glm::vec3(
+        (col - neuronsPerRow / 2) * spacing,
+        (row - neuronsPerRow / 2) * spacing,
+        0.0f
+    );
+}
+
+glm::vec3 Layer::getNeuronPosition(int index) const {
+    int neuronsPerRow = getNeuronsPerRow();
+    return getGridPosition(index / neuronsPerRow, index % neuronsPerRow);
+}
+
+float Layer::getNeuronRadius() const {
+    return getNeuronSpacing() * 0.25f;
 }
 
-} // namespace llmvis 
\ No newline at end of file
+} // namespace llmvis
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "LogitLens.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <thread>
+
+namespace llmvis {
+
+namespace {
+
+// Vocab columns per tile: rows x kVocabBlock accumulators stay in L1
+const int kVocabBlock = 256;
+
+struct RowState {
+    float maxLogit;
+    float expSum;   // sum of exp(logit - maxLogit) over everything seen so far
+};
+
+bool predictionGreater(const LensPrediction& a, const LensPrediction& b) {
+    return a.logit > b.logit;
+}
+
+} // namespace
+
+LogitLens::LogitLens(int modelDimensions, int vocabSize)
+    : m_modelDimensions(modelDimensions)
+    , m_vocabSize(vocabSize)
+{
+}
+
+LogitLens::~LogitLens() {
+}
+
+void LogitLens::initializeRandom(unsigned int seed) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> dis(0.0f, 1.0f / std::sqrt(static_cast<float>(m_modelDimensions)));
+
+    m_unembedding.resize(static_cast<size_t>(m_modelDimensions) * m_vocabSize);
+    for (float& weight : m_unembedding) {
+        weight = dis(gen);
+    }
+}
+
+void LogitLens::compute(const std::vector<const std::vector<float>*>& residuals, int topK) {
+    const int rows = static_cast<int>(residuals.size());
+    const int d = m_modelDimensions;
+    topK = std::max(1, std::min(topK, m_vocabSize));
+
+    m_predictions.assign(rows, std::vector<LensPrediction>());
+    if (rows == 0 || !isInitialized()) return;
+
+    // Final norm: same mean-centering as the model's normalization layers
+    std::vector<float> normalized(static_cast<size_t>(rows) * d, 0.0f);
+    for (int r = 0; r < rows; ++r) {
+        const std::vector<float>& residual = *residuals[r];
+        int count = std::min(d, static_cast<int>(residual.size()));
+        float mean = 0.0f;
+        for (int i = 0; i < count; ++i) mean += residual[i];
+        mean /= std::max(1, count);
+        for (int i = 0; i < count; ++i) {
+            normalized[static_cast<size_t>(r) * d + i] = residual[i] - mean;
+        }
+    }
+
+    int blockCount = (m_vocabSize + kVocabBlock - 1) / kVocabBlock;
+    int threadCount = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), blockCount));
+
+    // Per-thread partial results, merged once every block is done
+    std::vector<std::vector<LensPrediction>> threadHeaps(threadCount);
+    std::vector<std::vector<RowState>> threadStates(threadCount);
+
+    auto worker = [&](int threadIndex) {
+        std::vector<LensPrediction>& heaps = threadHeaps[threadIndex];   // topK per row
+        std::vector<int> heapSizes(rows, 0);
+        heaps.resize(static_cast<size_t>(rows) * topK);
+
+        std::vector<RowState>& states = threadStates[threadIndex];
+        states.assign(rows, { -std::numeric_limits<float>::infinity(), 0.0f });
+
+        std::vector<float> tile(static_cast<size_t>(rows) * kVocabBlock);
+
+        for (int block = threadIndex; block < blockCount; block += threadCount) {
+            int v0 = block * kVocabBlock;
+            int width = std::min(kVocabBlock, m_vocabSize - v0);
+
+            // tile[r][0..width) = sum_k normalized[r][k] * W[k][v0..v0+width)
+            // The inner loop runs over independent vocab columns so it vectorizes,
+            // and each W row segment is reused by every layer while it is hot
+            std::fill(tile.begin(), tile.end(), 0.0f);
+            for (int k = 0; k < d; ++k) {
+                const float* weights = &m_unembedding[static_cast<size_t>(k) * m_vocabSize + v0];
+                for (int r = 0; r < rows; ++r) {
+                    float x = normalized[static_cast<size_t>(r) * d + k];
+                    float* out = &tile[static_cast<size_t>(r) * kVocabBlock];
+                    for (int j = 0; j < width; ++j) {
+                        out[j] += x * weights[j];
+                    }
+                }
+            }
+
+            // Fused epilogue: online softmax normalizer and bounded top-k per row
+            for (int r = 0; r < rows; ++r) {
+                const float* logits = &tile[static_cast<size_t>(r) * kVocabBlock];
+                RowState& state = states[r];
+
+                float blockMax = *std::max_element(logits, logits + width);
+                if (blockMax > state.maxLogit) {
+                    state.expSum *= std::exp(state.maxLogit - blockMax);
+                    state.maxLogit = blockMax;
+                }
+
+                LensPrediction* heap = &heaps[static_cast<size_t>(r) * topK];
+                int& size = heapSizes[r];
+                for (int j = 0; j < width; ++j) {
+                    state.expSum += std::exp(logits[j] - state.maxLogit);
+
+                    if (size < topK) {
+                        heap[size++] = { v0 + j, logits[j], 0.0f };
+                        std::push_heap(heap, heap + size, predictionGreater);
+                    } else if (logits[j] > heap[0].logit) {
+                        std::pop_heap(heap, heap + size, predictionGreater);
+                        heap[size - 1] = { v0 + j, logits[j], 0.0f };
+                        std::push_heap(heap, heap + size, predictionGreater);
+                    }
+                }
+            }
+        }
+
+        // Mark unfilled slots (only possible when a thread saw fewer than topK columns)
+        for (int r = 0; r < rows; ++r) {
+            for (int i = heapSizes[r]; i < topK; ++i) {
+                heaps[static_cast<size_t>(r) * topK + i] = { -1, 0.0f, 0.0f };
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Merge the per-thread normalizers and heaps
+    for (int r = 0; r < rows; ++r) {
+        float maxLogit = -std::numeric_limits<float>::infinity();
+        for (int t = 0; t < threadCount; ++t) {
+            maxLogit = std::max(maxLogit, threadStates[t][r].maxLogit);
+        }
+        float expSum = 0.0f;
+        for (int t = 0; t < threadCount; ++t) {
+            const RowState& state = threadStates[t][r];
+            if (state.expSum > 0.0f) {
+                expSum += state.expSum * std::exp(state.maxLogit - maxLogit);
+            }
+        }
+
+        std::vector<LensPrediction>& predictions = m_predictions[r];
+        for (int t = 0; t < threadCount; ++t) {
+            const LensPrediction* heap = &threadHeaps[t][static_cast<size_t>(r) * topK];
+            for (int i = 0; i < topK; ++i) {
+                if (heap[i].tokenId >= 0) predictions.push_back(heap[i]);
+            }
+        }
+
+        size_t keep = std::min(predictions.size(), static_cast<size_t>(topK));
+        std::partial_sort(predictions.begin(), predictions.begin() + keep, predictions.end(), predictionGreater);
+        predictions.resize(keep);
+
+        for (LensPrediction& prediction : predictions) {
+            prediction.probability = std::exp(prediction.logit - maxLogit) / expSum;
+        }
+    }
+}
+
+} // namespace llmvis
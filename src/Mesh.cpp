@@ -34,9 +34,24 @@ bool Mesh::loadFromFile(const std::string& filepath) {
 }
 
 void Mesh::createSphere(float radius, int subdivisions) {
+    createSphereLods(radius, std::vector<int>(1, subdivisions));
+}
+
+void Mesh::createSphereLods(float radius, const std::vector<int>& subdivisions) {
     // Clear existing data
-    m_vertices.clear();
-    m_indices.clear();
+    clearGeometry();
+    
+    for (int levelSubdivisions : subdivisions) {
+        appendSphere(radius, levelSubdivisions);
+    }
+    
+    // Set up mesh
+    setupMesh();
+}
+
+void Mesh::appendSphere(float radius, int subdivisions) {
+    size_t firstIndex = m_indices.size();
+    unsigned int baseVertex = static_cast<unsigned int>(m_vertices.size());
     
     // Create a sphere using UV-sphere method (stacks and slices)
     const float PI = 3.14159265359f;
@@ -95,14 +110,28 @@ void Mesh::createSphere(float radius, int subdivisions) {
         }
     }
     
-    // Set up mesh
-    setupMesh();
+    finishLevel(firstIndex, baseVertex);
 }
 
 void Mesh::createCylinder(float radius, float height, int subdivisions) {
+    createCylinderLods(radius, height, std::vector<int>(1, subdivisions));
+}
+
+void Mesh::createCylinderLods(float radius, float height, const std::vector<int>& subdivisions) {
     // Clear existing data
-    m_vertices.clear();
-    m_indices.clear();
+    clearGeometry();
+    
+    for (int levelSubdivisions : subdivisions) {
+        appendCylinder(radius, height, levelSubdivisions);
+    }
+    
+    // Set up mesh
+    setupMesh();
+}
+
+void Mesh::appendCylinder(float radius, float height, int subdivisions) {
+    size_t firstIndex = m_indices.size();
+    unsigned int baseVertex = static_cast<unsigned int>(m_vertices.size());
     
     const float PI = 3.14159265359f;
     height *= 0.5f; // Half-height for easier centering
@@ -171,14 +200,12 @@ void Mesh::createCylinder(float radius, float height, int subdivisions) {
         m_indices.push_back(topRight);
     }
     
-    // Set up mesh
-    setupMesh();
+    finishLevel(firstIndex, baseVertex);
 }
 
 void Mesh::createQuad(float width, float height) {
     // Clear existing data
-    m_vertices.clear();
-    m_indices.clear();
+    clearGeometry();
     
     // Scale for easier centering
     width *= 0.5f;
@@ -221,17 +248,80 @@ void Mesh::createQuad(float width, float height) {
     m_indices.push_back(2);
     m_indices.push_back(3);
     
+    finishLevel(0, 0);
+    
     // Set up mesh
     setupMesh();
 }
 
 void Mesh::render() {
-    // Bind VAO and draw elements
+    if (m_lods.empty()) return;
+    
+    // Bind VAO and draw the most detailed level
     glBindVertexArray(m_vao);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT, 0);
+    draw(getLodCount() - 1);
     glBindVertexArray(0);
 }
 
+void Mesh::renderInstanced(int instanceCount, int level, int firstInstance) {
+    glBindVertexArray(m_vao);
+    drawInstanced(instanceCount, level, firstInstance);
+    glBindVertexArray(0);
+}
+
+void Mesh::draw(int level) const {
+    if (level < 0 || level >= static_cast<int>(m_lods.size())) return;
+    
+    const LodLevel& lod = m_lods[level];
+    glDrawElements(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT, (void*)(lod.firstIndex * sizeof(unsigned int)));
+}
+
+void Mesh::drawInstanced(int instanceCount, int level, int firstInstance) const {
+    if (instanceCount <= 0 || level < 0 || level >= static_cast<int>(m_lods.size())) return;
+    
+    // GL 3.3 has no base-instance draws, so shift the instance streams instead
+    for (const InstanceAttribute& attribute : m_instanceAttributes) {
+        size_t offset = attribute.offset + static_cast<size_t>(firstInstance) * attribute.stride;
+        glBindBuffer(GL_ARRAY_BUFFER, attribute.buffer);
+        glVertexAttribPointer(attribute.location, attribute.components, GL_FLOAT, GL_FALSE, attribute.stride, (void*)offset);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    const LodLevel& lod = m_lods[level];
+    glDrawElementsInstanced(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT,
+                            (void*)(lod.firstIndex * sizeof(unsigned int)), instanceCount);
+}
+
+void Mesh::addInstanceAttribute(GLuint buffer, GLuint location, GLint components, GLsizei stride, size_t offset) {
+    m_instanceAttributes.push_back({ buffer, location, components, stride, offset });
+    
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, components, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    glVertexAttribDivisor(location, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Mesh::clearGeometry() {
+    m_vertices.clear();
+    m_indices.clear();
+    m_lods.clear();
+}
+
+void Mesh::finishLevel(size_t firstIndex, unsigned int baseVertex) {
+    // Generators index from zero; rebase onto this level's vertices
+    for (size_t i = firstIndex; i < m_indices.size(); ++i) {
+        m_indices[i] += baseVertex;
+    }
+    
+    LodLevel lod;
+    lod.firstIndex = firstIndex;
+    lod.indexCount = static_cast<GLsizei>(m_indices.size() - firstIndex);
+    m_lods.push_back(lod);
+}
+
 void Mesh::setupMesh() {
     // Clean up any previous VAO/VBO/EBO
     if (m_vao != 0) {
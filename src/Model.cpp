@@ -1,20 +1,35 @@
 #include "Model.h"
 #include "Layer.h"
 #include "Renderer.h"
+#include "ResidualIndex.h"
 #include <iostream>
 #include <fstream>
 #include <algorithm>
 #include <cmath>
 #include <string>
+#include <random>
 
 namespace llmvis {
 
+namespace {
+
+// Strongest neurons per layer offered as label candidates
+const int kMaxLabelsPerLayer = 1024;
+
+} // namespace
+
 Model::Model()
-    : m_simulationSpeed(1.0f)
+    : m_currentInput("")
+    , m_embeddingData()
+    , m_sequenceId(0)
+    , m_traceId(0)
+    , m_simulationSpeed(1.0f)
     , m_currentStep(0)
     , m_animateDataFlow(false)
-    , m_currentInput("")
-    , m_embeddingData()
+    , m_residualIndex(nullptr)
+    , m_attentionStoragePolicy({ 0, 1.0f })
+    , m_recomputingAttention(false)
+    , m_logitLensEnabled(false)
 {
 }
 
@@ -29,15 +44,20 @@ bool Model::loadFromFile(const std::string& modelPath) {
     
     // Clear existing layers
     m_layers.clear();
+    m_logitLens.reset();
+    m_logitLensRows.clear();
+    m_layerLabels.clear();
     
     // Create a simple transformer model architecture
     // 1. Embedding layer
     m_layers.push_back(std::make_unique<Layer>(LayerType::EMBEDDING, 512));
+    m_tokenToIdMap.clear();
+    m_tokens.clear();
     
     // 2. Several transformer blocks
     for (int i = 0; i < 4; i++) {
         // Attention layer
-        m_layers.push_back(std::make_unique<Layer>(LayerType::ATTENTION, 512));
+        m_layers.push_back(std::make_unique<Layer>(LayerType::ATTENTION, 512, i + 1));
         
         // Normalization layer
         m_layers.push_back(std::make_unique<Layer>(LayerType::NORMALIZATION, 512));
@@ -52,6 +72,10 @@ bool Model::loadFromFile(const std::string& modelPath) {
     // 3. Output layer
     m_layers.push_back(std::make_unique<Layer>(LayerType::OUTPUT, 50000)); // Vocabulary size
     
+    // The new heads store attention as last set
+    m_recomputingAttention = false;
+    applyAttentionStoragePolicy(m_attentionStoragePolicy);
+    
     // Position layers in 3D space
     float layerSpacing = 1.5f;
     float yOffset = 0.0f;
@@ -121,9 +145,103 @@ void Model::update(float deltaTime) {
 }
 
 void Model::render(Renderer* renderer) {
-    // Render all layers
-    for (auto& layer : m_layers) {
-        layer->render(renderer);
+    // Render the layers inside the view frustum; each layer culls its own blocks.
+    // Layer draws pick as the layer's index plus one
+    const Frustum& frustum = renderer->getFrustum();
+    for (size_t i = 0; i < m_layers.size(); i++) {
+        if (frustum.intersects(m_layers[i]->getBounds())) {
+            renderer->setPickName(static_cast<unsigned int>(i + 1));
+            m_layers[i]->render(renderer);
+        }
+    }
+    renderer->setPickName(0);
+}
+
+void Model::renderLabels(Renderer* renderer) {
+    if (m_layerLabels.size() != m_layers.size()) {
+        m_layerLabels.assign(m_layers.size(), LayerLabels());
+    }
+    
+    const Frustum& frustum = renderer->getFrustum();
+    for (size_t i = 0; i < m_layers.size(); i++) {
+        Layer* layer = m_layers[i].get();
+        if (!frustum.intersects(layer->getBounds())) continue;
+        LayerLabels& labels = m_layerLabels[i];
+        if (!labels.valid || labels.version != layer->getActivationVersion()) {
+            updateLayerLabels(static_cast<int>(i));
+        }
+        
+        bool heads = layer->getType() == LayerType::ATTENTION;
+        glm::vec4 color = heads ? glm::vec4(0.6f, 0.8f, 1.0f, 0.9f)
+                        : layer->getType() == LayerType::OUTPUT ? glm::vec4(1.0f, 1.0f, 1.0f, 0.9f)
+                                                               : glm::vec4(1.0f, 0.6f, 0.1f, 0.9f);
+        for (size_t j = 0; j < labels.items.size(); j++) {
+            glm::vec3 anchor = heads ? layer->getAttentionHead(labels.items[j])->getPosition()
+                                     : layer->getNeuronPosition(labels.items[j]);
+            renderer->renderLabel(anchor, labels.texts[j], labels.priorities[j], color);
+        }
+    }
+}
+
+void Model::updateLayerLabels(int layerIndex) {
+    Layer* layer = m_layers[layerIndex].get();
+    LayerLabels& labels = m_layerLabels[layerIndex];
+    labels.valid = true;
+    labels.version = layer->getActivationVersion();
+    labels.items.clear();
+    labels.texts.clear();
+    labels.priorities.clear();
+    
+    // A head is labelled with the token its latest query attends to most
+    if (layer->getType() == LayerType::ATTENTION) {
+        for (int h = 0; h < layer->getAttentionHeadCount(); h++) {
+            const AttentionHead* head = layer->getAttentionHead(h);
+            int rows = head->getAttentionWeights().getRowCount();
+            if (rows == 0 || rows > static_cast<int>(m_tokens.size())) continue;
+            m_labelRow.resize(rows);
+            head->readAttentionRow(rows - 1, m_labelRow.data());
+            int key = static_cast<int>(std::max_element(m_labelRow.begin(), m_labelRow.end()) - m_labelRow.begin());
+            labels.items.push_back(h);
+            labels.texts.push_back(getTokenString(m_tokens[key]));
+            labels.priorities.push_back(m_labelRow[key]);
+        }
+        return;
+    }
+    if (layer->getType() != LayerType::FEEDFORWARD && layer->getType() != LayerType::OUTPUT) return;
+    
+    // The strongest active neurons, strongest first
+    const std::vector<float>& values = layer->getActivations();
+    int count = std::min(layer->getVisibleNeuronCount(), static_cast<int>(values.size()));
+    m_labelOrder.clear();
+    for (int i = 0; i < count; i++) {
+        if (values[i] > 0.0f) m_labelOrder.push_back(i);
+    }
+    auto stronger = [&values](int a, int b) { return values[a] > values[b]; };
+    if (static_cast<int>(m_labelOrder.size()) > kMaxLabelsPerLayer) {
+        std::nth_element(m_labelOrder.begin(), m_labelOrder.begin() + kMaxLabelsPerLayer, m_labelOrder.end(), stronger);
+        m_labelOrder.resize(kMaxLabelsPerLayer);
+    }
+    std::sort(m_labelOrder.begin(), m_labelOrder.end(), stronger);
+    if (m_labelOrder.empty()) return;
+    
+    // Output neurons are vocabulary entries; look every name up in one pass
+    std::vector<const std::string*> names;
+    if (layer->getType() == LayerType::OUTPUT) {
+        names.assign(count, nullptr);
+        for (const auto& entry : m_tokenToIdMap) {
+            if (entry.second >= 0 && entry.second < count) names[entry.second] = &entry.first;
+        }
+    }
+    
+    float strongest = values[m_labelOrder.front()];
+    for (int neuron : m_labelOrder) {
+        labels.items.push_back(neuron);
+        if (names.empty()) {
+            labels.texts.push_back("n" + std::to_string(neuron));
+        } else {
+            labels.texts.push_back(names[neuron] ? *names[neuron] : "#" + std::to_string(neuron));
+        }
+        labels.priorities.push_back(values[neuron] / strongest);
     }
 }
 
@@ -131,36 +249,242 @@ void Model::processInput(const std::string& input) {
     m_currentInput = input;
     m_currentStep = 0;
     
-    // Tokenize input (simplified version)
-    std::vector<int> tokens;
+    // Start a fresh sequence
+    m_tokens.clear();
+    m_sequenceId++;
+    clearSaliency();
+    for (auto& layer : m_layers) {
+        layer->resetSequence();
+    }
+    if (m_recomputingAttention) {
+        m_recomputingAttention = false;
+        applyAttentionStoragePolicy(m_attentionStoragePolicy);
+    }
+    m_traceId = m_residualIndex ? m_residualIndex->beginTrace(input) : 0;
+    
+    // Tokenize input (simplified version) and run each token through the model
     size_t start = 0, end;
     
     while ((end = input.find(' ', start)) != std::string::npos) {
         std::string token = input.substr(start, end - start);
-        if (m_tokenToIdMap.find(token) != m_tokenToIdMap.end()) {
-            tokens.push_back(m_tokenToIdMap[token]);
+        if (!token.empty()) {
+            forwardToken(token);
         }
         start = end + 1;
     }
     
     // Don't forget the last word
     std::string lastToken = input.substr(start);
-    if (m_tokenToIdMap.find(lastToken) != m_tokenToIdMap.end()) {
-        tokens.push_back(m_tokenToIdMap[lastToken]);
+    if (!lastToken.empty()) {
+        forwardToken(lastToken);
+    }
+    
+    if (m_logitLensEnabled) {
+        updateLogitLens();
+    }
+}
+
+void Model::appendToken(const std::string& token) {
+    forwardToken(token);
+    
+    if (m_logitLensEnabled) {
+        updateLogitLens();
+    }
+}
+
+void Model::forwardToken(const std::string& token) {
+    if (m_layers.empty()) return;
+    
+    int tokenId = getTokenId(token);
+    int position = static_cast<int>(m_tokens.size());
+    m_tokens.push_back(tokenId);
+    
+    // Past this length exact rows cost n^2/2 floats per head; the heads stop
+    // storing them and readers and tiles recompute them from the caches
+    if (position == kRecomputeAttentionLength && m_attentionStoragePolicy.isExact()) {
+        m_recomputingAttention = true;
+        applyAttentionStoragePolicy({ 0, 0.0f });
+    }
+    
+    // Convert token to embedding (very simplified): a pseudo-random vector per
+    // token id plus a sinusoidal position signal. Seeding keeps activations
+    // reproducible (and thread-safe, unlike rand())
+    int embeddingSize = m_layers[0]->getSize();
+    m_embeddingData.assign(embeddingSize, 0.0f);
+    
+    std::mt19937 gen(static_cast<unsigned int>(tokenId));
+    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    for (int i = 0; i < embeddingSize; i++) {
+        float frequency = std::pow(10000.0f, -static_cast<float>(i & ~1) / embeddingSize);
+        float positional = (i % 2 == 0) ? std::sin(position * frequency) : std::cos(position * frequency);
+        m_embeddingData[i] = dis(gen) + 0.1f * positional;
+    }
+    
+    // Propagate the embedding through every layer
+    m_layers[0]->processInput(m_embeddingData);
+    for (size_t i = 1; i < m_layers.size(); i++) {
+        m_layers[i]->processInput(m_layers[i - 1]->getOutput());
+    }
+    
+    // Record this position for nearest-neighbour queries
+    if (m_residualIndex) {
+        for (size_t i = 0; i < m_layers.size(); i++) {
+            m_residualIndex->record(static_cast<int>(i), m_layers[i]->getOutput(),
+                                    ResidualIndex::makeLabel(m_traceId, position));
+        }
+    }
+}
+
+int Model::getTokenId(const std::string& token) {
+    auto it = m_tokenToIdMap.find(token);
+    if (it != m_tokenToIdMap.end()) {
+        return it->second;
+    }
+    
+    // Out-of-table words get a stable id somewhere in the vocabulary
+    int vocabSize = m_layers.empty() ? 1 << 16 : m_layers.back()->getSize();
+    int tokenId = static_cast<int>(std::hash<std::string>()(token) % std::max(1, vocabSize));
+    m_tokenToIdMap[token] = tokenId;
+    return tokenId;
+}
+
+void Model::setLogitLensEnabled(bool enabled) {
+    m_logitLensEnabled = enabled;
+    if (enabled && !m_currentInput.empty()) {
+        updateLogitLens();
+    }
+}
+
+void Model::updateLogitLens() {
+    if (m_layers.empty() || m_layers.back()->getType() != LayerType::OUTPUT) return;
+    
+    // Unembedding maps the embedding width onto the output layer's vocabulary
+    int modelDimensions = m_layers.front()->getSize();
+    int vocabSize = m_layers.back()->getSize();
+    if (!m_logitLens) {
+        m_logitLens = std::make_unique<LogitLens>(modelDimensions, vocabSize);
+        m_logitLens->initializeRandom(1234);
+    }
+    
+    // One row per layer whose output is a residual-width vector
+    std::vector<std::vector<float>> outputs(m_layers.size());
+    std::vector<const std::vector<float>*> residuals;
+    m_logitLensRows.assign(m_layers.size(), -1);
+    
+    for (size_t i = 0; i < m_layers.size(); i++) {
+        if (m_layers[i]->getType() == LayerType::OUTPUT) continue;
+        outputs[i] = m_layers[i]->getOutput();
+        if (static_cast<int>(outputs[i].size()) != modelDimensions) continue;
+        
+        m_logitLensRows[i] = static_cast<int>(residuals.size());
+        residuals.push_back(&outputs[i]);
+    }
+    
+    m_logitLens->compute(residuals, 3);
+}
+
+const std::vector<LensPrediction>* Model::getLogitLensPredictions(int layerIndex) const {
+    if (!m_logitLensEnabled || !m_logitLens || layerIndex < 0 ||
+        layerIndex >= static_cast<int>(m_logitLensRows.size()) || m_logitLensRows[layerIndex] < 0 ||
+        m_logitLensRows[layerIndex] >= m_logitLens->getRowCount()) {
+        return nullptr;
+    }
+    return &m_logitLens->getPredictions(m_logitLensRows[layerIndex]);
+}
+
+std::string Model::getTokenString(int tokenId) const {
+    for (const auto& entry : m_tokenToIdMap) {
+        if (entry.second == tokenId) {
+            return entry.first;
+        }
+    }
+    return "#" + std::to_string(tokenId);
+}
+
+bool Model::canComputeSaliency(int layerIndex, int neuronIndex, std::string& reason) const {
+    reason.clear();
+    if (getSequenceLength() == 0) {
+        reason = "no prompt has been run yet";
+        return false;
+    }
+    if (layerIndex < 0 || layerIndex >= static_cast<int>(m_layers.size())) {
+        reason = "no layer " + std::to_string(layerIndex);
+        return false;
+    }
+    
+    // The reverse pass runs on one residual width throughout
+    int width = m_layers[0]->getActivationWidth();
+    for (int i = 0; i <= layerIndex; i++) {
+        if (m_layers[i]->getActivationWidth() != width) {
+            reason = "layer " + std::to_string(i) + " is not on the residual width";
+            return false;
+        }
+    }
+    if (neuronIndex < 0 || neuronIndex >= width) {
+        reason = "neuron " + std::to_string(neuronIndex) + " is outside the " + std::to_string(width) + " activations";
+        return false;
+    }
+    return true;
+}
+
+bool Model::computeSaliency(int layerIndex, int neuronIndex) {
+    clearSaliency();
+    
+    std::string reason;
+    if (!canComputeSaliency(layerIndex, neuronIndex, reason)) {
+        return false;
     }
     
-    // Convert tokens to embedding (very simplified)
-    m_embeddingData.clear();
-    m_embeddingData.resize(512, 0.0f); // Embedding size
+    int tokenCount = getSequenceLength();
+    int width = m_layers[0]->getActivationWidth();
+    size_t size = static_cast<size_t>(tokenCount) * width;
+    if (m_gradient.size() < size) {
+        m_gradient.resize(size);
+        m_inputGradient.resize(size);
+    }
+    
+    // Seed: d(target)/d(output) is one-hot at the last token
+    int rowEnd = tokenCount;
+    int rowBegin = tokenCount - 1;
+    std::fill(m_gradient.begin() + static_cast<size_t>(rowBegin) * width, m_gradient.begin() + size, 0.0f);
+    m_gradient[static_cast<size_t>(rowBegin) * width + neuronIndex] = 1.0f;
     
-    // For visualization purposes, just set some random values
-    for (int i = 0; i < m_embeddingData.size(); i++) {
-        m_embeddingData[i] = static_cast<float>(rand()) / RAND_MAX * 2.0f - 1.0f;
+    std::vector<float> neuronSaliency(width);
+    for (int i = layerIndex; i >= 0; i--) {
+        std::fill(neuronSaliency.begin(), neuronSaliency.end(), 0.0f);
+        for (int row = rowBegin; row < rowEnd; row++) {
+            const float* gradient = &m_gradient[static_cast<size_t>(row) * width];
+            for (int j = 0; j < width; j++) {
+                neuronSaliency[j] += std::abs(gradient[j]);
+            }
+        }
+        m_layers[i]->setSaliency(neuronSaliency);
+        
+        rowBegin = m_layers[i]->backward(m_gradient.data(), m_inputGradient.data(), rowBegin, rowEnd);
+        m_gradient.swap(m_inputGradient);
     }
     
-    // Process the embedding through the first layer
-    if (!m_layers.empty()) {
-        m_layers[0]->processInput(m_embeddingData);
+    // Gradient x input at the embedding
+    const std::vector<float>& embeddings = m_layers[0]->getRecordedActivations();
+    if (embeddings.size() < size) return false;
+    
+    m_tokenSaliency.assign(tokenCount, 0.0f);
+    for (int row = rowBegin; row < rowEnd; row++) {
+        float dot = 0.0f;
+        for (int j = 0; j < width; j++) {
+            size_t index = static_cast<size_t>(row) * width + j;
+            dot += m_gradient[index] * embeddings[index];
+        }
+        m_tokenSaliency[row] = std::abs(dot);
+    }
+    
+    return true;
+}
+
+void Model::clearSaliency() {
+    m_tokenSaliency.clear();
+    for (auto& layer : m_layers) {
+        layer->setSaliency(std::vector<float>());
     }
 }
 
@@ -193,6 +517,20 @@ void Model::highlightAttentionHead(int layerIndex, int headIndex) {
     }
 }
 
+void Model::setAttentionStoragePolicy(const AttentionStoragePolicy& policy) {
+    m_attentionStoragePolicy = policy;
+    m_recomputingAttention = false;
+    applyAttentionStoragePolicy(policy);
+}
+
+void Model::applyAttentionStoragePolicy(const AttentionStoragePolicy& policy) {
+    for (auto& layer : m_layers) {
+        if (layer->getType() == LayerType::ATTENTION) {
+            layer->setAttentionStoragePolicy(policy);
+        }
+    }
+}
+
 Layer* Model::getLayer(int index) {
     if (index >= 0 && index < m_layers.size()) {
         return m_layers[index].get();
@@ -204,4 +542,33 @@ int Model::getLayerCount() const {
     return m_layers.size();
 }
 
+void Model::getDataFlowPath(std::vector<DataFlowNode>& path) const {
+    path.clear();
+    for (const auto& layer : m_layers) {
+        // Particles keep inside the layer's drawn extent
+        BoundingBox bounds = layer->getBounds();
+        DataFlowNode node;
+        node.position = (bounds.min + bounds.max) * 0.5f;
+        node.extent = glm::vec2(bounds.max - bounds.min) * 0.4f;
+        node.magnitude = layer->getActivationMagnitude();
+        path.push_back(node);
+    }
+}
+
+void Model::getPickSpheres(std::vector<PickSphere>& spheres) const {
+    spheres.clear();
+    for (size_t i = 0; i < m_layers.size(); i++) {
+        m_layers[i]->appendPickSpheres(static_cast<int>(i), spheres);
+    }
+}
+
+unsigned int Model::getLayoutVersion() const {
+    // Layer versions only grow, so their sum changes with any of them
+    unsigned int version = 0;
+    for (const auto& layer : m_layers) {
+        version += layer->getLayoutVersion();
+    }
+    return version;
+}
+
 } // namespace llmvis 
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "ParticleSystem.h"
+#include <cstddef>
+#include <vector>
+
+namespace llmvis {
+
+ParticleSystem::ParticleSystem(int capacity)
+    : m_capacity(capacity)
+    , m_current(0)
+{
+    m_buffers[0] = m_buffers[1] = 0;
+    m_updateVAOs[0] = m_updateVAOs[1] = 0;
+}
+
+ParticleSystem::~ParticleSystem() {
+    m_meshes[0].reset();
+    m_meshes[1].reset();
+    if (m_updateVAOs[0]) {
+        glDeleteVertexArrays(2, m_updateVAOs);
+    }
+    if (m_buffers[0]) {
+        glDeleteBuffers(2, m_buffers);
+    }
+}
+
+bool ParticleSystem::initialize() {
+    if (m_capacity <= 0) return false;
+
+    // Zeros are dead particles, which the first steps respawn
+    std::vector<Particle> particles(m_capacity, Particle{ glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) });
+    glGenBuffers(2, m_buffers);
+    glGenVertexArrays(2, m_updateVAOs);
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, particles.size() * sizeof(Particle), particles.data(), GL_DYNAMIC_COPY);
+
+        // Update pass input: one point per particle
+        glBindVertexArray(m_updateVAOs[i]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, positionLife));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, velocityTarget));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, laneIntensity));
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // Draw pass input: the same buffer as per-instance data
+        m_meshes[i] = std::make_unique<Mesh>();
+        m_meshes[i]->createQuad(2.0f, 2.0f);
+        m_meshes[i]->addInstanceAttribute(m_buffers[i], 3, 4, sizeof(Particle), offsetof(Particle, positionLife));
+        m_meshes[i]->addInstanceAttribute(m_buffers[i], 4, 4, sizeof(Particle), offsetof(Particle, velocityTarget));
+        m_meshes[i]->addInstanceAttribute(m_buffers[i], 5, 4, sizeof(Particle), offsetof(Particle, laneIntensity));
+    }
+    m_current = 0;
+    return true;
+}
+
+void ParticleSystem::step(GLuint updateProgram) {
+    if (!m_buffers[0] || !updateProgram) return;
+    int next = 1 - m_current;
+
+    glUseProgram(updateProgram);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(m_updateVAOs[m_current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_buffers[next]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, m_capacity);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    m_current = next;
+}
+
+} // namespace llmvis
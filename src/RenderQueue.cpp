@@ -0,0 +1,225 @@
+#include "RenderQueue.h"
+#include "Shader.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <cstring>
+
+namespace llmvis {
+
+namespace {
+
+const int kDepthBits = 24;
+
+// Non-negative IEEE floats order like their bit patterns, so the top bits
+// of the float are a monotonic depth key with no range to configure
+uint64_t quantizeDepth(float depth) {
+    depth = std::max(depth, 0.0f);
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits >> (32 - kDepthBits);
+}
+
+} // namespace
+
+GLStateTracker::GLStateTracker()
+    : m_program(0)
+    , m_vao(0)
+    , m_depthMask(-1)
+    , m_depthTest(-1)
+    , m_programValid(false)
+    , m_vaoValid(false)
+    , m_texturesValid(false)
+    , m_stateChanges(0)
+    , m_skippedChanges(0)
+{
+    std::fill(m_textures, m_textures + kTrackedTextureUnits, 0);
+}
+
+void GLStateTracker::invalidate() {
+    m_programValid = false;
+    m_vaoValid = false;
+    m_texturesValid = false;
+    m_depthMask = -1;
+    m_depthTest = -1;
+}
+
+void GLStateTracker::useProgram(GLuint program) {
+    if (m_programValid && program == m_program) {
+        m_skippedChanges++;
+        return;
+    }
+    glUseProgram(program);
+    m_program = program;
+    m_programValid = true;
+    m_stateChanges++;
+}
+
+void GLStateTracker::bindVertexArray(GLuint vao) {
+    if (m_vaoValid && vao == m_vao) {
+        m_skippedChanges++;
+        return;
+    }
+    glBindVertexArray(vao);
+    m_vao = vao;
+    m_vaoValid = true;
+    m_stateChanges++;
+}
+
+void GLStateTracker::setDepthMask(bool enabled) {
+    int mask = enabled ? 1 : 0;
+    if (mask == m_depthMask) {
+        m_skippedChanges++;
+        return;
+    }
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    m_depthMask = mask;
+    m_stateChanges++;
+}
+
+void GLStateTracker::setDepthTest(bool enabled) {
+    int test = enabled ? 1 : 0;
+    if (test == m_depthTest) {
+        m_skippedChanges++;
+        return;
+    }
+    if (enabled) {
+        glEnable(GL_DEPTH_TEST);
+    } else {
+        glDisable(GL_DEPTH_TEST);
+    }
+    m_depthTest = test;
+    m_stateChanges++;
+}
+
+void GLStateTracker::bindTexture(GLuint unit, GLuint texture) {
+    if (unit >= static_cast<GLuint>(kTrackedTextureUnits)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glActiveTexture(GL_TEXTURE0);
+        m_stateChanges++;
+        return;
+    }
+    if (!m_texturesValid) {
+        // Unknown bindings: treat every unit as needing a bind
+        std::fill(m_textures, m_textures + kTrackedTextureUnits, ~0u);
+        m_texturesValid = true;
+    }
+    if (m_textures[unit] == texture) {
+        m_skippedChanges++;
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glActiveTexture(GL_TEXTURE0);
+    m_textures[unit] = texture;
+    m_stateChanges++;
+}
+
+void GLStateTracker::resetCounters() {
+    m_stateChanges = 0;
+    m_skippedChanges = 0;
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, unsigned int programId, unsigned int meshId, int level, float viewDepth) {
+    uint64_t state = (static_cast<uint64_t>(programId & 0xFF) << 14) |
+                     (static_cast<uint64_t>(meshId & 0xFF) << 6) |
+                     static_cast<uint64_t>(level & 0x3F);
+    uint64_t depth = quantizeDepth(viewDepth);
+    uint64_t key = static_cast<uint64_t>(pass) << 62;
+
+    key |= state << kDepthBits;
+    if (pass == RenderPass::OPAQUE_PASS) {
+        key |= depth;
+    }
+    return key;
+}
+
+int RenderQueue::submit(GLStateTracker& state, RenderPass pass) {
+    // Sort small (key, index) pairs of the pass rather than the items themselves
+    m_order.clear();
+    for (size_t i = 0; i < m_items.size(); i++) {
+        if ((m_items[i].key >> 62) == static_cast<uint64_t>(pass)) {
+            m_order.push_back(std::make_pair(m_items[i].key, static_cast<uint32_t>(i)));
+        }
+    }
+    std::sort(m_order.begin(), m_order.end());
+
+    // Other paths bind programs and VAOs directly, so start from a clean cache
+    state.invalidate();
+
+    int drawCalls = 0;
+    for (const auto& entry : m_order) {
+        const DrawItem& item = m_items[entry.second];
+        const DrawProgram& program = *item.program;
+        bool transparent = pass == RenderPass::TRANSPARENT_PASS;
+
+        state.useProgram(program.shader->getProgram());
+        state.bindVertexArray(item.mesh->getVertexArray());
+        state.setDepthMask(!transparent);
+
+        if (program.valueRangeLocation >= 0) {
+            state.bindTexture(0, item.texture);
+            program.shader->setUniform(program.valueRangeLocation, item.valueRange);
+            if (program.texRectLocation >= 0) program.shader->setUniform(program.texRectLocation, item.texRect);
+        }
+
+        if (item.instanceCount > 0) {
+            item.mesh->drawInstanced(item.instanceCount, item.level, item.firstInstance);
+        } else {
+            if (program.modelLocation >= 0) program.shader->setUniform(program.modelLocation, item.model);
+            if (program.colorLocation >= 0) program.shader->setUniform(program.colorLocation, item.color);
+            if (program.progressLocation >= 0) program.shader->setUniform(program.progressLocation, item.progress);
+            item.mesh->draw(item.level);
+        }
+        drawCalls++;
+    }
+
+    // Leave the defaults the immediate-mode paths expect
+    state.setDepthMask(true);
+    state.bindVertexArray(0);
+    return drawCalls;
+}
+
+int RenderQueue::submitPicking(GLStateTracker& state) {
+    // Transparent items are opaque here: the nearest pickable surface wins
+    m_order.clear();
+    for (size_t i = 0; i < m_items.size(); i++) {
+        if (m_items[i].pickId != 0 && m_items[i].program->pickLocation >= 0) {
+            m_order.push_back(std::make_pair(m_items[i].key & ~(3ull << 62), static_cast<uint32_t>(i)));
+        }
+    }
+    std::sort(m_order.begin(), m_order.end());
+
+    state.invalidate();
+    state.setDepthMask(true);
+
+    int drawCalls = 0;
+    for (const auto& entry : m_order) {
+        const DrawItem& item = m_items[entry.second];
+        const DrawProgram& program = *item.program;
+
+        state.useProgram(program.shader->getProgram());
+        state.bindVertexArray(item.mesh->getVertexArray());
+        program.shader->setUniform(program.pickLocation, item.pickId);
+        if (program.valueRangeLocation >= 0) {
+            state.bindTexture(0, item.texture);
+            program.shader->setUniform(program.valueRangeLocation, item.valueRange);
+            if (program.texRectLocation >= 0) program.shader->setUniform(program.texRectLocation, item.texRect);
+        }
+
+        if (item.instanceCount > 0) {
+            item.mesh->drawInstanced(item.instanceCount, item.level, item.firstInstance);
+        } else {
+            if (program.modelLocation >= 0) program.shader->setUniform(program.modelLocation, item.model);
+            if (program.colorLocation >= 0) program.shader->setUniform(program.colorLocation, item.color);
+            if (program.progressLocation >= 0) program.shader->setUniform(program.progressLocation, item.progress);
+            item.mesh->draw(item.level);
+        }
+        drawCalls++;
+    }
+
+    state.bindVertexArray(0);
+    return drawCalls;
+}
+
+} // namespace llmvis
@@ -1,29 +1,239 @@
 #include "Renderer.h"
 #include "Layer.h"
+#include "AttentionHead.h"
 #include <iostream>
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <cmath>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 namespace llmvis {
 
+namespace {
+
+// std140 layout of the Camera uniform block shared by the 3D shaders
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 viewPos;
+    glm::vec4 viewport;   // width, height
+};
+const GLuint kCameraBlockBinding = 0;
+
+// Activation heatmaps
+const float kSlabAlpha = 0.85f;
+const GLuint kColormapTextureUnit = 1;
+const int kColormapSize = 256;
+
+// Text scale of world-space labels
+const float kLabelScale = 0.5f;
+// Upper bound on the texels of one heatmap upload, however large the slab
+const float kMaxHeatmapTexels = 256.0f * 256.0f;
+
+// Attention map tiles kept (16 KB of texture each) and computed per frame
+const int kAttentionTileCapacity = 256;
+const int kMaxTilesComputedPerFrame = 4;
+
+// Heatmaps lay activations out as a row-major grid of square tiles, each in
+// Z-order. An aligned 2^k x 2^k block is then a run of 4^k values, so pyramid
+// level 2k is the same grid at 1/2^k resolution
+struct HeatmapLayout {
+    int tileBits;   // tiles are 2^tileBits texels square at full resolution
+    int tilesX;
+    int tilesY;
+};
+
+HeatmapLayout makeHeatmapLayout(int valueCount, float aspect) {
+    // Largest tiles that still leave enough of them to follow the slab's shape
+    float minTiles = 4.0f * std::max(aspect, 1.0f / aspect);
+    HeatmapLayout layout;
+    layout.tileBits = 0;
+    while (static_cast<float>(1 << (2 * (layout.tileBits + 1))) * minTiles <= valueCount) {
+        layout.tileBits++;
+    }
+    
+    int tileValues = 1 << (2 * layout.tileBits);
+    int tiles = (valueCount + tileValues - 1) / tileValues;
+    layout.tilesX = std::max(1, std::min(tiles, static_cast<int>(std::ceil(std::sqrt(tiles * aspect)))));
+    layout.tilesY = (tiles + layout.tilesX - 1) / layout.tilesX;
+    return layout;
+}
+
+// Index into pyramid level 2 * reduction of the texel at (x, y)
+int getHeatmapIndex(const HeatmapLayout& layout, int reduction, int x, int y) {
+    int tileBits = layout.tileBits - reduction;
+    int tile = (y >> tileBits) * layout.tilesX + (x >> tileBits);
+    int local = 0;
+    for (int bit = 0; bit < tileBits; bit++) {
+        local |= ((x >> bit) & 1) << (2 * bit);
+        local |= ((y >> bit) & 1) << (2 * bit + 1);
+    }
+    return (tile << (2 * tileBits)) | local;
+}
+
+// Data-flow particles. Path nodes past kMaxFlowNodes are dropped; it must
+// match the array sizes in the particle update shader
+const int kParticleCapacity = 32768;
+const int kMaxFlowNodes = 32;
+const float kParticleSpeed = 3.0f;
+// Mean time a dead particle waits before it respawns
+const float kParticleRespawnSeconds = 0.5f;
+const float kParticleSize = 0.03f;
+
+// Fragment outputs of the 3D programs. In the transparent pass they write
+// weighted premultiplied colour for the order-independent composite, using
+// McGuire and Bavoil's weight: nearer and more opaque fragments count more.
+// The pick id goes to a third output that only the pick target receives
+const std::string kFragmentOutputs = R"(
+            uniform bool weightedBlend;
+            uniform uint pickId;
+            
+            layout (location = 0) out vec4 FragColor;
+            layout (location = 1) out vec4 FragWeight;
+            layout (location = 2) out uint PickId;
+            
+            void writeColor(vec4 shaded, int instance) {
+                PickId = pickId == 0u ? 0u : pickId + uint(instance);
+                if (weightedBlend) {
+                    float weight = clamp(pow(min(1.0, shaded.a * 10.0) + 0.01, 3.0) * 1e8 *
+                                         pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+                    FragColor = vec4(shaded.rgb * shaded.a * weight, shaded.a);
+                    FragWeight = vec4(shaded.a * weight);
+                } else {
+                    FragColor = shaded;
+                    FragWeight = vec4(0.0);
+                }
+            }
+            
+            void writeColor(vec4 shaded) {
+                writeColor(shaded, 0);
+            }
+)";
+// Draw buffer of the pick target, matching the PickId output location
+const GLint kPickDrawBuffer = 2;
+
+// Units of the transparency targets while they are composited
+const GLuint kAccumulationTextureUnit = 2;
+const GLuint kWeightTextureUnit = 3;
+
+// Sort ids of the meshes, for render queue keys
+enum MeshSortId {
+    SPHERE_MESH_ID,
+    CYLINDER_MESH_ID,
+    QUAD_MESH_ID,
+    IMPOSTOR_MESH_ID,
+    PARTICLE_MESH_ID
+};
+
+const float kConnectionRadius = 0.05f;
+// Distant connections never get thinner than this on screen
+const float kMinConnectionPixels = 1.5f;
+
+// Neurons smaller than this on screen are drawn as impostors, as is every
+// neuron once a frame queues more than kMaxMeshNeurons
+const float kImpostorPixelRadius = 2.0f;
+const size_t kMaxMeshNeurons = 4096;
+
+// LOD chains (coarsest first) and the projected radius in pixels at which
+// each next level takes over
+const int kSphereLodSubdivisions[] = { 4, 8, 16, 32 };
+const float kSphereLodPixels[] = { 6.0f, 16.0f, 48.0f };
+const int kCylinderLodSubdivisions[] = { 4, 8, 16 };
+const float kCylinderLodPixels[] = { 3.0f, 12.0f };
+
+int selectLod(float pixelRadius, const float* thresholds, int levelCount) {
+    int level = 0;
+    while (level < levelCount - 1 && pixelRadius >= thresholds[level]) {
+        level++;
+    }
+    return level;
+}
+
+// Counting sort by level so every level is one contiguous instance range;
+// levelStart[l]..levelStart[l + 1] is level l's range in sorted
+template <typename Instance>
+void bucketByLevel(const std::vector<Instance>& instances, const std::vector<int>& levels, int levelCount,
+                   std::vector<Instance>& sorted, std::vector<int>& levelStart) {
+    levelStart.assign(levelCount + 1, 0);
+    for (int level : levels) {
+        levelStart[level + 1]++;
+    }
+    for (int level = 0; level < levelCount; level++) {
+        levelStart[level + 1] += levelStart[level];
+    }
+    
+    std::vector<int> cursor(levelStart.begin(), levelStart.end() - 1);
+    sorted.resize(instances.size());
+    for (size_t i = 0; i < instances.size(); i++) {
+        sorted[cursor[levels[i]]++] = instances[i];
+    }
+}
+
+} // namespace
+
 Renderer::Renderer()
     : m_window(nullptr)
     , m_width(0)
     , m_height(0)
+    , m_camera(nullptr)
+    , m_pixelsPerUnit(0.0f)
+    , m_cameraUBO(0)
+    , m_renderStats()
+    , m_neuronProgram()
+    , m_neuronInstancedProgram()
+    , m_neuronImpostorProgram()
+    , m_connectionProgram()
+    , m_dataFlowProgram()
+    , m_heatmapProgram()
+    , m_attentionTiles(kAttentionTileCapacity)
+    , m_colormapTexture(0)
+    , m_particleSeed(0)
+    , m_uiProjectionLocation(-1)
+    , m_uiHeatmapProjectionLocation(-1)
+    , m_neuronInstanceVBO(0)
+    , m_neuronInstanceCapacity(0)
+    , m_impostorInstanceVBO(0)
+    , m_impostorInstanceCapacity(0)
+    , m_connectionInstanceVBO(0)
+    , m_connectionInstanceCapacity(0)
+    , m_sceneFramebuffer(0)
+    , m_sceneColor(0)
+    , m_sceneDepth(0)
+    , m_oitFramebuffer(0)
+    , m_oitAccumTexture(0)
+    , m_oitWeightTexture(0)
+    , m_compositeVAO(0)
+    , m_pickFramebuffer(0)
+    , m_pickTexture(0)
+    , m_pickDepth(0)
+    , m_pickPixelBuffer(0)
+    , m_pickName(0)
+    , m_pickRequested(false)
+    , m_pickInFlight(false)
+    , m_pickFence(0)
+    , m_pickReady(false)
+    , m_pickResult(0)
+    , m_staticGeneration(0)
+    , m_uiBatch(m_glyphAtlas)
     , m_fontTexture(0)
+    , m_uiVBO(0)
+    , m_uiVAO(0)
+    , m_uiVertexCapacity(0)
 {
 }
 
 Renderer::~Renderer() {
     // Delete text rendering resources
-    if (m_textVAO) {
-        glDeleteVertexArrays(1, &m_textVAO);
-        m_textVAO = 0;
+    if (m_uiVAO) {
+        glDeleteVertexArrays(1, &m_uiVAO);
+        m_uiVAO = 0;
     }
     
-    if (m_textVBO) {
-        glDeleteBuffers(1, &m_textVBO);
-        m_textVBO = 0;
+    if (m_uiVBO) {
+        glDeleteBuffers(1, &m_uiVBO);
+        m_uiVBO = 0;
     }
     
     if (m_fontTexture) {
@@ -31,16 +241,60 @@ Renderer::~Renderer() {
         m_fontTexture = 0;
     }
     
+    if (m_colormapTexture) {
+        glDeleteTextures(1, &m_colormapTexture);
+        m_colormapTexture = 0;
+    }
+    m_activationSlabs.clear();
+    m_attentionTextures.clear();
+    m_attentionTiles.clear();
+    m_particles.reset();
+    m_staticNeurons.reset();
+    m_staticConnections.reset();
+    
+    if (m_cameraUBO) {
+        glDeleteBuffers(1, &m_cameraUBO);
+        m_cameraUBO = 0;
+    }
+    
+    if (m_neuronInstanceVBO) {
+        glDeleteBuffers(1, &m_neuronInstanceVBO);
+        m_neuronInstanceVBO = 0;
+    }
+    
+    if (m_impostorInstanceVBO) {
+        glDeleteBuffers(1, &m_impostorInstanceVBO);
+        m_impostorInstanceVBO = 0;
+    }
+    
+    if (m_connectionInstanceVBO) {
+        glDeleteBuffers(1, &m_connectionInstanceVBO);
+        m_connectionInstanceVBO = 0;
+    }
+    
+    deleteRenderTargets();
+    deletePickTarget();
+    
     // Release mesh resources
     m_sphereMesh.reset();
     m_cylinderMesh.reset();
     m_quadMesh.reset();
+    m_impostorMesh.reset();
+    m_staticSphereMesh.reset();
+    m_staticImpostorMesh.reset();
+    m_staticCylinderMesh.reset();
     
     // Release shader resources
     m_neuronShader.reset();
-    m_connectionShader.reset();
-    m_textShader.reset();
+    m_uiShader.reset();
+    m_uiHeatmapShader.reset();
     m_dataFlowShader.reset();
+    m_particleUpdateShader.reset();
+    m_neuronInstancedShader.reset();
+    m_neuronImpostorShader.reset();
+    m_connectionShader.reset();
+    m_heatmapShader.reset();
+    m_compositeShader.reset();
     
     // Destroy window and terminate GLFW
     if (m_window) {
@@ -94,20 +348,71 @@ bool Renderer::initialize(int width, int height) {
     // Load shaders
     loadShaders();
     
+    // Offscreen targets for order-independent transparency
+    if (!createRenderTargets()) {
+        std::cerr << "Order-independent transparency unavailable, blending in draw order" << std::endl;
+        deleteRenderTargets();
+    }
+    if (!createPickTarget()) {
+        std::cerr << "GPU picking unavailable" << std::endl;
+        deletePickTarget();
+    }
+    
     // Create meshes
     createMeshes();
     
     // Load fonts
     loadFonts();
     
+    // Colormap for activation heatmaps
+    createColormap();
+    
+    // GPU particles for the data-flow animation
+    m_particles = std::make_unique<ParticleSystem>(kParticleCapacity);
+    if (!m_particles->initialize()) {
+        std::cerr << "Failed to create data flow particles" << std::endl;
+        m_particles.reset();
+    }
+    
     return true;
 }
 
 void Renderer::beginFrame() {
-    // Clear the screen
+    // Map the pick only once its copy has landed; until then the previous
+    // result stands and the read back stays in flight
+    if (m_pickInFlight) {
+        GLenum status = glClientWaitSync(m_pickFence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pickPixelBuffer);
+            const GLuint* id = static_cast<const GLuint*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint), GL_MAP_READ_BIT));
+            m_pickResult = id ? *id : 0;
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            m_pickReady = true;
+        }
+        // A failed wait drops the pick rather than leaving it in flight forever
+        if (status != GL_TIMEOUT_EXPIRED) {
+            glDeleteSync(m_pickFence);
+            m_pickFence = 0;
+            m_pickInFlight = false;
+        }
+    }
+    
+    // Clear the screen, or the offscreen scene that endFrame() presents
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFramebuffer);
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
+    m_neuronInstances.clear();
+    m_connectionInstances.clear();
+    m_bakedNeuronRanges.clear();
+    m_bakedConnectionRanges.clear();
+    m_renderQueue.clear();
+    m_labels.clear();
+    m_renderStats.activationRowsUploaded = 0;
+    m_renderStats.attentionBytesUploaded = 0;
+    m_renderStats.attentionTilesComputed = 0;
+    
     // Set up projection and view matrices if camera is available
     if (m_camera) {
         // Calculate aspect ratio
@@ -117,35 +422,33 @@ void Renderer::beginFrame() {
         glm::mat4 projection = m_camera->getProjectionMatrix(aspectRatio);
         glm::mat4 view = m_camera->getViewMatrix();
         
-        // Apply to ALL shaders
-        if (m_neuronShader) {
-            m_neuronShader->use();
-            m_neuronShader->setUniform("projection", projection);
-            m_neuronShader->setUniform("view", view);
-            m_neuronShader->setUniform("viewPos", m_camera->getPosition());
-            m_neuronShader->setUniform("lightPos", m_camera->getPosition());
-        }
+        // Culling volume for this frame
+        m_frustum.update(projection * view);
+        m_pixelsPerUnit = getPixelsPerUnit();
         
-        if (m_connectionShader) {
-            m_connectionShader->use();
-            m_connectionShader->setUniform("projection", projection);
-            m_connectionShader->setUniform("view", view);
-        }
-        
-        if (m_textShader) {
-            m_textShader->use();
-            m_textShader->setUniform("projection", projection);
-        }
-        
-        if (m_dataFlowShader) {
-            m_dataFlowShader->use();
-            m_dataFlowShader->setUniform("projection", projection);
-            m_dataFlowShader->setUniform("view", view);
-        }
+        // One upload of the per-frame camera block, shared by every 3D program
+        CameraBlock block;
+        block.projection = projection;
+        block.view = view;
+        block.viewPos = glm::vec4(m_camera->getPosition(), 1.0f);
+        block.viewport = glm::vec4(static_cast<float>(m_width), static_cast<float>(m_height), 0.0f, 0.0f);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_cameraUBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
     }
 }
 
 void Renderer::endFrame() {
+    if (m_sceneFramebuffer) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_sceneFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    
+    // The whole 2D overlay in one draw
+    flushUI();
+    
     // Swap buffers
     glfwSwapBuffers(m_window);
     
@@ -157,79 +460,13 @@ void Renderer::renderLayer(const Layer* layer) {
     // Implementation depends on layer type
     switch (layer->getType()) {
         case LayerType::EMBEDDING:
-            // Render as a grid or panel
-            {
-                glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f); // Would come from layer
-                glm::vec4 color = glm::vec4(0.2f, 0.6f, 0.8f, 0.7f); // Blue for embedding
-                
-                // Calculate dimensions based on layer size
-                float width = 2.0f;
-                float height = 2.0f;
-                
-                // Create model matrix
-                glm::mat4 model = glm::mat4(1.0f);
-                model = glm::translate(model, position);
-                model = glm::scale(model, glm::vec3(width, height, 0.1f));
-                
-                // Use appropriate shader
-                m_neuronShader->use();
-                m_neuronShader->setUniform("model", model);
-                m_neuronShader->setUniform("color", color);
-                
-                // Render a quad
-                m_quadMesh->render();
-            }
-            break;
-            
         case LayerType::NORMALIZATION:
-            // Render as a thin slab
-            {
-                glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f); // Would come from layer
-                glm::vec4 color = glm::vec4(0.8f, 0.8f, 0.3f, 0.7f); // Yellow for normalization
-                
-                // Calculate dimensions
-                float width = 1.5f;
-                float height = 0.2f;
-                
-                // Create model matrix
-                glm::mat4 model = glm::mat4(1.0f);
-                model = glm::translate(model, position);
-                model = glm::scale(model, glm::vec3(width, height, 1.0f));
-                
-                // Use appropriate shader
-                m_neuronShader->use();
-                m_neuronShader->setUniform("model", model);
-                m_neuronShader->setUniform("color", color);
-                
-                // Render a quad
-                m_quadMesh->render();
-            }
-            break;
-            
-        case LayerType::OUTPUT:
-            // Render as a larger grid
-            {
-                glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f); // Would come from layer
-                glm::vec4 color = glm::vec4(0.8f, 0.4f, 0.8f, 0.7f); // Purple for output
-                
-                // Calculate dimensions
-                float width = 3.0f;
-                float height = 3.0f;
-                
-                // Create model matrix
-                glm::mat4 model = glm::mat4(1.0f);
-                model = glm::translate(model, position);
-                model = glm::scale(model, glm::vec3(width, height, 0.1f));
-                
-                // Use appropriate shader
-                m_neuronShader->use();
-                m_neuronShader->setUniform("model", model);
-                m_neuronShader->setUniform("color", color);
-                
-                // Render a quad
-                m_quadMesh->render();
-            }
+        case LayerType::OUTPUT: {
+            // Render as a heatmap of the layer's activations over its footprint
+            BoundingBox bounds = layer->getBounds();
+            renderActivationSlab(layer, bounds.getCenter(), bounds.max - bounds.min, kSlabAlpha);
             break;
+        }
             
         case LayerType::ATTENTION:
         case LayerType::FEEDFORWARD:
@@ -238,194 +475,921 @@ void Renderer::renderLayer(const Layer* layer) {
     }
 }
 
-void Renderer::renderNeuron(const glm::vec3& position, float size, const glm::vec4& color) {
-    if (!m_neuronShader || !m_sphereMesh) return;
+void Renderer::renderSlab(const glm::vec3& center, const glm::vec3& size, const glm::vec4& color) {
+    if (!m_neuronShader || !m_quadMesh) return;
     
-    m_neuronShader->use();
-    
-    // Calculate model matrix
+    // Create model matrix
     glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, position);
-    model = glm::scale(model, glm::vec3(size));
-    
-    // Set uniforms
-    m_neuronShader->setUniform("model", model);
-    m_neuronShader->setUniform("color", color);
-    
-    // Render sphere
-    m_sphereMesh->render();
+    model = glm::translate(model, center);
+    model = glm::scale(model, size);
+    
+    // Queue a quad; translucent slabs go to the weighted blended pass
+    RenderPass pass = color.a < 1.0f ? RenderPass::TRANSPARENT_PASS : RenderPass::OPAQUE_PASS;
+    DrawItem item;
+    item.key = RenderQueue::makeKey(pass, m_neuronProgram.sortId, QUAD_MESH_ID, 0, getViewDepth(center));
+    item.program = &m_neuronProgram;
+    item.mesh = m_quadMesh.get();
+    item.level = m_quadMesh->getLodCount() - 1;
+    item.instanceCount = 0;
+    item.firstInstance = 0;
+    item.pickId = m_pickName;
+    item.model = model;
+    item.color = color;
+    item.progress = 0.0f;
+    m_renderQueue.push(item);
 }
 
-void Renderer::renderConnection(const glm::vec3& from, const glm::vec3& to, float strength, const glm::vec4& color) {
-    if (!m_connectionShader || !m_cylinderMesh) return;
+void Renderer::renderActivationSlab(const Layer* layer, const glm::vec3& center, const glm::vec3& size, float alpha) {
+    const ActivationPyramid& pyramid = layer->getActivationPyramid();
+    if (pyramid.empty() || !m_heatmapShader || !m_quadMesh) return;
+    
+    glm::vec2 uvMin, uvMax;
+    float pixelArea;
+    if (!getVisibleSlabRect(center, size, uvMin, uvMax, pixelArea)) return;
+    
+    ActivationSlab& slab = m_activationSlabs[layer];
+    if (!slab.texture) {
+        slab.texture = std::make_unique<ActivationTexture>();
+        slab.window = { -1, 0, 0, 0, 0 };
+    }
     
-    m_connectionShader->use();
+    // Finest level whose visible texels fit in the pixels they cover
+    HeatmapLayout layout = makeHeatmapLayout(pyramid.getValueCount(), size.x / size.y);
+    float texelBudget = std::min(std::max(pixelArea, 1.0f), kMaxHeatmapTexels);
+    HeatmapWindow window;
+    int gridWidth = 0;
+    int gridHeight = 0;
+    for (window.reduction = 0; ; window.reduction++) {
+        int tileSize = 1 << (layout.tileBits - window.reduction);
+        gridWidth = layout.tilesX * tileSize;
+        gridHeight = layout.tilesY * tileSize;
+        window.x = static_cast<int>(std::floor(uvMin.x * gridWidth));
+        window.y = static_cast<int>(std::floor(uvMin.y * gridHeight));
+        window.width = std::max(1, std::min(static_cast<int>(std::ceil(uvMax.x * gridWidth)), gridWidth) - window.x);
+        window.height = std::max(1, std::min(static_cast<int>(std::ceil(uvMax.y * gridHeight)), gridHeight) - window.y);
+        if (window.reduction == layout.tileBits || window.width * window.height <= texelBudget) break;
+    }
     
-    // Calculate direction and length
-    glm::vec3 direction = to - from;
-    float length = glm::length(direction);
+    // Rebuild the window's texels when the layer or the window changed; the
+    // texture then diffs them against what it holds
+    const HeatmapWindow& held = slab.window;
+    bool moved = window.reduction != held.reduction || window.x != held.x || window.y != held.y ||
+                 window.width != held.width || window.height != held.height;
+    if (moved || slab.version != layer->getActivationVersion()) {
+        const std::vector<PyramidEntry>& entries = pyramid.getLevel(2 * window.reduction);
+        m_heatmapTexels.resize(static_cast<size_t>(window.width) * window.height);
+        for (int y = 0; y < window.height; y++) {
+            for (int x = 0; x < window.width; x++) {
+                size_t index = getHeatmapIndex(layout, window.reduction, window.x + x, window.y + y);
+                m_heatmapTexels[y * window.width + x] =
+                    index < entries.size() ? ActivationPyramid::getExtreme(entries[index]) : 0.0f;
+            }
+        }
+        slab.texture->resize(window.width * window.height, window.width);
+        m_renderStats.activationRowsUploaded += slab.texture->update(m_heatmapTexels);
+        slab.version = layer->getActivationVersion();
+        slab.window = window;
+    }
     
-    if (length < 0.0001f) return; // Avoid zero-length connections
+    // Draw just the window's part of the slab
+    glm::vec2 windowMin(static_cast<float>(window.x) / gridWidth, static_cast<float>(window.y) / gridHeight);
+    glm::vec2 windowSize(static_cast<float>(window.width) / gridWidth, static_cast<float>(window.height) / gridHeight);
+    glm::vec3 windowCenter = center + glm::vec3((windowMin + windowSize * 0.5f - 0.5f) * glm::vec2(size), 0.0f);
     
-    // Normalize direction
-    direction = glm::normalize(direction);
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, windowCenter);
+    model = glm::scale(model, glm::vec3(size.x * windowSize.x, size.y * windowSize.y, 1.0f));
+    
+    RenderPass pass = alpha < 1.0f ? RenderPass::TRANSPARENT_PASS : RenderPass::OPAQUE_PASS;
+    DrawItem item;
+    item.key = RenderQueue::makeKey(pass, m_heatmapProgram.sortId, QUAD_MESH_ID, 0, getViewDepth(center));
+    item.program = &m_heatmapProgram;
+    item.mesh = m_quadMesh.get();
+    item.level = m_quadMesh->getLodCount() - 1;
+    item.instanceCount = 0;
+    item.firstInstance = 0;
+    item.pickId = m_pickName;
+    item.model = model;
+    item.color = glm::vec4(1.0f, 1.0f, 1.0f, alpha);
+    item.progress = 0.0f;
+    item.texture = slab.texture->getTexture();
+    item.valueRange = std::max(slab.texture->getValueRange(), 1e-6f);
+    item.texRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    m_renderQueue.push(item);
+}
+
+void Renderer::renderAttentionPattern(const AttentionHead* head, const glm::vec3& center, float size) {
+    if (!m_heatmapShader || !m_quadMesh) return;
+    AttentionTexture* texture = updateAttentionTexture(head);
+    if (!texture) return;
     
-    // Calculate rotation from default cylinder orientation (along y-axis)
-    glm::vec3 defaultDir(0.0f, 1.0f, 0.0f);
-    glm::vec3 rotationAxis = glm::cross(defaultDir, direction);
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, center);
+    model = glm::scale(model, glm::vec3(size, size, 1.0f));
+    
+    // The quad's top edge (v = 1) samples row 0
+    float extent = texture->getFilledExtent();
+    DrawItem item;
+    item.key = RenderQueue::makeKey(RenderPass::OPAQUE_PASS, m_heatmapProgram.sortId, QUAD_MESH_ID, 0, getViewDepth(center));
+    item.program = &m_heatmapProgram;
+    item.mesh = m_quadMesh.get();
+    item.level = m_quadMesh->getLodCount() - 1;
+    item.instanceCount = 0;
+    item.firstInstance = 0;
+    item.pickId = m_pickName;
+    item.model = model;
+    item.color = glm::vec4(1.0f);
+    item.progress = 0.0f;
+    item.texture = texture->getTexture();
+    item.valueRange = 1.0f;
+    item.texRect = glm::vec4(0.0f, extent, extent, -extent);
+    m_renderQueue.push(item);
+}
+
+AttentionTexture* Renderer::updateAttentionTexture(const AttentionHead* head) {
+    if (head->getAttentionWeights().empty()) return nullptr;
     
-    if (glm::length(rotationAxis) < 0.0001f) {
-        // If direction is parallel to defaultDir, use a different rotation axis
-        rotationAxis = glm::vec3(1.0f, 0.0f, 0.0f);
+    std::unique_ptr<AttentionTexture>& texture = m_attentionTextures[head];
+    if (!texture) {
+        texture = std::make_unique<AttentionTexture>();
+    }
+    m_renderStats.attentionBytesUploaded += texture->update(*head);
+    return texture.get();
+}
+
+void Renderer::renderNeuron(const glm::vec3& position, float size, const glm::vec4& color) {
+    NeuronInstance instance;
+    instance.positionSize = glm::vec4(position, size);
+    instance.color = color;
+    m_neuronInstances.push_back(instance);
+}
+
+void Renderer::flushNeurons() {
+    if (m_neuronInstances.empty() || !m_neuronInstancedShader || !m_sphereMesh) return;
+    
+    // Pick impostor or a sphere LOD per neuron from its projected radius in pixels
+    m_impostorInstances.clear();
+    m_meshInstances.clear();
+    m_lodLevels.clear();
+    // Buckets pair each LOD with a pass: translucent neurons are blended
+    auto isTranslucent = [](const NeuronInstance& instance) { return instance.color.a < 1.0f ? 1 : 0; };
+    if (m_neuronInstances.size() > kMaxMeshNeurons || !m_camera) {
+        m_impostorInstances.swap(m_neuronInstances);
     } else {
-        rotationAxis = glm::normalize(rotationAxis);
+        glm::vec3 eye = m_camera->getPosition();
+        glm::vec3 front = m_camera->getFront();
+        float pixelsPerUnit = getPixelsPerUnit();
+        int levelCount = m_sphereMesh->getLodCount();
+        
+        for (const NeuronInstance& instance : m_neuronInstances) {
+            float depth = std::max(glm::dot(glm::vec3(instance.positionSize) - eye, front), 0.0001f);
+            float pixelRadius = instance.positionSize.w * pixelsPerUnit / depth;
+            if (pixelRadius < kImpostorPixelRadius) {
+                m_impostorInstances.push_back(instance);
+            } else {
+                m_meshInstances.push_back(instance);
+                m_lodLevels.push_back(selectLod(pixelRadius, kSphereLodPixels, levelCount) * 2 + isTranslucent(instance));
+            }
+        }
     }
     
-    float rotationAngle = acos(glm::dot(defaultDir, direction));
-    
-    // Calculate model matrix
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, from);
-    model = glm::rotate(model, rotationAngle, rotationAxis);
-    model = glm::scale(model, glm::vec3(0.05f, length, 0.05f)); // Adjust thickness as needed
+    if (!m_meshInstances.empty()) {
+        int bucketCount = m_sphereMesh->getLodCount() * 2;
+        bucketByLevel(m_meshInstances, m_lodLevels, bucketCount, m_neuronInstances, m_lodStart);
+        uploadStream(m_neuronInstanceVBO, m_neuronInstanceCapacity, m_neuronInstances.data(),
+                        m_neuronInstances.size() * sizeof(NeuronInstance));
+        
+        for (int bucket = 0; bucket < bucketCount; bucket++) {
+            if (m_lodStart[bucket + 1] == m_lodStart[bucket]) continue;
+            RenderPass pass = bucket % 2 ? RenderPass::TRANSPARENT_PASS : RenderPass::OPAQUE_PASS;
+            DrawItem item;
+            item.key = RenderQueue::makeKey(pass, m_neuronInstancedProgram.sortId, SPHERE_MESH_ID, bucket / 2, 0.0f);
+            item.program = &m_neuronInstancedProgram;
+            item.mesh = m_sphereMesh.get();
+            item.level = bucket / 2;
+            item.instanceCount = m_lodStart[bucket + 1] - m_lodStart[bucket];
+            item.firstInstance = m_lodStart[bucket];
+            item.pickId = 0;
+            m_renderQueue.push(item);
+        }
+    }
     
-    // Set uniforms
-    m_connectionShader->setUniform("model", model);
-    m_connectionShader->setUniform("color", color);
-    m_connectionShader->setUniform("strength", strength);
+    if (!m_impostorInstances.empty() && m_neuronImpostorShader) {
+        m_lodLevels.clear();
+        for (const NeuronInstance& instance : m_impostorInstances) {
+            m_lodLevels.push_back(isTranslucent(instance));
+        }
+        bucketByLevel(m_impostorInstances, m_lodLevels, 2, m_neuronInstances, m_lodStart);
+        uploadStream(m_impostorInstanceVBO, m_impostorInstanceCapacity, m_neuronInstances.data(),
+                        m_neuronInstances.size() * sizeof(NeuronInstance));
+        for (int bucket = 0; bucket < 2; bucket++) {
+            if (m_lodStart[bucket + 1] == m_lodStart[bucket]) continue;
+            RenderPass pass = bucket ? RenderPass::TRANSPARENT_PASS : RenderPass::OPAQUE_PASS;
+            DrawItem item;
+            item.key = RenderQueue::makeKey(pass, m_neuronImpostorProgram.sortId, IMPOSTOR_MESH_ID, 0, 0.0f);
+            item.program = &m_neuronImpostorProgram;
+            item.mesh = m_impostorMesh.get();
+            item.level = 0;
+            item.instanceCount = m_lodStart[bucket + 1] - m_lodStart[bucket];
+            item.firstInstance = m_lodStart[bucket];
+            item.pickId = 0;
+            m_renderQueue.push(item);
+        }
+    }
     
-    // Render cylinder
-    m_cylinderMesh->render();
+    m_neuronInstances.clear();
+    m_impostorInstances.clear();
 }
 
-void Renderer::renderDataFlow(const glm::vec3& start, const glm::vec3& end, float progress, const glm::vec4& color) {
-    m_dataFlowShader->use();
+void Renderer::renderConnection(const glm::vec3& from, const glm::vec3& to, float strength, const glm::vec4& color) {
+    ConnectionInstance instance;
+    instance.fromStrength = glm::vec4(from, strength);
+    instance.toRadius = glm::vec4(to, kConnectionRadius);
+    instance.color = color;
+    m_connectionInstances.push_back(instance);
+}
+
+void Renderer::flushConnections() {
+    if (m_connectionInstances.empty() || !m_connectionShader || !m_cylinderMesh) return;
     
-    // Calculate position along the path
-    glm::vec3 position = start + (end - start) * progress;
+    // Cylinder LOD per edge from its projected radius at the midpoint
+    int levelCount = m_cylinderMesh->getLodCount();
+    m_lodLevels.clear();
+    if (m_camera) {
+        glm::vec3 eye = m_camera->getPosition();
+        glm::vec3 front = m_camera->getFront();
+        float pixelsPerUnit = getPixelsPerUnit();
+        
+        for (const ConnectionInstance& instance : m_connectionInstances) {
+            glm::vec3 midpoint = (glm::vec3(instance.fromStrength) + glm::vec3(instance.toRadius)) * 0.5f;
+            float depth = std::max(glm::dot(midpoint - eye, front), 0.0001f);
+            m_lodLevels.push_back(selectLod(instance.toRadius.w * pixelsPerUnit / depth, kCylinderLodPixels, levelCount));
+        }
+    } else {
+        m_lodLevels.assign(m_connectionInstances.size(), levelCount - 1);
+    }
     
-    // Create model matrix
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, position);
-    model = glm::scale(model, glm::vec3(0.1f)); // Small size for data particle
+    bucketByLevel(m_connectionInstances, m_lodLevels, levelCount, m_sortedConnectionInstances, m_lodStart);
+    uploadStream(m_connectionInstanceVBO, m_connectionInstanceCapacity, m_sortedConnectionInstances.data(),
+                    m_sortedConnectionInstances.size() * sizeof(ConnectionInstance));
+    
+    // Edges span the scene and have no single depth; the weighted blended
+    // pass needs none
+    for (int level = 0; level < levelCount; level++) {
+        if (m_lodStart[level + 1] == m_lodStart[level]) continue;
+        DrawItem item;
+        item.key = RenderQueue::makeKey(RenderPass::TRANSPARENT_PASS, m_connectionProgram.sortId, CYLINDER_MESH_ID, level, 0.0f);
+        item.program = &m_connectionProgram;
+        item.mesh = m_cylinderMesh.get();
+        item.level = level;
+        item.instanceCount = m_lodStart[level + 1] - m_lodStart[level];
+        item.firstInstance = m_lodStart[level];
+        item.pickId = 0;
+        m_renderQueue.push(item);
+    }
     
-    // Set uniforms
-    m_dataFlowShader->setUniform("model", model);
-    m_dataFlowShader->setUniform("color", color);
-    m_dataFlowShader->setUniform("progress", progress);
+    m_connectionInstances.clear();
+}
+
+int Renderer::bakeNeurons(const std::vector<glm::vec4>& positionSizes) {
+    if (!m_staticNeurons) return 0;
+    return m_staticNeurons->append(positionSizes.data(), static_cast<int>(positionSizes.size()));
+}
+
+int Renderer::bakeConnections(const std::vector<glm::vec3>& endpoints, float strength) {
+    if (!m_staticConnections) return 0;
+    std::vector<glm::vec4> geometry;
+    for (size_t i = 0; i + 1 < endpoints.size(); i += 2) {
+        geometry.push_back(glm::vec4(endpoints[i], strength));
+        geometry.push_back(glm::vec4(endpoints[i + 1], kConnectionRadius));
+    }
+    return m_staticConnections->append(geometry.data(), static_cast<int>(geometry.size() / 2));
+}
+
+void Renderer::setBakedNeuronColors(int first, const std::vector<glm::vec4>& colors) {
+    if (m_staticNeurons) m_staticNeurons->setColors(first, colors.data(), static_cast<int>(colors.size()));
+}
+
+void Renderer::setBakedConnectionColors(int first, const std::vector<glm::vec4>& colors) {
+    if (m_staticConnections) m_staticConnections->setColors(first, colors.data(), static_cast<int>(colors.size()));
+}
+
+void Renderer::renderBakedNeurons(int first, int count, const glm::vec3& center, float radius, bool transparent) {
+    if (count <= 0 || !m_sphereMesh) return;
     
-    // Render sphere for data particle
-    m_sphereMesh->render();
+    // Without a camera everything is an impostor, as in flushNeurons()
+    BakedRange range = { -1, first, count, transparent };
+    if (m_camera) {
+        float pixelRadius = radius * m_pixelsPerUnit / std::max(getViewDepth(center), 0.0001f);
+        if (pixelRadius >= kImpostorPixelRadius) {
+            range.level = selectLod(pixelRadius, kSphereLodPixels, m_sphereMesh->getLodCount());
+        }
+    }
+    m_bakedNeuronRanges.push_back(range);
 }
 
-void Renderer::renderText(const std::string& text, const glm::vec2& position, float scale, const glm::vec4& color) {
-    // Enable blending for text
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+void Renderer::renderBakedConnections(int first, int count, const glm::vec3& center) {
+    if (count <= 0 || !m_cylinderMesh) return;
     
-    m_textShader->use();
+    int levelCount = m_cylinderMesh->getLodCount();
+    BakedRange range = { levelCount - 1, first, count, true };
+    if (m_camera) {
+        float pixelRadius = kConnectionRadius * m_pixelsPerUnit / std::max(getViewDepth(center), 0.0001f);
+        range.level = selectLod(pixelRadius, kCylinderLodPixels, levelCount);
+    }
+    m_bakedConnectionRanges.push_back(range);
+}
+
+void Renderer::clearStaticGeometry() {
+    if (m_staticNeurons) m_staticNeurons->clear();
+    if (m_staticConnections) m_staticConnections->clear();
+    m_staticGeneration++;
+}
+
+void Renderer::clearModelTextures() {
+    m_activationSlabs.clear();
+    m_attentionTextures.clear();
+    m_attentionTiles.clear();
+}
+
+void Renderer::flushStaticGeometry() {
+    m_renderStats.staticBytesUploaded = 0;
+    if (!m_staticNeurons || !m_staticConnections) return;
+    m_renderStats.staticBytesUploaded = static_cast<int>(m_staticNeurons->upload() + m_staticConnections->upload());
+    
+    // Same cap as the streamed neurons: past it, every baked neuron is an impostor
+    size_t meshNeurons = 0;
+    for (const BakedRange& range : m_bakedNeuronRanges) {
+        if (range.level >= 0) meshNeurons += range.count;
+    }
+    if (meshNeurons > kMaxMeshNeurons) {
+        for (BakedRange& range : m_bakedNeuronRanges) {
+            range.level = -1;
+        }
+    }
     
-    // Set orthographic projection with inverted Y axis to match screen coordinates
-    glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(m_width), 
-                                    static_cast<float>(m_height), 0.0f); // Note inverted Y
-    m_textShader->setUniform("projection", projection);
-    m_textShader->setUniform("textColor", color);
+    // Ranges in (pass, level, first) order; adjacent ones of a pass and level
+    // become one draw
+    auto mergeRanges = [](std::vector<BakedRange>& ranges) {
+        std::sort(ranges.begin(), ranges.end(), [](const BakedRange& a, const BakedRange& b) {
+            if (a.transparent != b.transparent) return b.transparent;
+            return a.level != b.level ? a.level < b.level : a.first < b.first;
+        });
+        size_t merged = 0;
+        for (size_t i = 0; i < ranges.size(); i++) {
+            if (merged > 0 && ranges[merged - 1].level == ranges[i].level &&
+                ranges[merged - 1].transparent == ranges[i].transparent &&
+                ranges[merged - 1].first + ranges[merged - 1].count == ranges[i].first) {
+                ranges[merged - 1].count += ranges[i].count;
+            } else {
+                ranges[merged++] = ranges[i];
+            }
+        }
+        ranges.resize(merged);
+    };
+    mergeRanges(m_bakedNeuronRanges);
+    mergeRanges(m_bakedConnectionRanges);
+    
+    for (const BakedRange& range : m_bakedNeuronRanges) {
+        bool impostor = range.level < 0;
+        const DrawProgram& program = impostor ? m_neuronImpostorProgram : m_neuronInstancedProgram;
+        DrawItem item;
+        RenderPass pass = range.transparent ? RenderPass::TRANSPARENT_PASS : RenderPass::OPAQUE_PASS;
+        item.key = RenderQueue::makeKey(pass, program.sortId, impostor ? IMPOSTOR_MESH_ID : SPHERE_MESH_ID,
+                                        std::max(range.level, 0), 0.0f);
+        item.program = &program;
+        item.mesh = impostor ? m_staticImpostorMesh.get() : m_staticSphereMesh.get();
+        item.level = std::max(range.level, 0);
+        item.instanceCount = range.count;
+        item.firstInstance = range.first;
+        item.pickId = kPickInstanceBit + range.first;
+        m_renderQueue.push(item);
+    }
     
-    // Bind VAO and texture
-    glBindVertexArray(m_textVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_fontTexture);
+    // Transparent like the streamed connections
+    for (const BakedRange& range : m_bakedConnectionRanges) {
+        DrawItem item;
+        item.key = RenderQueue::makeKey(RenderPass::TRANSPARENT_PASS, m_connectionProgram.sortId, CYLINDER_MESH_ID, range.level, 0.0f);
+        item.program = &m_connectionProgram;
+        item.mesh = m_staticCylinderMesh.get();
+        item.level = range.level;
+        item.instanceCount = range.count;
+        item.firstInstance = range.first;
+        item.pickId = 0;
+        m_renderQueue.push(item);
+    }
     
-    // Since we don't have a real font, just render each character as a solid rectangle
-    float x = position.x;
-    for (char c : text) {
-        if (c == ' ') {
-            // Handle spaces specially
-            x += 8.0f * scale;
-            continue;
+    m_bakedNeuronRanges.clear();
+    m_bakedConnectionRanges.clear();
+}
+
+float Renderer::getViewDepth(const glm::vec3& position) const {
+    if (!m_camera) return 0.0f;
+    return glm::dot(position - m_camera->getPosition(), m_camera->getFront());
+}
+
+float Renderer::getPixelsPerUnit() const {
+    // Screen pixels covered by one world unit at depth 1
+    float aspectRatio = (float)m_width / (float)m_height;
+    return m_camera->getProjectionMatrix(aspectRatio)[1][1] * m_height * 0.5f;
+}
+
+bool Renderer::getVisibleSlabRect(const glm::vec3& center, const glm::vec3& size,
+                                  glm::vec2& uvMin, glm::vec2& uvMax, float& pixelArea) const {
+    uvMin = glm::vec2(0.0f);
+    uvMax = glm::vec2(1.0f);
+    pixelArea = static_cast<float>(m_width) * m_height;
+    if (size.x <= 0.0f || size.y <= 0.0f) return false;
+    if (!m_camera || m_width <= 0 || m_height <= 0) return true;
+    
+    float aspectRatio = (float)m_width / (float)m_height;
+    glm::mat4 viewProjection = m_camera->getProjectionMatrix(aspectRatio) * m_camera->getViewMatrix();
+    glm::vec2 origin = glm::vec2(center) - glm::vec2(size) * 0.5f;
+    
+    // Screen bounds of the slab, or the whole screen once it reaches behind the camera
+    glm::vec2 ndcMin(1.0f);
+    glm::vec2 ndcMax(-1.0f);
+    for (int i = 0; i < 4; i++) {
+        glm::vec2 corner = origin + glm::vec2((i & 1) * size.x, (i >> 1) * size.y);
+        glm::vec4 clip = viewProjection * glm::vec4(corner, center.z, 1.0f);
+        if (clip.w <= 0.0f) {
+            ndcMin = glm::vec2(-1.0f);
+            ndcMax = glm::vec2(1.0f);
+            break;
         }
-        
-        // Simple character size
-        float charWidth = 10.0f * scale;
-        float charHeight = 16.0f * scale;
-        
-        // Create a simple quad for each character
-        float vertices[6][4] = {
-            { x,          position.y,                0.0f, 0.0f },
-            { x,          position.y + charHeight,   0.0f, 1.0f },
-            { x + charWidth, position.y + charHeight,   1.0f, 1.0f },
-            
-            { x,          position.y,                0.0f, 0.0f },
-            { x + charWidth, position.y + charHeight,   1.0f, 1.0f },
-            { x + charWidth, position.y,                1.0f, 0.0f }
-        };
-        
-        // Update buffer
-        glBindBuffer(GL_ARRAY_BUFFER, m_textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        
-        // Render quad
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        // Move to next character position
-        x += charWidth + 2.0f * scale; // Add some spacing between characters
+        ndcMin = glm::min(ndcMin, glm::vec2(clip) / clip.w);
+        ndcMax = glm::max(ndcMax, glm::vec2(clip) / clip.w);
     }
-    
-    // Clean up
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    ndcMin = glm::max(ndcMin, glm::vec2(-1.0f));
+    ndcMax = glm::min(ndcMax, glm::vec2(1.0f));
+    if (ndcMin.x >= ndcMax.x || ndcMin.y >= ndcMax.y) return false;
+    pixelArea = (ndcMax.x - ndcMin.x) * 0.5f * m_width * (ndcMax.y - ndcMin.y) * 0.5f * m_height;
+    
+    // Cast the corners of that screen rectangle onto the slab's plane
+    glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+    glm::vec2 visibleMin(1.0f);
+    glm::vec2 visibleMax(0.0f);
+    for (int i = 0; i < 4; i++) {
+        glm::vec2 ndc((i & 1) ? ndcMax.x : ndcMin.x, (i >> 1) ? ndcMax.y : ndcMin.y);
+        glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+        glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+        glm::vec3 from = glm::vec3(nearPoint) / nearPoint.w;
+        glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - from;
+        float t = std::fabs(direction.z) > 1e-6f ? (center.z - from.z) / direction.z : -1.0f;
+        if (t < 0.0f) {
+            // Grazing view: keep the whole slab
+            return true;
+        }
+        glm::vec2 uv = (glm::vec2(from + direction * t) - origin) / glm::vec2(size);
+        visibleMin = glm::min(visibleMin, uv);
+        visibleMax = glm::max(visibleMax, uv);
+    }
+    uvMin = glm::clamp(visibleMin, glm::vec2(0.0f), glm::vec2(1.0f));
+    uvMax = glm::clamp(visibleMax, glm::vec2(0.0f), glm::vec2(1.0f));
+    return uvMin.x < uvMax.x && uvMin.y < uvMax.y;
 }
 
-void Renderer::renderRect(float x, float y, float width, float height, const glm::vec4& color) {
-    // Save current state
-    GLboolean depthTest;
-    glGetBooleanv(GL_DEPTH_TEST, &depthTest);
-    
-    // Disable depth testing for UI elements
-    glDisable(GL_DEPTH_TEST);
+void Renderer::uploadStream(GLuint buffer, size_t& capacity, const void* data, size_t bytes) {
+    // Orphan the buffer each frame so the driver never stalls on the previous draw
+    if (bytes > capacity) {
+        capacity = std::max(bytes, capacity * 2);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer::updateDataFlow(const std::vector<DataFlowNode>& path, float deltaTime) {
+    if (!m_particles || !m_particleUpdateShader || deltaTime <= 0.0f) return;
+    
+    // Spawn weights as a cumulative distribution over the nodes that have a
+    // next node to flow to; intensity is magnitude relative to the strongest
+    int nodeCount = std::min(static_cast<int>(path.size()), kMaxFlowNodes);
+    float totalWeight = 0.0f;
+    float maxMagnitude = 0.0f;
+    for (int i = 0; i < nodeCount; i++) {
+        float magnitude = std::max(path[i].magnitude, 0.0f);
+        if (i + 1 < nodeCount) totalWeight += magnitude;
+        maxMagnitude = std::max(maxMagnitude, magnitude);
+    }
     
-    // Use text shader (or create a UI shader if needed)
-    m_textShader->use();
+    m_flowNodes.resize(nodeCount);
+    m_flowExtents.resize(nodeCount);
+    float cumulative = 0.0f;
+    for (int i = 0; i < nodeCount; i++) {
+        float magnitude = std::max(path[i].magnitude, 0.0f);
+        if (i + 1 < nodeCount) cumulative += magnitude;
+        m_flowNodes[i] = glm::vec4(path[i].position, totalWeight > 0.0f ? cumulative / totalWeight : 1.0f);
+        m_flowExtents[i] = glm::vec4(path[i].extent, maxMagnitude > 0.0f ? magnitude / maxMagnitude : 0.0f, 0.0f);
+    }
     
-    // Setup orthographic projection for UI
-    glm::mat4 projection = glm::ortho(0.0f, (float)m_width, (float)m_height, 0.0f);
-    m_textShader->setUniform("projection", projection);
+    // Nothing spawns until some layer has fired
+    float spawnChance = (nodeCount >= 2 && totalWeight > 0.0f) ? 1.0f - std::exp(-deltaTime / kParticleRespawnSeconds) : 0.0f;
     
-    // Bind VAO
-    glBindVertexArray(m_textVAO);
+    Shader& shader = *m_particleUpdateShader;
+    shader.use();
+    if (nodeCount > 0) {
+        shader.setUniform(shader.getUniformLocation("nodes"), m_flowNodes.data(), nodeCount);
+        shader.setUniform(shader.getUniformLocation("nodeExtents"), m_flowExtents.data(), nodeCount);
+    }
+    shader.setUniform("nodeCount", nodeCount);
+    shader.setUniform("deltaTime", deltaTime);
+    shader.setUniform("spawnChance", spawnChance);
+    shader.setUniform("seed", m_particleSeed++);
+    m_particles->step(shader.getProgram());
+}
+
+void Renderer::renderDataFlow() {
+    if (!m_particles || !m_dataFlowShader) return;
+    
+    // Particles blend with everything else in the transparent pass
+    DrawItem item;
+    item.key = RenderQueue::makeKey(RenderPass::TRANSPARENT_PASS, m_dataFlowProgram.sortId, PARTICLE_MESH_ID, 0, 0.0f);
+    item.program = &m_dataFlowProgram;
+    item.mesh = m_particles->getMesh();
+    item.level = 0;
+    item.instanceCount = m_particles->getCapacity();
+    item.firstInstance = 0;
+    item.pickId = 0;
+    m_renderQueue.push(item);
+}
+
+void Renderer::renderLabel(const glm::vec3& anchor, const std::string& text, float priority, const glm::vec4& color) {
+    m_labels.add(anchor, text, priority, color);
+}
+
+void Renderer::flushQueue() {
+    flushNeurons();
+    flushConnections();
+    flushStaticGeometry();
+    
+    // The colormap stays on its own unit for the whole queue
+    m_stateTracker.resetCounters();
+    m_stateTracker.invalidate();
+    m_stateTracker.bindTexture(kColormapTextureUnit, m_colormapTexture);
+    m_renderStats.drawCalls = m_renderQueue.submit(m_stateTracker, RenderPass::OPAQUE_PASS);
+    m_renderStats.drawCalls += renderTransparentPass();
+    m_renderStats.drawCalls += renderPickPass();
+    m_renderQueue.clear();
+    m_renderStats.stateChanges = m_stateTracker.getStateChanges();
+    m_renderStats.skippedChanges = m_stateTracker.getSkippedChanges();
+    
+    // Surviving labels start the overlay, under any panel drawn after them
+    m_renderStats.labelCandidates = m_labels.getCandidateCount();
+    m_renderStats.labelsPlaced = 0;
+    if (m_camera) {
+        float aspectRatio = (float)m_width / (float)m_height;
+        glm::mat4 viewProjection = m_camera->getProjectionMatrix(aspectRatio) * m_camera->getViewMatrix();
+        m_renderStats.labelsPlaced = m_labels.resolve(viewProjection, m_width, m_height, kLabelScale, m_uiBatch);
+    }
+    m_labels.clear();
+}
+
+int Renderer::renderTransparentPass() {
+    if (!m_oitFramebuffer) {
+        return m_renderQueue.submit(m_stateTracker, RenderPass::TRANSPARENT_PASS);
+    }
     
-    // Prepare vertices (positions in screen space)
-    float vertices[6][4] = {
-        { x,         y + height, 0.0f, 0.0f },
-        { x,         y,          0.0f, 1.0f },
-        { x + width, y,          1.0f, 1.0f },
-        
-        { x,         y + height, 0.0f, 0.0f },
-        { x + width, y,          1.0f, 1.0f },
-        { x + width, y + height, 1.0f, 0.0f }
+    // Accumulate weighted colour and weight against the scene's depth.
+    // GL 3.3 has one blend function for all targets, so revealage is kept in
+    // the accumulation alpha: rgb and the weight add, alpha multiplies down
+    // by (1 - alpha) from a clear of 1
+    const GLfloat accumClear[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    const GLfloat weightClear[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glBindFramebuffer(GL_FRAMEBUFFER, m_oitFramebuffer);
+    glClearBufferfv(GL_COLOR, 0, accumClear);
+    glClearBufferfv(GL_COLOR, 1, weightClear);
+    glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    setWeightedBlend(true);
+    int drawCalls = m_renderQueue.submit(m_stateTracker, RenderPass::TRANSPARENT_PASS);
+    setWeightedBlend(false);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFramebuffer);
+    if (drawCalls == 0) return 0;
+    
+    // Resolve over the opaque scene with one full-screen triangle
+    m_stateTracker.useProgram(m_compositeShader->getProgram());
+    m_stateTracker.bindVertexArray(m_compositeVAO);
+    m_stateTracker.setDepthTest(false);
+    m_stateTracker.bindTexture(kAccumulationTextureUnit, m_oitAccumTexture);
+    m_stateTracker.bindTexture(kWeightTextureUnit, m_oitWeightTexture);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    m_stateTracker.setDepthTest(true);
+    m_stateTracker.bindVertexArray(0);
+    return drawCalls + 1;
+}
+
+void Renderer::setWeightedBlend(bool enabled) {
+    Shader* shaders[] = {
+        m_neuronShader.get(), m_neuronInstancedShader.get(), m_neuronImpostorShader.get(),
+        m_connectionShader.get(), m_dataFlowShader.get(), m_heatmapShader.get()
     };
+    for (Shader* shader : shaders) {
+        m_stateTracker.useProgram(shader->getProgram());
+        shader->setUniform("weightedBlend", enabled);
+    }
+}
+
+void Renderer::setPickName(unsigned int name) {
+    m_pickName = name & ~kPickInstanceBit;
+}
+
+void Renderer::requestPick(int x, int y) {
+    if (!m_pickFramebuffer || x < 0 || y < 0 || x >= m_width || y >= m_height) return;
+    m_pickRequested = true;
+    m_pickPixel = glm::ivec2(x, m_height - 1 - y);
+}
+
+bool Renderer::pollPick(unsigned int& id) {
+    if (!m_pickReady) return false;
+    m_pickReady = false;
+    id = m_pickResult;
+    return true;
+}
+
+int Renderer::renderPickPass() {
+    if (!m_pickRequested || m_pickInFlight) return 0;
+    m_pickRequested = false;
+    
+    // Only the requested pixel is cleared and shaded
+    const GLuint background[] = { 0, 0, 0, 0 };
+    glBindFramebuffer(GL_FRAMEBUFFER, m_pickFramebuffer);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(m_pickPixel.x, m_pickPixel.y, 1, 1);
+    glClearBufferuiv(GL_COLOR, kPickDrawBuffer, background);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    int drawCalls = m_renderQueue.submitPicking(m_stateTracker);
+    glDisable(GL_SCISSOR_TEST);
+    
+    // Queue the copy into the pixel buffer and fence it; beginFrame() maps
+    // it once the fence is signaled
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pickPixelBuffer);
+    glReadPixels(m_pickPixel.x, m_pickPixel.y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    m_pickFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFramebuffer);
+    m_pickInFlight = true;
+    return drawCalls;
+}
+
+bool Renderer::createPickTarget() {
+    glGenTextures(1, &m_pickTexture);
+    glBindTexture(GL_TEXTURE_2D, m_pickTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, m_width, m_height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenRenderbuffers(1, &m_pickDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_pickDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    
+    // The programs write their pick id to output 2, so only that draw buffer is live
+    glGenFramebuffers(1, &m_pickFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_pickFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_pickTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_pickDepth);
+    const GLenum drawBuffers[] = { GL_NONE, GL_NONE, GL_COLOR_ATTACHMENT0 };
+    glDrawBuffers(kPickDrawBuffer + 1, drawBuffers);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+    glGenBuffers(1, &m_pickPixelBuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pickPixelBuffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), NULL, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    
+    if (!complete) {
+        std::cerr << "Pick framebuffer is incomplete" << std::endl;
+    }
+    return complete;
+}
+
+void Renderer::deletePickTarget() {
+    if (m_pickFramebuffer) {
+        glDeleteFramebuffers(1, &m_pickFramebuffer);
+        m_pickFramebuffer = 0;
+    }
+    if (m_pickTexture) {
+        glDeleteTextures(1, &m_pickTexture);
+        m_pickTexture = 0;
+    }
+    if (m_pickDepth) {
+        glDeleteRenderbuffers(1, &m_pickDepth);
+        m_pickDepth = 0;
+    }
+    if (m_pickPixelBuffer) {
+        glDeleteBuffers(1, &m_pickPixelBuffer);
+        m_pickPixelBuffer = 0;
+    }
+    if (m_pickFence) {
+        glDeleteSync(m_pickFence);
+        m_pickFence = 0;
+    }
+    m_pickRequested = false;
+    m_pickInFlight = false;
+}
+
+bool Renderer::createRenderTargets() {
+    // Opaque scene: colour and the depth buffer both passes test against
+    glGenRenderbuffers(1, &m_sceneColor);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_sceneColor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_width, m_height);
+    glGenRenderbuffers(1, &m_sceneDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_sceneDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    
+    glGenFramebuffers(1, &m_sceneFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_sceneColor);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_sceneDepth);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    
+    // Transparent accumulation (rgb, revealage in alpha) and summed weights
+    GLuint* textures[] = { &m_oitAccumTexture, &m_oitWeightTexture };
+    GLint formats[] = { GL_RGBA16F, GL_R16F };
+    GLenum layouts[] = { GL_RGBA, GL_RED };
+    for (int i = 0; i < 2; i++) {
+        glGenTextures(1, textures[i]);
+        glBindTexture(GL_TEXTURE_2D, *textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, formats[i], m_width, m_height, 0, layouts[i], GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
     
-    // Update VBO
-    glBindBuffer(GL_ARRAY_BUFFER, m_textVBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    
-    // Set color
-    m_textShader->setUniform("textColor", color);
-    
-    // Set texture (use white texture or create solid color shader)
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_fontTexture);
+    glGenFramebuffers(1, &m_oitFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_oitFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_oitAccumTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_oitWeightTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_sceneDepth);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+    glGenVertexArrays(1, &m_compositeVAO);
+    if (!complete) {
+        std::cerr << "Transparency framebuffers are incomplete" << std::endl;
+    }
+    return complete && m_compositeShader && m_compositeShader->getProgram() != 0;
+}
+
+void Renderer::deleteRenderTargets() {
+    if (m_sceneFramebuffer) {
+        glDeleteFramebuffers(1, &m_sceneFramebuffer);
+        m_sceneFramebuffer = 0;
+    }
+    if (m_oitFramebuffer) {
+        glDeleteFramebuffers(1, &m_oitFramebuffer);
+        m_oitFramebuffer = 0;
+    }
+    GLuint* renderbuffers[] = { &m_sceneColor, &m_sceneDepth };
+    for (GLuint* renderbuffer : renderbuffers) {
+        if (*renderbuffer) {
+            glDeleteRenderbuffers(1, renderbuffer);
+            *renderbuffer = 0;
+        }
+    }
+    GLuint* textures[] = { &m_oitAccumTexture, &m_oitWeightTexture };
+    for (GLuint* texture : textures) {
+        if (*texture) {
+            glDeleteTextures(1, texture);
+            *texture = 0;
+        }
+    }
+    if (m_compositeVAO) {
+        glDeleteVertexArrays(1, &m_compositeVAO);
+        m_compositeVAO = 0;
+    }
+}
+
+void Renderer::renderText(const std::string& text, const glm::vec2& position, float scale, const glm::vec4& color) {
+    m_uiBatch.addText(text, position, scale, color);
+}
+
+void Renderer::renderRect(float x, float y, float width, float height, const glm::vec4& color) {
+    m_uiBatch.addRect(x, y, width, height, color);
+}
+
+void Renderer::renderLine(const glm::vec2& from, const glm::vec2& to, float width, const glm::vec4& color) {
+    m_uiBatch.addLine(from, to, width, color);
+}
+
+void Renderer::renderAttentionPanel(const AttentionHead* head, const glm::vec2& position, float size) {
+    AttentionTexture* texture = updateAttentionTexture(head);
+    if (!texture) return;
+    float extent = texture->getFilledExtent();
+    m_uiBatch.addHeatmap(texture->getTexture(), position.x, position.y, size, size,
+                         glm::vec2(0.0f), glm::vec2(extent), 1.0f);
+}
+
+void Renderer::renderAttentionMap(const AttentionHead* head, const glm::vec2& position, const glm::vec2& size,
+                                  const AttentionMapView& view) {
+    int sequenceLength = head->getSequenceLength();
+    if (sequenceLength == 0 || view.entriesPerPixel <= 0.0f) return;
+    
+    // Finest level whose samples are at least a pixel apart
+    int level = 0;
+    while ((1 << level) < view.entriesPerPixel && level < 20) {
+        level++;
+    }
+    float span = static_cast<float>(AttentionTileCache::kTileSize << level);
+    
+    // Visible entries as (key, query), clipped to the matrix
+    glm::vec2 origin(view.key, view.query);
+    glm::vec2 visibleMin = glm::max(origin, glm::vec2(0.0f));
+    glm::vec2 visibleMax = glm::min(origin + size * view.entriesPerPixel, glm::vec2(static_cast<float>(sequenceLength)));
+    if (visibleMin.x >= visibleMax.x || visibleMin.y >= visibleMax.y) return;
+    
+    int computeStart = m_attentionTiles.getComputeCount();
+    for (int row = static_cast<int>(visibleMin.y / span); row * span < visibleMax.y; row++) {
+        // Tiles right of the diagonal hold no weights
+        for (int column = static_cast<int>(visibleMin.x / span); column <= row && column * span < visibleMax.x; column++) {
+            bool compute = m_attentionTiles.getComputeCount() - computeStart < kMaxTilesComputedPerFrame;
+            GLuint texture = m_attentionTiles.getTile(head, level, row, column, compute);
+            glm::vec2 textureMin(column * span, row * span);
+            float textureSpan = span;
+            if (!texture) {
+                texture = m_attentionTiles.getTile(head, level + 1, row / 2, column / 2, false);
+                if (!texture) continue;
+                textureMin = glm::vec2((column / 2) * span * 2.0f, (row / 2) * span * 2.0f);
+                textureSpan = span * 2.0f;
+            }
+            
+            glm::vec2 tileMin = glm::max(glm::vec2(column * span, row * span), visibleMin);
+            glm::vec2 tileMax = glm::min(glm::vec2((column + 1) * span, (row + 1) * span), visibleMax);
+            glm::vec2 screenMin = position + (tileMin - origin) / view.entriesPerPixel;
+            glm::vec2 screenMax = position + (tileMax - origin) / view.entriesPerPixel;
+            m_uiBatch.addHeatmap(texture, screenMin.x, screenMin.y, screenMax.x - screenMin.x, screenMax.y - screenMin.y,
+                                 (tileMin - textureMin) / textureSpan, (tileMax - textureMin) / textureSpan, 1.0f);
+        }
+    }
+    m_renderStats.attentionTilesComputed += m_attentionTiles.getComputeCount() - computeStart;
+}
+
+void Renderer::flushUI() {
+    const std::vector<UIVertex>& vertices = m_uiBatch.getVertices();
+    m_renderStats.uiQuads = m_uiBatch.getQuadCount();
+    if (vertices.empty() || !m_uiShader) return;
+    
+    uploadStream(m_uiVBO, m_uiVertexCapacity, vertices.data(), vertices.size() * sizeof(UIVertex));
+    
+    // Known state in, known state out: no queries of what was enabled before
+    m_stateTracker.invalidate();
+    m_stateTracker.setDepthTest(false);
+    m_stateTracker.useProgram(m_uiShader->getProgram());
+    m_stateTracker.bindVertexArray(m_uiVAO);
+    
+    // Orthographic projection with inverted Y axis to match screen coordinates
+    glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(m_width), static_cast<float>(m_height), 0.0f);
+    m_uiShader->setUniform(m_uiProjectionLocation, projection);
+    
+    // Atlas quads in one draw per run between heatmaps, so call order holds
+    const std::vector<UIHeatmap>& heatmaps = m_uiBatch.getHeatmaps();
+    if (!heatmaps.empty() && m_uiHeatmapShader) {
+        m_stateTracker.useProgram(m_uiHeatmapShader->getProgram());
+        m_uiHeatmapShader->setUniform(m_uiHeatmapProjectionLocation, projection);
+        m_stateTracker.bindTexture(kColormapTextureUnit, m_colormapTexture);
+    }
+    GLint drawn = 0;
+    for (const UIHeatmap& heatmap : heatmaps) {
+        if (!m_uiHeatmapShader) break;
+        if (heatmap.firstVertex > drawn) {
+            m_stateTracker.useProgram(m_uiShader->getProgram());
+            m_stateTracker.bindTexture(0, m_fontTexture);
+            glDrawArrays(GL_TRIANGLES, drawn, heatmap.firstVertex - drawn);
+        }
+        m_stateTracker.useProgram(m_uiHeatmapShader->getProgram());
+        m_stateTracker.bindTexture(0, heatmap.texture);
+        glDrawArrays(GL_TRIANGLES, heatmap.firstVertex, 6);
+        drawn = heatmap.firstVertex + 6;
+    }
+    if (drawn < static_cast<GLint>(vertices.size())) {
+        m_stateTracker.useProgram(m_uiShader->getProgram());
+        m_stateTracker.bindTexture(0, m_fontTexture);
+        glDrawArrays(GL_TRIANGLES, drawn, static_cast<GLsizei>(vertices.size()) - drawn);
+    }
+    m_stateTracker.bindTexture(0, 0);
     
-    // Draw
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    m_stateTracker.bindVertexArray(0);
+    m_stateTracker.setDepthTest(true);
+    m_uiBatch.clear();
+}
+
+bool Renderer::projectToScreen(const glm::vec3& worldPos, glm::vec2& screenPos) const {
+    if (!m_camera) return false;
     
-    // Unbind
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    float aspectRatio = (float)m_width / (float)m_height;
+    glm::vec4 clip = m_camera->getProjectionMatrix(aspectRatio) * m_camera->getViewMatrix() * glm::vec4(worldPos, 1.0f);
+    if (clip.w <= 0.0f) return false;
     
-    // Restore state
-    if (depthTest) glEnable(GL_DEPTH_TEST);
+    screenPos.x = (clip.x / clip.w * 0.5f + 0.5f) * m_width;
+    screenPos.y = (1.0f - (clip.y / clip.w * 0.5f + 0.5f)) * m_height;
+    return true;
 }
 
 void Renderer::loadShaders() {
@@ -439,8 +1403,12 @@ void Renderer::loadShaders() {
             layout (location = 1) in vec3 aNormal;
             
             uniform mat4 model;
-            uniform mat4 view;
-            uniform mat4 projection;
+            layout (std140) uniform Camera {
+                mat4 projection;
+                mat4 view;
+                vec4 viewPos;
+                vec4 viewport;   // width, height
+            };
             
             out vec3 Normal;
             out vec3 FragPos;
@@ -458,9 +1426,7 @@ void Renderer::loadShaders() {
             in vec3 FragPos;
             
             uniform vec4 color;
-            
-            out vec4 FragColor;
-            
+        )" + kFragmentOutputs + R"(
             void main() {
                 // Simple lighting calculation
                 vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));
@@ -469,188 +1435,700 @@ void Renderer::loadShaders() {
                 vec3 ambient = vec3(0.3, 0.3, 0.3);
                 
                 vec3 result = (ambient + diffuse) * color.rgb;
-                FragColor = vec4(result, color.a);
+                writeColor(vec4(result, color.a));
             }
         )"
     )) {
         std::cerr << "Failed to load neuron shader" << std::endl;
     }
     
-    // Connection shader
-    m_connectionShader = std::make_unique<Shader>();
-    if (!m_connectionShader->loadFromSource(
-        // Vertex shader (same as neuron shader)
+    // Instanced neuron shader: per-instance centre/radius and color
+    m_neuronInstancedShader = std::make_unique<Shader>();
+    if (!m_neuronInstancedShader->loadFromSource(
+        // Vertex shader
         R"(
             #version 330 core
             layout (location = 0) in vec3 aPos;
             layout (location = 1) in vec3 aNormal;
+            layout (location = 3) in vec4 aPositionSize;
+            layout (location = 4) in vec4 aColor;
             
-            uniform mat4 model;
-            uniform mat4 view;
-            uniform mat4 projection;
+            layout (std140) uniform Camera {
+                mat4 projection;
+                mat4 view;
+                vec4 viewPos;
+                vec4 viewport;   // width, height
+            };
             
             out vec3 Normal;
-            out vec3 FragPos;
+            out vec4 Color;
+            flat out int Instance;
             
             void main() {
-                FragPos = vec3(model * vec4(aPos, 1.0));
-                Normal = mat3(transpose(inverse(model))) * aNormal;
-                gl_Position = projection * view * vec4(FragPos, 1.0);
+                // Uniform scale, so the mesh normal needs no correction
+                vec3 fragPos = aPositionSize.xyz + aPos * aPositionSize.w;
+                Normal = aNormal;
+                Color = aColor;
+                Instance = gl_InstanceID;
+                gl_Position = projection * view * vec4(fragPos, 1.0);
             }
         )",
         // Fragment shader
         R"(
             #version 330 core
             in vec3 Normal;
-            in vec3 FragPos;
+            in vec4 Color;
+            flat in int Instance;
+        )" + kFragmentOutputs + R"(
+            void main() {
+                // Same lighting as the neuron shader
+                vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));
+                float diff = max(dot(normalize(Normal), lightDir), 0.0);
+                vec3 diffuse = diff * vec3(1.0, 1.0, 1.0);
+                vec3 ambient = vec3(0.3, 0.3, 0.3);
+                
+                vec3 result = (ambient + diffuse) * Color.rgb;
+                writeColor(vec4(result, Color.a), Instance);
+            }
+        )"
+    )) {
+        std::cerr << "Failed to load instanced neuron shader" << std::endl;
+    }
+    
+    // Impostor neuron shader: a camera-facing quad per neuron, with the sphere
+    // ray-cast per fragment for exact silhouette, depth and lighting
+    m_neuronImpostorShader = std::make_unique<Shader>();
+    if (!m_neuronImpostorShader->loadFromSource(
+        // Vertex shader
+        R"(
+            #version 330 core
+            layout (location = 0) in vec3 aPos;
+            layout (location = 3) in vec4 aPositionSize;
+            layout (location = 4) in vec4 aColor;
             
-            uniform vec4 color;
+            layout (std140) uniform Camera {
+                mat4 projection;
+                mat4 view;
+                vec4 viewPos;
+                vec4 viewport;   // width, height
+            };
             
-            out vec4 FragColor;
+            out vec3 ViewPos;
+            flat out vec3 Center;
+            flat out float Radius;
+            flat out vec4 Color;
+            flat out int Instance;
             
             void main() {
-                // Simple lighting calculation
+                // Quad corners are +-1; the margin covers perspective stretch off-axis
+                Center = vec3(view * vec4(aPositionSize.xyz, 1.0));
+                Radius = aPositionSize.w;
+                Color = aColor;
+                Instance = gl_InstanceID;
+                ViewPos = Center + vec3(aPos.xy * Radius * 1.5, 0.0);
+                gl_Position = projection * vec4(ViewPos, 1.0);
+            }
+        )",
+        // Fragment shader
+        R"(
+            #version 330 core
+            in vec3 ViewPos;
+            flat in vec3 Center;
+            flat in float Radius;
+            flat in vec4 Color;
+            flat in int Instance;
+            
+            layout (std140) uniform Camera {
+                mat4 projection;
+                mat4 view;
+                vec4 viewPos;
+                vec4 viewport;   // width, height
+            };
+        )" + kFragmentOutputs + R"(
+            void main() {
+                // Eye ray through this fragment against the sphere, in view space
+                vec3 dir = normalize(ViewPos);
+                float b = dot(dir, Center);
+                float c = dot(Center, Center) - Radius * Radius;
+                float disc = b * b - c;
+                if (disc < 0.0) discard;
+                
+                vec3 hit = dir * (b - sqrt(disc));
+                vec4 clip = projection * vec4(hit, 1.0);
+                gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+                
+                // Same lighting as the mesh path, with the normal back in world space
+                vec3 normal = transpose(mat3(view)) * ((hit - Center) / Radius);
+                vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));
+                float diff = max(dot(normal, lightDir), 0.0);
+                vec3 diffuse = diff * vec3(1.0, 1.0, 1.0);
+                vec3 ambient = vec3(0.3, 0.3, 0.3);
+                
+                vec3 result = (ambient + diffuse) * Color.rgb;
+                writeColor(vec4(result, Color.a), Instance);
+            }
+        )"
+    )) {
+        std::cerr << "Failed to load impostor neuron shader" << std::endl;
+    }
+    
+    // Connection shader (instanced): builds each cylinder's frame from its endpoints
+    m_connectionShader = std::make_unique<Shader>();
+    if (!m_connectionShader->loadFromSource(
+        // Vertex shader
+        R"(
+            #version 330 core
+            layout (location = 0) in vec3 aPos;
+            layout (location = 1) in vec3 aNormal;
+            layout (location = 3) in vec4 aFromStrength;
+            layout (location = 4) in vec4 aToRadius;
+            layout (location = 5) in vec4 aColor;
+            
+            layout (std140) uniform Camera {
+                mat4 projection;
+                mat4 view;
+                vec4 viewPos;
+                vec4 viewport;   // width, height
+            };
+            uniform float minPixels;
+            
+            out vec3 Normal;
+            out vec4 Color;
+            
+            void main() {
+                vec3 axis = aToRadius.xyz - aFromStrength.xyz;
+                float len = max(length(axis), 0.0001);
+                vec3 dir = axis / len;
+                
+                // Any perpendicular pair completes the frame around the axis
+                vec3 helper = abs(dir.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+                vec3 side = normalize(cross(helper, dir));
+                vec3 up = cross(dir, side);
+                
+                // Keep at least minPixels of width so far edges become thin screen-space lines
+                vec3 midpoint = aFromStrength.xyz + axis * 0.5;
+                float depth = max(-(view * vec4(midpoint, 1.0)).z, 0.0001);
+                float pixelRadius = minPixels * depth / (projection[1][1] * viewport.y);
+                float radius = max(aToRadius.w, pixelRadius);
+                
+                // Unit cylinder spans y in [-0.5, 0.5]
+                vec3 worldPos = aFromStrength.xyz + dir * ((aPos.y + 0.5) * len)
+                              + (side * aPos.x + up * aPos.z) * radius;
+                Normal = side * aNormal.x + dir * aNormal.y + up * aNormal.z;
+                Color = vec4(aColor.rgb, aColor.a * clamp(aFromStrength.w, 0.0, 1.0));
+                gl_Position = projection * view * vec4(worldPos, 1.0);
+            }
+        )",
+        // Fragment shader
+        R"(
+            #version 330 core
+            in vec3 Normal;
+            in vec4 Color;
+        )" + kFragmentOutputs + R"(
+            void main() {
+                // Same lighting as the connection shader
                 vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));
                 float diff = max(dot(normalize(Normal), lightDir), 0.0);
                 vec3 diffuse = diff * vec3(1.0, 1.0, 1.0);
                 vec3 ambient = vec3(0.1, 0.1, 0.1);
                 
-                vec3 result = (ambient + diffuse) * color.rgb;
-                FragColor = vec4(result, color.a);
+                vec3 result = (ambient + diffuse) * Color.rgb;
+                writeColor(vec4(result, Color.a));
             }
         )"
     )) {
         std::cerr << "Failed to load connection shader" << std::endl;
     }
     
-    // Data flow shader
+    // Data-flow particles as instanced billboards, faded out at the edge and
+    // coloured by intensity through the hot half of the colormap
     m_dataFlowShader = std::make_unique<Shader>();
     if (!m_dataFlowShader->loadFromSource(
         // Vertex shader
         R"(
             #version 330 core
             layout (location = 0) in vec3 aPos;
+            layout (location = 3) in vec4 aPositionLife;
+            layout (location = 5) in vec4 aLaneIntensity;
+            
+            layout (std140) uniform Camera {
+                mat4 projection;
+                mat4 view;
+                vec4 viewPos;
+                vec4 viewport;   // width, height
+            };
+            uniform float particleSize;
+            
+            out vec2 Corner;
+            out float Intensity;
+            
+            void main() {
+                Corner = aPos.xy;
+                Intensity = aLaneIntensity.z;
+                if (aPositionLife.w <= 0.0) {
+                    // Dead: outside the clip volume
+                    gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+                    return;
+                }
+                float size = particleSize * (0.6 + 0.8 * Intensity);
+                vec4 center = view * vec4(aPositionLife.xyz, 1.0);
+                gl_Position = projection * (center + vec4(aPos.xy * size, 0.0, 0.0));
+            }
+        )",
+        // Fragment shader
+        R"(
+            #version 330 core
+            in vec2 Corner;
+            in float Intensity;
+            
+            uniform sampler2D colormap;
+        )" + kFragmentOutputs + R"(
+            void main() {
+                float falloff = 1.0 - dot(Corner, Corner);
+                if (falloff <= 0.0) discard;
+                vec3 color = texture(colormap, vec2(0.5 + 0.5 * Intensity, 0.5)).rgb;
+                writeColor(vec4(color, falloff * falloff));
+            }
+        )"
+    )) {
+        std::cerr << "Failed to load data flow shader" << std::endl;
+    }
+    
+    // Data-flow particle step, run with rasterization off; the outputs are
+    // captured by transform feedback into the other particle buffer
+    m_particleUpdateShader = std::make_unique<Shader>();
+    if (!m_particleUpdateShader->loadFromSource(
+        // Vertex shader
+        R"(
+            #version 330 core
+            layout (location = 0) in vec4 aPositionLife;
+            layout (location = 1) in vec4 aVelocityTarget;
+            layout (location = 2) in vec4 aLaneIntensity;
+            
+            uniform vec4 nodes[32];         // xyz = centre, w = cumulative spawn weight
+            uniform vec4 nodeExtents[32];   // xy = half extent, z = intensity
+            uniform int nodeCount;
+            uniform float deltaTime;
+            uniform float spawnChance;
+            uniform float speed;
+            uniform int seed;
+            
+            out vec4 outPositionLife;
+            out vec4 outVelocityTarget;
+            out vec4 outLaneIntensity;
+            
+            uint state;
+            
+            // PCG hash of the particle and frame, in [0, 1)
+            float random() {
+                state = state * 747796405u + 2891336453u;
+                uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+                return float((word >> 22u) ^ word) * (1.0 / 4294967296.0);
+            }
+            
+            vec3 getLanePoint(int node, vec2 lane) {
+                return nodes[node].xyz + vec3(lane * nodeExtents[node].xy, 0.0);
+            }
+            
+            void main() {
+                state = uint(gl_VertexID) * 1973u + uint(seed) * 9277u;
+                random();
+                
+                vec3 position = aPositionLife.xyz;
+                float life = aPositionLife.w;
+                vec3 velocity = aVelocityTarget.xyz;
+                int target = int(aVelocityTarget.w);
+                vec4 lane = aLaneIntensity;
+                
+                if (life <= 0.0 || target < 1 || target >= nodeCount) {
+                    // Respawn at a node drawn from the spawn weights
+                    life = 0.0;
+                    if (random() < spawnChance) {
+                        float u = random();
+                        int node = 0;
+                        while (node < nodeCount - 2 && nodes[node].w <= u) {
+                            node++;
+                        }
+                        lane = vec4(random() * 2.0 - 1.0, random() * 2.0 - 1.0, nodeExtents[node].z, 0.75 + 0.5 * random());
+                        target = node + 1;
+                        position = getLanePoint(node, lane.xy);
+                        velocity = normalize(getLanePoint(target, lane.xy) - position) * speed * lane.w;
+                        life = 60.0;
+                    }
+                } else {
+                    // Steer toward the same lane on the target node
+                    vec3 toGoal = getLanePoint(target, lane.xy) - position;
+                    float remaining = length(toGoal);
+                    vec3 desired = remaining > 1e-4 ? toGoal / remaining * speed * lane.w : velocity;
+                    velocity = mix(desired, velocity, exp(-4.0 * deltaTime));
+                    position += velocity * deltaTime;
+                    life -= deltaTime;
+                    
+                    // Past the target's plane: on to the next node, picking up its intensity
+                    vec3 axis = nodes[target].xyz - nodes[target - 1].xyz;
+                    if (dot(position - nodes[target].xyz, axis) >= 0.0) {
+                        lane.z = mix(lane.z, nodeExtents[target].z, 0.5);
+                        target++;
+                        if (target >= nodeCount) life = 0.0;
+                    }
+                }
+                
+                outPositionLife = vec4(position, life);
+                outVelocityTarget = vec4(velocity, float(target));
+                outLaneIntensity = lane;
+            }
+        )",
+        // Fragment shader (never runs)
+        R"(
+            #version 330 core
+            out vec4 FragColor;
+            
+            void main() {
+                FragColor = vec4(0.0);
+            }
+        )",
+        { "outPositionLife", "outVelocityTarget", "outLaneIntensity" }
+    )) {
+        std::cerr << "Failed to load particle update shader" << std::endl;
+    }
+    
+    // Activation heatmap: one texel per neuron, mapped through the colormap LUT
+    m_heatmapShader = std::make_unique<Shader>();
+    if (!m_heatmapShader->loadFromSource(
+        // Vertex shader
+        R"(
+            #version 330 core
+            layout (location = 0) in vec3 aPos;
+            layout (location = 2) in vec2 aTexCoord;
             
             uniform mat4 model;
-            uniform mat4 view;
-            uniform mat4 projection;
-            uniform float progress;
+            uniform vec4 texRect;   // offset, scale
+            layout (std140) uniform Camera {
+                mat4 projection;
+                mat4 view;
+                vec4 viewPos;
+                vec4 viewport;   // width, height
+            };
             
-            out float Progress;
+            out vec2 TexCoord;
             
             void main() {
+                TexCoord = texRect.xy + aTexCoord * texRect.zw;
                 gl_Position = projection * view * model * vec4(aPos, 1.0);
-                Progress = progress;
             }
         )",
         // Fragment shader
         R"(
             #version 330 core
-            in float Progress;
+            in vec2 TexCoord;
             
+            uniform sampler2D activations;
+            uniform sampler2D colormap;
+            uniform float valueRange;
             uniform vec4 color;
+        )" + kFragmentOutputs + R"(
+            void main() {
+                // Diverging map: zero in the middle, +-valueRange at the ends
+                float value = texture(activations, TexCoord).r;
+                float t = clamp(0.5 + 0.5 * value / valueRange, 0.0, 1.0);
+                writeColor(vec4(texture(colormap, vec2(t, 0.5)).rgb * color.rgb, color.a));
+            }
+        )"
+    )) {
+        std::cerr << "Failed to load heatmap shader" << std::endl;
+    }
+    
+    // 2D overlay shader: SDF text, and solid shapes through the atlas' solid cell
+    m_uiShader = std::make_unique<Shader>();
+    if (!m_uiShader->loadFromSource(
+        // Vertex shader
+        R"(
+            #version 330 core
+            layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+            layout (location = 1) in vec4 aColor;
+            
+            uniform mat4 projection;
+            
+            out vec2 TexCoords;
+            out vec4 Color;
+            
+            void main() {
+                gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
+                TexCoords = vertex.zw;
+                Color = aColor;
+            }
+        )",
+        // Fragment shader
+        R"(
+            #version 330 core
+            in vec2 TexCoords;
+            in vec4 Color;
+            
+            uniform sampler2D glyphAtlas;
             
             out vec4 FragColor;
             
             void main() {
-                // Pulsating effect based on progress
-                float pulse = (sin(Progress * 10.0) + 1.0) * 0.5;
-                vec3 glowColor = color.rgb * (0.5 + 0.5 * pulse);
-                FragColor = vec4(glowColor, color.a);
+                // Signed distance atlas: the outline is at 0.5, antialiased over one screen pixel
+                float distance = texture(glyphAtlas, TexCoords).r;
+                float width = max(fwidth(distance) * 0.5, 0.001);
+                float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+                FragColor = vec4(Color.rgb, Color.a * alpha);
             }
         )"
     )) {
-        std::cerr << "Failed to load data flow shader" << std::endl;
+        std::cerr << "Failed to load UI shader" << std::endl;
     }
     
-    // Text shader
-    m_textShader = std::make_unique<Shader>();
-    if (!m_textShader->loadFromSource(
+    // Overlay heatmaps: UI quads whose texture goes through the colormap
+    m_uiHeatmapShader = std::make_unique<Shader>();
+    if (!m_uiHeatmapShader->loadFromSource(
         // Vertex shader
         R"(
             #version 330 core
             layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+            layout (location = 1) in vec4 aColor;
             
             uniform mat4 projection;
             
             out vec2 TexCoords;
+            out vec4 Color;
             
             void main() {
                 gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
                 TexCoords = vertex.zw;
+                Color = aColor;
             }
         )",
         // Fragment shader
         R"(
             #version 330 core
             in vec2 TexCoords;
+            in vec4 Color;
             
-            uniform sampler2D text;
-            uniform vec4 textColor;
+            uniform sampler2D values;
+            uniform sampler2D colormap;
+            
+            out vec4 FragColor;
+            
+            void main() {
+                // Values in [0, 1] run from the neutral middle of the map to its hot end
+                float t = clamp(0.5 + 0.5 * texture(values, TexCoords).r, 0.0, 1.0);
+                FragColor = vec4(texture(colormap, vec2(t, 0.5)).rgb * Color.rgb, Color.a);
+            }
+        )"
+    )) {
+        std::cerr << "Failed to load UI heatmap shader" << std::endl;
+    }
+    
+    // Resolve of the weighted transparent pass over the opaque scene, from
+    // a full-screen triangle made from the vertex index
+    m_compositeShader = std::make_unique<Shader>();
+    if (!m_compositeShader->loadFromSource(
+        // Vertex shader
+        R"(
+            #version 330 core
+            void main() {
+                vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+                gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+            }
+        )",
+        // Fragment shader
+        R"(
+            #version 330 core
+            uniform sampler2D accumulation;
+            uniform sampler2D weights;
             
             out vec4 FragColor;
             
             void main() {
-                vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-                FragColor = textColor * sampled;
+                ivec2 texel = ivec2(gl_FragCoord.xy);
+                vec4 accum = texelFetch(accumulation, texel, 0);
+                float revealage = accum.a;
+                if (revealage >= 1.0) discard;
+                float weight = texelFetch(weights, texel, 0).r;
+                FragColor = vec4(accum.rgb / clamp(weight, 1e-4, 5e4), 1.0 - revealage);
             }
         )"
     )) {
-        std::cerr << "Failed to load text shader" << std::endl;
+        std::cerr << "Failed to load composite shader" << std::endl;
+    }
+    
+    // Per-frame camera block, bound once and shared by every 3D program
+    glGenBuffers(1, &m_cameraUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_cameraUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, kCameraBlockBinding, m_cameraUBO);
+    
+    Shader* cameraShaders[] = {
+        m_neuronShader.get(), m_neuronInstancedShader.get(), m_neuronImpostorShader.get(),
+        m_connectionShader.get(), m_dataFlowShader.get(), m_heatmapShader.get()
+    };
+    for (Shader* shader : cameraShaders) {
+        shader->bindUniformBlock("Camera", kCameraBlockBinding);
     }
+    
+    // Constants set once
+    m_connectionShader->use();
+    m_connectionShader->setUniform("minPixels", kMinConnectionPixels);
+    m_heatmapShader->use();
+    m_heatmapShader->setUniform("activations", 0);
+    m_heatmapShader->setUniform("colormap", static_cast<int>(kColormapTextureUnit));
+    m_uiHeatmapShader->use();
+    m_uiHeatmapShader->setUniform("values", 0);
+    m_uiHeatmapShader->setUniform("colormap", static_cast<int>(kColormapTextureUnit));
+    m_dataFlowShader->use();
+    m_dataFlowShader->setUniform("particleSize", kParticleSize);
+    m_dataFlowShader->setUniform("colormap", static_cast<int>(kColormapTextureUnit));
+    m_particleUpdateShader->use();
+    m_particleUpdateShader->setUniform("speed", kParticleSpeed);
+    m_compositeShader->use();
+    m_compositeShader->setUniform("accumulation", static_cast<int>(kAccumulationTextureUnit));
+    m_compositeShader->setUniform("weights", static_cast<int>(kWeightTextureUnit));
+    
+    // Queue programs with the handles of their per-draw uniforms
+    m_neuronProgram = { m_neuronShader.get(), 0, m_neuronShader->getUniformLocation("model"),
+                        m_neuronShader->getUniformLocation("color"), -1, -1, -1,
+                        m_neuronShader->getUniformLocation("pickId") };
+    m_neuronInstancedProgram = { m_neuronInstancedShader.get(), 1, -1, -1, -1, -1, -1,
+                                 m_neuronInstancedShader->getUniformLocation("pickId") };
+    m_neuronImpostorProgram = { m_neuronImpostorShader.get(), 2, -1, -1, -1, -1, -1,
+                                m_neuronImpostorShader->getUniformLocation("pickId") };
+    m_connectionProgram = { m_connectionShader.get(), 3, -1, -1, -1, -1, -1, -1 };
+    m_dataFlowProgram = { m_dataFlowShader.get(), 4, -1, -1, -1, -1, -1, -1 };
+    m_heatmapProgram = { m_heatmapShader.get(), 5, m_heatmapShader->getUniformLocation("model"),
+                         m_heatmapShader->getUniformLocation("color"), -1, m_heatmapShader->getUniformLocation("valueRange"),
+                         m_heatmapShader->getUniformLocation("texRect"), m_heatmapShader->getUniformLocation("pickId") };
+    m_uiProjectionLocation = m_uiShader->getUniformLocation("projection");
+    m_uiHeatmapProjectionLocation = m_uiHeatmapShader->getUniformLocation("projection");
 }
 
 void Renderer::createMeshes() {
     // Create sphere mesh
     m_sphereMesh = std::make_unique<Mesh>();
-    m_sphereMesh->createSphere(1.0f, 16);
+    m_sphereMesh->createSphereLods(1.0f, std::vector<int>(std::begin(kSphereLodSubdivisions), std::end(kSphereLodSubdivisions)));
+    
+    // Per-instance stream for the instanced neuron pass
+    glGenBuffers(1, &m_neuronInstanceVBO);
+    m_sphereMesh->addInstanceAttribute(m_neuronInstanceVBO, 3, 4, sizeof(NeuronInstance), offsetof(NeuronInstance, positionSize));
+    m_sphereMesh->addInstanceAttribute(m_neuronInstanceVBO, 4, 4, sizeof(NeuronInstance), offsetof(NeuronInstance, color));
     
     // Create cylinder mesh
     m_cylinderMesh = std::make_unique<Mesh>();
-    m_cylinderMesh->createCylinder(1.0f, 1.0f, 16);
+    m_cylinderMesh->createCylinderLods(1.0f, 1.0f, std::vector<int>(std::begin(kCylinderLodSubdivisions), std::end(kCylinderLodSubdivisions)));
+    
+    // Per-instance stream for the instanced connection pass
+    glGenBuffers(1, &m_connectionInstanceVBO);
+    m_cylinderMesh->addInstanceAttribute(m_connectionInstanceVBO, 3, 4, sizeof(ConnectionInstance), offsetof(ConnectionInstance, fromStrength));
+    m_cylinderMesh->addInstanceAttribute(m_connectionInstanceVBO, 4, 4, sizeof(ConnectionInstance), offsetof(ConnectionInstance, toRadius));
+    m_cylinderMesh->addInstanceAttribute(m_connectionInstanceVBO, 5, 4, sizeof(ConnectionInstance), offsetof(ConnectionInstance, color));
     
     // Create quad mesh
     m_quadMesh = std::make_unique<Mesh>();
     m_quadMesh->createQuad(1.0f, 1.0f);
     
-    // Create VBO for text rendering
-    glGenBuffers(1, &m_textVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_textVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-    
-    // Setup VAO for text rendering
-    glGenVertexArrays(1, &m_textVAO);
-    glBindVertexArray(m_textVAO);
+    // Impostor quad with corners at +-1, fed from its own instance stream
+    m_impostorMesh = std::make_unique<Mesh>();
+    m_impostorMesh->createQuad(2.0f, 2.0f);
+    glGenBuffers(1, &m_impostorInstanceVBO);
+    m_impostorMesh->addInstanceAttribute(m_impostorInstanceVBO, 3, 4, sizeof(NeuronInstance), offsetof(NeuronInstance, positionSize));
+    m_impostorMesh->addInstanceAttribute(m_impostorInstanceVBO, 4, 4, sizeof(NeuronInstance), offsetof(NeuronInstance, color));
+    
+    // Baked instances: positions from one buffer, colours from another
+    m_staticNeurons = std::make_unique<StaticInstanceBuffer>(1);
+    m_staticNeurons->createBuffers();
+    m_staticConnections = std::make_unique<StaticInstanceBuffer>(2);
+    m_staticConnections->createBuffers();
+    
+    m_staticSphereMesh = std::make_unique<Mesh>();
+    m_staticSphereMesh->createSphereLods(1.0f, std::vector<int>(std::begin(kSphereLodSubdivisions), std::end(kSphereLodSubdivisions)));
+    m_staticSphereMesh->addInstanceAttribute(m_staticNeurons->getGeometryBuffer(), 3, 4, sizeof(glm::vec4), 0);
+    m_staticSphereMesh->addInstanceAttribute(m_staticNeurons->getColorBuffer(), 4, 4, sizeof(glm::vec4), 0);
+    
+    m_staticImpostorMesh = std::make_unique<Mesh>();
+    m_staticImpostorMesh->createQuad(2.0f, 2.0f);
+    m_staticImpostorMesh->addInstanceAttribute(m_staticNeurons->getGeometryBuffer(), 3, 4, sizeof(glm::vec4), 0);
+    m_staticImpostorMesh->addInstanceAttribute(m_staticNeurons->getColorBuffer(), 4, 4, sizeof(glm::vec4), 0);
+    
+    m_staticCylinderMesh = std::make_unique<Mesh>();
+    m_staticCylinderMesh->createCylinderLods(1.0f, 1.0f, std::vector<int>(std::begin(kCylinderLodSubdivisions), std::end(kCylinderLodSubdivisions)));
+    m_staticCylinderMesh->addInstanceAttribute(m_staticConnections->getGeometryBuffer(), 3, 4, 2 * sizeof(glm::vec4), 0);
+    m_staticCylinderMesh->addInstanceAttribute(m_staticConnections->getGeometryBuffer(), 4, 4, 2 * sizeof(glm::vec4), sizeof(glm::vec4));
+    m_staticCylinderMesh->addInstanceAttribute(m_staticConnections->getColorBuffer(), 5, 4, sizeof(glm::vec4), 0);
+    
+    // Stream buffer of the 2D overlay, sized on first use
+    glGenBuffers(1, &m_uiVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_uiVBO);
+    
+    // Setup VAO for the 2D overlay
+    glGenVertexArrays(1, &m_uiVAO);
+    glBindVertexArray(m_uiVAO);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(UIVertex), (void*)offsetof(UIVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(UIVertex), (void*)offsetof(UIVertex, color));
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 }
 
 void Renderer::loadFonts() {
-    // In a real implementation, this would load a font texture
-    // For simplicity, create a basic font texture with a single color
+    // Bake the SDF glyph atlas once; text at any scale samples the same texture
+    m_glyphAtlas.build();
+    
     glGenTextures(1, &m_fontTexture);
     glBindTexture(GL_TEXTURE_2D, m_fontTexture);
     
-    // Create a simple white texture (single color)
-    const int texSize = 64;
-    unsigned char data[texSize * texSize];
-    for (int i = 0; i < texSize * texSize; i++) {
-        data[i] = 255; // White
-    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, m_glyphAtlas.getWidth(), m_glyphAtlas.getHeight(), 0, GL_RED, GL_UNSIGNED_BYTE,
+                 m_glyphAtlas.getPixels().data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, texSize, texSize, 0, GL_RED, GL_UNSIGNED_BYTE, data);
+    // A few mip levels keep small labels from shimmering; deeper ones would
+    // blend neighbouring cells past the spread padding
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 2);
     
     // Set texture parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void Renderer::createColormap() {
+    // Diverging blue - light grey - red, interpolated between three stops
+    const glm::vec3 negative(0.23f, 0.30f, 0.75f);
+    const glm::vec3 zero(0.87f, 0.87f, 0.87f);
+    const glm::vec3 positive(0.71f, 0.02f, 0.15f);
+    
+    unsigned char data[kColormapSize * 3];
+    for (int i = 0; i < kColormapSize; i++) {
+        float t = static_cast<float>(i) / (kColormapSize - 1) * 2.0f - 1.0f;
+        glm::vec3 color = t < 0.0f ? glm::mix(zero, negative, -t) : glm::mix(zero, positive, t);
+        for (int c = 0; c < 3; c++) {
+            data[i * 3 + c] = static_cast<unsigned char>(color[c] * 255.0f + 0.5f);
+        }
+    }
+    
+    glGenTextures(1, &m_colormapTexture);
+    glBindTexture(GL_TEXTURE_2D, m_colormapTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, kColormapSize, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 void Renderer::setCamera(Camera* camera) { m_camera = camera; }
 
+glm::vec3 Renderer::getCameraPosition() const {
+    return m_camera ? m_camera->getPosition() : glm::vec3(0.0f);
+}
+
 } // namespace llmvis 
\ No newline at end of file
@@ -0,0 +1,481 @@
+#include "ResidualIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <queue>
+
+namespace llmvis {
+
+namespace {
+
+const char kResidualMagic[8] = { 'L', 'L', 'M', 'V', 'H', 'N', 'S', 'W' };
+const uint32_t kResidualVersion = 1;
+// Sanity bound on M read back from a file; add() never uses more than a few dozen
+const int32_t kMaxStoredConnections = 1024;
+
+template <typename T>
+void writeValue(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::istream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+template <typename T>
+void writeVector(std::ostream& out, const std::vector<T>& values) {
+    writeValue(out, static_cast<uint64_t>(values.size()));
+    out.write(reinterpret_cast<const char*>(values.data()), sizeof(T) * values.size());
+}
+
+// streamSize bounds the count: more entries than the rest of the stream can
+// hold is corruption, not something to allocate for
+template <typename T>
+bool readVector(std::istream& in, std::vector<T>& values, uint64_t streamSize) {
+    uint64_t count = 0;
+    if (!readValue(in, count)) return false;
+    std::streamoff position = in.tellg();
+    if (position < 0 || static_cast<uint64_t>(position) > streamSize ||
+        count > (streamSize - static_cast<uint64_t>(position)) / sizeof(T)) {
+        return false;
+    }
+    values.resize(count);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(values.data()), sizeof(T) * count));
+}
+
+} // namespace
+
+HnswGraph::HnswGraph(int dimensions, int maxConnections, int efConstruction)
+    : m_dimensions(dimensions)
+    , m_maxConnections(std::max(2, maxConnections))
+    , m_maxConnectionsLevel0(std::max(2, maxConnections) * 2)
+    , m_efConstruction(std::max(efConstruction, maxConnections))
+    , m_levelMultiplier(1.0 / std::log(static_cast<double>(std::max(2, maxConnections))))
+    , m_entryPoint(0)
+    , m_maxLevel(-1)
+    , m_rng(42)
+    , m_visitTag(0)
+{
+}
+
+HnswGraph::~HnswGraph() {
+}
+
+float HnswGraph::distance(const float* a, const float* b) const {
+    // Independent accumulators let the compiler keep several lanes in flight
+    float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+    int i = 0;
+    for (; i + 4 <= m_dimensions; i += 4) {
+        float d0 = a[i] - b[i];
+        float d1 = a[i + 1] - b[i + 1];
+        float d2 = a[i + 2] - b[i + 2];
+        float d3 = a[i + 3] - b[i + 3];
+        sum0 += d0 * d0;
+        sum1 += d1 * d1;
+        sum2 += d2 * d2;
+        sum3 += d3 * d3;
+    }
+    for (; i < m_dimensions; ++i) {
+        float d = a[i] - b[i];
+        sum0 += d * d;
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+uint32_t* HnswGraph::linksAt(uint32_t id, int level) {
+    if (level == 0) {
+        return &m_level0Links[size_t(id) * (m_maxConnectionsLevel0 + 1)];
+    }
+    return &m_upperLinks[id][size_t(level - 1) * (m_maxConnections + 1)];
+}
+
+const uint32_t* HnswGraph::linksAt(uint32_t id, int level) const {
+    return const_cast<HnswGraph*>(this)->linksAt(id, level);
+}
+
+int HnswGraph::randomLevel() {
+    std::uniform_real_distribution<double> dis(0.0, 1.0);
+    double r = std::max(dis(m_rng), 1e-12);
+    return static_cast<int>(-std::log(r) * m_levelMultiplier);
+}
+
+uint32_t HnswGraph::greedyDescend(const float* query, uint32_t entry, int fromLevel, int toLevel) const {
+    uint32_t current = entry;
+    float currentDistance = distance(query, vectorAt(current));
+
+    for (int level = fromLevel; level > toLevel; --level) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            const uint32_t* links = linksAt(current, level);
+            for (uint32_t i = 1; i <= links[0]; ++i) {
+                float d = distance(query, vectorAt(links[i]));
+                if (d < currentDistance) {
+                    currentDistance = d;
+                    current = links[i];
+                    changed = true;
+                }
+            }
+        }
+    }
+    return current;
+}
+
+std::vector<HnswGraph::DistanceId> HnswGraph::searchLevel(const float* query, uint32_t entry, int ef, int level) const {
+    // Tag-based visited set: bumping the tag clears it without touching memory
+    if (m_visited.size() < m_labels.size()) {
+        m_visited.resize(m_labels.size(), 0);
+    }
+    if (++m_visitTag == 0) {
+        std::fill(m_visited.begin(), m_visited.end(), 0);
+        m_visitTag = 1;
+    }
+
+    std::priority_queue<DistanceId, std::vector<DistanceId>, std::greater<DistanceId>> candidates;
+    std::priority_queue<DistanceId> results;
+
+    float entryDistance = distance(query, vectorAt(entry));
+    candidates.emplace(entryDistance, entry);
+    results.emplace(entryDistance, entry);
+    m_visited[entry] = m_visitTag;
+
+    while (!candidates.empty()) {
+        DistanceId current = candidates.top();
+        if (current.first > results.top().first && static_cast<int>(results.size()) >= ef) {
+            break;
+        }
+        candidates.pop();
+
+        const uint32_t* links = linksAt(current.second, level);
+        for (uint32_t i = 1; i <= links[0]; ++i) {
+            uint32_t neighbor = links[i];
+            if (m_visited[neighbor] == m_visitTag) continue;
+            m_visited[neighbor] = m_visitTag;
+
+            float d = distance(query, vectorAt(neighbor));
+            if (static_cast<int>(results.size()) < ef || d < results.top().first) {
+                candidates.emplace(d, neighbor);
+                results.emplace(d, neighbor);
+                if (static_cast<int>(results.size()) > ef) {
+                    results.pop();
+                }
+            }
+        }
+    }
+
+    std::vector<DistanceId> sorted(results.size());
+    for (size_t i = sorted.size(); i-- > 0;) {
+        sorted[i] = results.top();
+        results.pop();
+    }
+    return sorted;
+}
+
+std::vector<uint32_t> HnswGraph::selectNeighbors(const std::vector<DistanceId>& candidates, int maxCount) const {
+    // Keep a candidate only if it is closer to the new point than to any
+    // already-kept neighbour; this spreads links across directions
+    std::vector<uint32_t> selected;
+    for (const DistanceId& candidate : candidates) {
+        if (static_cast<int>(selected.size()) >= maxCount) break;
+
+        bool keep = true;
+        for (uint32_t other : selected) {
+            if (distance(vectorAt(candidate.second), vectorAt(other)) < candidate.first) {
+                keep = false;
+                break;
+            }
+        }
+        if (keep) {
+            selected.push_back(candidate.second);
+        }
+    }
+    return selected;
+}
+
+void HnswGraph::connect(uint32_t from, uint32_t to, int level) {
+    uint32_t* links = linksAt(from, level);
+    int capacity = maxLinks(level);
+
+    if (static_cast<int>(links[0]) < capacity) {
+        links[++links[0]] = to;
+        return;
+    }
+
+    // Full: re-run the selection heuristic over the existing links plus the new one
+    std::vector<DistanceId> candidates;
+    candidates.reserve(capacity + 1);
+    const float* origin = vectorAt(from);
+    for (uint32_t i = 1; i <= links[0]; ++i) {
+        candidates.emplace_back(distance(origin, vectorAt(links[i])), links[i]);
+    }
+    candidates.emplace_back(distance(origin, vectorAt(to)), to);
+    std::sort(candidates.begin(), candidates.end());
+
+    std::vector<uint32_t> kept = selectNeighbors(candidates, capacity);
+    links[0] = static_cast<uint32_t>(kept.size());
+    std::copy(kept.begin(), kept.end(), links + 1);
+}
+
+void HnswGraph::add(const float* vector, uint64_t label) {
+    uint32_t id = static_cast<uint32_t>(m_labels.size());
+    int level = randomLevel();
+
+    m_vectors.insert(m_vectors.end(), vector, vector + m_dimensions);
+    m_labels.push_back(label);
+    m_levels.push_back(level);
+    m_level0Links.resize(m_level0Links.size() + m_maxConnectionsLevel0 + 1, 0);
+    m_upperLinks.emplace_back(size_t(level) * (m_maxConnections + 1), 0);
+
+    if (id == 0) {
+        m_entryPoint = 0;
+        m_maxLevel = level;
+        return;
+    }
+
+    uint32_t entry = greedyDescend(vector, m_entryPoint, m_maxLevel, level);
+
+    for (int l = std::min(level, m_maxLevel); l >= 0; --l) {
+        std::vector<DistanceId> candidates = searchLevel(vector, entry, m_efConstruction, l);
+        std::vector<uint32_t> neighbors = selectNeighbors(candidates, m_maxConnections);
+
+        uint32_t* links = linksAt(id, l);
+        links[0] = static_cast<uint32_t>(neighbors.size());
+        std::copy(neighbors.begin(), neighbors.end(), links + 1);
+
+        for (uint32_t neighbor : neighbors) {
+            connect(neighbor, id, l);
+        }
+        entry = candidates.front().second;
+    }
+
+    if (level > m_maxLevel) {
+        m_maxLevel = level;
+        m_entryPoint = id;
+    }
+}
+
+std::vector<Neighbor> HnswGraph::search(const float* query, int k, int ef) const {
+    std::vector<Neighbor> neighbors;
+    if (m_labels.empty() || k <= 0) {
+        return neighbors;
+    }
+
+    uint32_t entry = greedyDescend(query, m_entryPoint, m_maxLevel, 0);
+    std::vector<DistanceId> results = searchLevel(query, entry, std::max(ef, k), 0);
+
+    size_t count = std::min(results.size(), static_cast<size_t>(k));
+    for (size_t i = 0; i < count; ++i) {
+        neighbors.push_back({ results[i].first, m_labels[results[i].second] });
+    }
+    return neighbors;
+}
+
+void HnswGraph::write(std::ostream& out) const {
+    writeValue(out, static_cast<int32_t>(m_dimensions));
+    writeValue(out, static_cast<int32_t>(m_maxConnections));
+    writeValue(out, static_cast<int32_t>(m_efConstruction));
+    writeValue(out, m_entryPoint);
+    writeValue(out, static_cast<int32_t>(m_maxLevel));
+    writeVector(out, m_vectors);
+    writeVector(out, m_labels);
+    writeVector(out, m_levels);
+    writeVector(out, m_level0Links);
+    for (const auto& links : m_upperLinks) {
+        writeVector(out, links);
+    }
+}
+
+bool HnswGraph::read(std::istream& in, uint64_t streamSize) {
+    int32_t dimensions, maxConnections, efConstruction, maxLevel;
+    uint32_t entryPoint;
+    if (!readValue(in, dimensions) || !readValue(in, maxConnections) || !readValue(in, efConstruction) ||
+        !readValue(in, entryPoint) || !readValue(in, maxLevel)) {
+        return false;
+    }
+    if (dimensions <= 0 || maxConnections < 2 || maxConnections > kMaxStoredConnections || efConstruction <= 0) {
+        return false;
+    }
+
+    *this = HnswGraph(dimensions, maxConnections, efConstruction);
+    m_entryPoint = entryPoint;
+    m_maxLevel = maxLevel;
+
+    if (!readVector(in, m_vectors, streamSize) || !readVector(in, m_labels, streamSize) ||
+        !readVector(in, m_levels, streamSize) || !readVector(in, m_level0Links, streamSize)) {
+        return false;
+    }
+
+    size_t count = m_labels.size();
+    if (m_vectors.size() / m_dimensions != count || m_vectors.size() % m_dimensions != 0 || m_levels.size() != count ||
+        m_level0Links.size() != count * (m_maxConnectionsLevel0 + 1)) {
+        return false;
+    }
+
+    m_upperLinks.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (m_levels[i] < 0 || m_levels[i] > m_maxLevel || !readVector(in, m_upperLinks[i], streamSize) ||
+            m_upperLinks[i].size() != size_t(m_levels[i]) * (m_maxConnections + 1)) {
+            return false;
+        }
+    }
+
+    // Search follows these links and the entry point without checking them
+    if (count == 0) {
+        return m_maxLevel == -1;
+    }
+    if (m_entryPoint >= count || m_levels[m_entryPoint] != m_maxLevel) {
+        return false;
+    }
+    for (uint32_t id = 0; id < count; ++id) {
+        for (int level = 0; level <= m_levels[id]; ++level) {
+            const uint32_t* links = linksAt(id, level);
+            if (static_cast<int64_t>(links[0]) > maxLinks(level)) return false;
+            for (uint32_t i = 1; i <= links[0]; ++i) {
+                if (links[i] >= count) return false;
+            }
+        }
+    }
+
+    // Keep generating fresh levels rather than replaying the same sequence
+    m_rng.seed(static_cast<unsigned int>(m_labels.size()) + 42);
+    return true;
+}
+
+ResidualIndex::ResidualIndex(int layerCount)
+    : m_layers(layerCount)
+    , m_modified(false)
+{
+}
+
+ResidualIndex::~ResidualIndex() {
+}
+
+uint32_t ResidualIndex::beginTrace(const std::string& prompt) {
+    m_traces.push_back(prompt);
+    m_modified = true;
+    return static_cast<uint32_t>(m_traces.size() - 1);
+}
+
+void ResidualIndex::record(int layerIndex, const std::vector<float>& residual, uint64_t label) {
+    if (layerIndex < 0 || layerIndex >= static_cast<int>(m_layers.size()) || residual.empty()) {
+        return;
+    }
+
+    auto& graph = m_layers[layerIndex];
+    if (!graph) {
+        graph = std::make_unique<HnswGraph>(static_cast<int>(residual.size()));
+    } else if (graph->getDimensions() != static_cast<int>(residual.size())) {
+        std::cerr << "Residual size mismatch in layer " << layerIndex << ": expected "
+                  << graph->getDimensions() << ", got " << residual.size() << std::endl;
+        return;
+    }
+
+    graph->add(residual.data(), label);
+    m_modified = true;
+}
+
+std::vector<Neighbor> ResidualIndex::findSimilar(int layerIndex, const std::vector<float>& residual, int k) const {
+    if (layerIndex < 0 || layerIndex >= static_cast<int>(m_layers.size()) || !m_layers[layerIndex] ||
+        m_layers[layerIndex]->getDimensions() != static_cast<int>(residual.size())) {
+        return std::vector<Neighbor>();
+    }
+    return m_layers[layerIndex]->search(residual.data(), k);
+}
+
+const std::string& ResidualIndex::getTraceText(uint32_t traceId) const {
+    static const std::string empty;
+    return traceId < m_traces.size() ? m_traces[traceId] : empty;
+}
+
+size_t ResidualIndex::getRecordCount(int layerIndex) const {
+    if (layerIndex < 0 || layerIndex >= static_cast<int>(m_layers.size()) || !m_layers[layerIndex]) {
+        return 0;
+    }
+    return m_layers[layerIndex]->size();
+}
+
+bool ResidualIndex::save(const std::string& filePath) const {
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to open residual index for writing: " << filePath << std::endl;
+        return false;
+    }
+
+    file.write(kResidualMagic, sizeof(kResidualMagic));
+    writeValue(file, kResidualVersion);
+    writeValue(file, static_cast<uint32_t>(m_layers.size()));
+    writeValue(file, static_cast<uint32_t>(m_traces.size()));
+    for (const std::string& trace : m_traces) {
+        writeValue(file, static_cast<uint32_t>(trace.size()));
+        file.write(trace.data(), trace.size());
+    }
+
+    for (const auto& graph : m_layers) {
+        writeValue(file, static_cast<uint8_t>(graph ? 1 : 0));
+        if (graph) {
+            graph->write(file);
+        }
+    }
+
+    return static_cast<bool>(file);
+}
+
+bool ResidualIndex::load(const std::string& filePath) {
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+
+    char magic[8];
+    uint32_t version = 0, layerCount = 0, traceCount = 0;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, kResidualMagic, sizeof(magic)) != 0 ||
+        !readValue(file, version) || version != kResidualVersion ||
+        !readValue(file, layerCount) || layerCount != m_layers.size() ||
+        !readValue(file, traceCount)) {
+        std::cerr << "Residual index does not match the loaded model: " << filePath << std::endl;
+        return false;
+    }
+
+    // Parsed aside and swapped in only once the whole file has been read, so
+    // a failure leaves the index as it was
+    std::vector<std::string> traces(std::min<uint64_t>(traceCount, fileSize));
+    std::vector<std::unique_ptr<HnswGraph>> layers(m_layers.size());
+    bool valid = traces.size() == traceCount;
+    for (std::string& trace : traces) {
+        uint32_t length = 0;
+        if (!valid || !readValue(file, length) || length > fileSize) {
+            valid = false;
+            break;
+        }
+        trace.resize(length);
+        valid = length == 0 || static_cast<bool>(file.read(&trace[0], length));
+    }
+
+    for (auto& graph : layers) {
+        uint8_t present = 0;
+        if (!valid || !readValue(file, present)) {
+            valid = false;
+            break;
+        }
+        if (present) {
+            graph = std::make_unique<HnswGraph>(1);
+            valid = graph->read(file, fileSize);
+        }
+    }
+
+    if (!valid) {
+        std::cerr << "Corrupt residual index: " << filePath << std::endl;
+        return false;
+    }
+    m_traces.swap(traces);
+    m_layers.swap(layers);
+    m_modified = false;
+    return true;
+}
+
+} // namespace llmvis
@@ -52,6 +52,11 @@ bool Shader::loadFromFiles(const std::string& vertexShaderPath, const std::strin
 }
 
 bool Shader::loadFromSource(const std::string& vertexShaderSource, const std::string& fragmentShaderSource) {
+    return loadFromSource(vertexShaderSource, fragmentShaderSource, std::vector<std::string>());
+}
+
+bool Shader::loadFromSource(const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                            const std::vector<std::string>& feedbackVaryings) {
     GLuint vertex, fragment;
     
     // Compile vertex shader
@@ -76,6 +81,15 @@ bool Shader::loadFromSource(const std::string& vertexShaderSource, const std::st
     m_programId = glCreateProgram();
     glAttachShader(m_programId, vertex);
     glAttachShader(m_programId, fragment);
+    
+    // Captured outputs have to be named before linking
+    if (!feedbackVaryings.empty()) {
+        std::vector<const char*> names;
+        for (const std::string& varying : feedbackVaryings) {
+            names.push_back(varying.c_str());
+        }
+        glTransformFeedbackVaryings(m_programId, static_cast<GLsizei>(names.size()), names.data(), GL_INTERLEAVED_ATTRIBS);
+    }
     glLinkProgram(m_programId);
     if (!checkCompileErrors(m_programId, "PROGRAM")) {
         return false;
@@ -85,48 +99,119 @@ bool Shader::loadFromSource(const std::string& vertexShaderSource, const std::st
     glDeleteShader(vertex);
     glDeleteShader(fragment);
     
+    cacheUniformLocations();
+    
     return true;
 }
 
+void Shader::cacheUniformLocations() {
+    m_uniformLocations.clear();
+    
+    GLint uniformCount = 0;
+    glGetProgramiv(m_programId, GL_ACTIVE_UNIFORMS, &uniformCount);
+    
+    char name[256];
+    for (GLint i = 0; i < uniformCount; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_programId, static_cast<GLuint>(i), sizeof(name), &length, &size, &type, name);
+        
+        // Members of uniform blocks have no location
+        GLint location = glGetUniformLocation(m_programId, name);
+        if (location < 0) continue;
+        
+        // Arrays are reported as "name[0]"; also answer to the bare name
+        std::string uniformName(name, length);
+        m_uniformLocations[uniformName] = location;
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+            m_uniformLocations[uniformName.substr(0, uniformName.size() - 3)] = location;
+        }
+    }
+}
+
+GLint Shader::getUniformLocation(const std::string& name) const {
+    auto it = m_uniformLocations.find(name);
+    return it != m_uniformLocations.end() ? it->second : -1;
+}
+
+void Shader::bindUniformBlock(const std::string& blockName, GLuint bindingPoint) {
+    GLuint blockIndex = glGetUniformBlockIndex(m_programId, blockName.c_str());
+    if (blockIndex == GL_INVALID_INDEX) {
+        std::cerr << "Uniform block " << blockName << " not found in program" << std::endl;
+        return;
+    }
+    glUniformBlockBinding(m_programId, blockIndex, bindingPoint);
+}
+
 void Shader::use() {
     glUseProgram(m_programId);
 }
 
 void Shader::setUniform(const std::string& name, bool value) {
-    GLint location = glGetUniformLocation(m_programId, name.c_str());
-    glUniform1i(location, (int)value);
+    setUniform(getUniformLocation(name), (int)value);
 }
 
 void Shader::setUniform(const std::string& name, int value) {
-    GLint location = glGetUniformLocation(m_programId, name.c_str());
-    glUniform1i(location, value);
+    setUniform(getUniformLocation(name), value);
 }
 
 void Shader::setUniform(const std::string& name, float value) {
-    GLint location = glGetUniformLocation(m_programId, name.c_str());
-    glUniform1f(location, value);
+    setUniform(getUniformLocation(name), value);
 }
 
 void Shader::setUniform(const std::string& name, const glm::vec2& value) {
-    GLint location = glGetUniformLocation(m_programId, name.c_str());
-    glUniform2fv(location, 1, glm::value_ptr(value));
+    setUniform(getUniformLocation(name), value);
 }
 
 void Shader::setUniform(const std::string& name, const glm::vec3& value) {
-    GLint location = glGetUniformLocation(m_programId, name.c_str());
-    glUniform3fv(location, 1, glm::value_ptr(value));
+    setUniform(getUniformLocation(name), value);
 }
 
 void Shader::setUniform(const std::string& name, const glm::vec4& value) {
-    GLint location = glGetUniformLocation(m_programId, name.c_str());
-    glUniform4fv(location, 1, glm::value_ptr(value));
+    setUniform(getUniformLocation(name), value);
 }
 
 void Shader::setUniform(const std::string& name, const glm::mat4& value) {
-    GLint location = glGetUniformLocation(m_programId, name.c_str());
+    setUniform(getUniformLocation(name), value);
+}
+
+void Shader::setUniform(GLint location, int value) {
+    glUniform1i(location, value);
+}
+
+void Shader::setUniform(GLint location, unsigned int value) {
+    glUniform1ui(location, value);
+}
+
+void Shader::setUniform(GLint location, float value) {
+    glUniform1f(location, value);
+}
+
+void Shader::setUniform(GLint location, const glm::vec2& value) {
+    glUniform2fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setUniform(GLint location, const glm::vec3& value) {
+    glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setUniform(GLint location, const glm::vec4& value) {
+    glUniform4fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setUniform(GLint location, const glm::mat4& value) {
     glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
+void Shader::setUniform(GLint location, const float* values, int count) {
+    glUniform1fv(location, count, values);
+}
+
+void Shader::setUniform(GLint location, const glm::vec4* values, int count) {
+    glUniform4fv(location, count, glm::value_ptr(values[0]));
+}
+
 bool Shader::checkCompileErrors(GLuint shader, const std::string& type) {
     int success;
     char infoLog[1024];
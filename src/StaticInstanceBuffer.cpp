@@ -0,0 +1,102 @@
+#include "StaticInstanceBuffer.h"
+#include <algorithm>
+#include <limits>
+
+namespace llmvis {
+
+StaticInstanceBuffer::StaticInstanceBuffer(int geometryVectors)
+    : m_geometryVectors(std::max(geometryVectors, 1))
+    , m_geometryBuffer(0)
+    , m_colorBuffer(0)
+    , m_capacity(0)
+    , m_uploadedInstances(0)
+    , m_dirtyBegin(std::numeric_limits<int>::max())
+    , m_dirtyEnd(0)
+{
+}
+
+StaticInstanceBuffer::~StaticInstanceBuffer() {
+    if (m_geometryBuffer) {
+        glDeleteBuffers(1, &m_geometryBuffer);
+        m_geometryBuffer = 0;
+    }
+    if (m_colorBuffer) {
+        glDeleteBuffers(1, &m_colorBuffer);
+        m_colorBuffer = 0;
+    }
+}
+
+void StaticInstanceBuffer::createBuffers() {
+    if (!m_geometryBuffer) {
+        glGenBuffers(1, &m_geometryBuffer);
+        glGenBuffers(1, &m_colorBuffer);
+    }
+}
+
+int StaticInstanceBuffer::append(const glm::vec4* geometry, int count) {
+    int first = getInstanceCount();
+    m_geometry.insert(m_geometry.end(), geometry, geometry + static_cast<size_t>(count) * m_geometryVectors);
+    m_colors.resize(m_colors.size() + count, glm::vec4(0.0f));
+    m_dirtyBegin = std::min(m_dirtyBegin, first);
+    m_dirtyEnd = getInstanceCount();
+    return first;
+}
+
+void StaticInstanceBuffer::setColors(int first, const glm::vec4* colors, int count) {
+    count = std::min(count, getInstanceCount() - first);
+    for (int i = 0; i < count; i++) {
+        if (m_colors[first + i] == colors[i]) continue;
+        m_colors[first + i] = colors[i];
+        m_dirtyBegin = std::min(m_dirtyBegin, first + i);
+        m_dirtyEnd = std::max(m_dirtyEnd, first + i + 1);
+    }
+}
+
+void StaticInstanceBuffer::clear() {
+    m_geometry.clear();
+    m_colors.clear();
+    m_uploadedInstances = 0;
+    m_dirtyBegin = std::numeric_limits<int>::max();
+    m_dirtyEnd = 0;
+}
+
+size_t StaticInstanceBuffer::upload() {
+    if (!m_geometryBuffer) return 0;
+    size_t geometryStride = sizeof(glm::vec4) * m_geometryVectors;
+    size_t instances = m_colors.size();
+    size_t bytes = 0;
+
+    // Outgrown: reallocate and send everything once
+    if (instances > m_capacity) {
+        m_capacity = std::max(instances, m_capacity * 2);
+        glBindBuffer(GL_ARRAY_BUFFER, m_geometryBuffer);
+        glBufferData(GL_ARRAY_BUFFER, m_capacity * geometryStride, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, m_colorBuffer);
+        glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+        m_uploadedInstances = 0;
+        m_dirtyBegin = 0;
+        m_dirtyEnd = static_cast<int>(instances);
+    }
+
+    if (m_uploadedInstances < static_cast<int>(instances)) {
+        size_t offset = m_uploadedInstances * geometryStride;
+        glBindBuffer(GL_ARRAY_BUFFER, m_geometryBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, instances * geometryStride - offset,
+                        &m_geometry[static_cast<size_t>(m_uploadedInstances) * m_geometryVectors]);
+        bytes += instances * geometryStride - offset;
+        m_uploadedInstances = static_cast<int>(instances);
+    }
+
+    if (m_dirtyBegin < m_dirtyEnd) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_colorBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, m_dirtyBegin * sizeof(glm::vec4), (m_dirtyEnd - m_dirtyBegin) * sizeof(glm::vec4),
+                        &m_colors[m_dirtyBegin]);
+        bytes += (m_dirtyEnd - m_dirtyBegin) * sizeof(glm::vec4);
+    }
+    m_dirtyBegin = std::numeric_limits<int>::max();
+    m_dirtyEnd = 0;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return bytes;
+}
+
+} // namespace llmvis
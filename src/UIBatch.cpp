@@ -0,0 +1,92 @@
+#include "UIBatch.h"
+#include <cmath>
+
+namespace llmvis {
+
+namespace {
+
+// Screen pixels per font pixel at text scale 1
+const float kTextPixelSize = 1.5f;
+
+} // namespace
+
+UIBatch::UIBatch(const GlyphAtlas& atlas)
+    : m_atlas(atlas)
+{
+}
+
+void UIBatch::addRect(float x, float y, float width, float height, const glm::vec4& color) {
+    glm::vec2 corners[4] = {
+        glm::vec2(x, y),
+        glm::vec2(x, y + height),
+        glm::vec2(x + width, y + height),
+        glm::vec2(x + width, y)
+    };
+    glm::vec2 solid = m_atlas.getSolidTexCoord();
+    addQuad(corners, solid, solid, color);
+}
+
+void UIBatch::addLine(const glm::vec2& from, const glm::vec2& to, float width, const glm::vec4& color) {
+    glm::vec2 direction = to - from;
+    float length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+    if (length <= 0.0f) return;
+
+    // A quad widened along the segment's normal
+    glm::vec2 offset = glm::vec2(-direction.y, direction.x) * (0.5f * width / length);
+    glm::vec2 corners[4] = { from + offset, from - offset, to - offset, to + offset };
+    glm::vec2 solid = m_atlas.getSolidTexCoord();
+    addQuad(corners, solid, solid, color);
+}
+
+void UIBatch::addText(const std::string& text, const glm::vec2& position, float scale, const glm::vec4& color) {
+    // Monospace: each cell is the glyph plus its distance spread on every side
+    float pixel = kTextPixelSize * scale;
+    float pad = GlyphAtlas::kSpread * pixel;
+    float advance = GlyphAtlas::kGlyphSize * pixel;
+
+    float x = position.x;
+    for (char c : text) {
+        if (c != ' ') {
+            glm::vec2 uvMin, uvMax;
+            m_atlas.getGlyphRect(c, uvMin, uvMax);
+            glm::vec2 min(x - pad, position.y - pad);
+            glm::vec2 max(x + advance + pad, position.y + advance + pad);
+            glm::vec2 corners[4] = { min, glm::vec2(min.x, max.y), max, glm::vec2(max.x, min.y) };
+            addQuad(corners, uvMin, uvMax, color);
+        }
+        x += advance;
+    }
+}
+
+float UIBatch::measureText(const std::string& text, float scale) const {
+    return text.size() * GlyphAtlas::kGlyphSize * kTextPixelSize * scale;
+}
+
+void UIBatch::addHeatmap(unsigned int texture, float x, float y, float width, float height,
+                         const glm::vec2& uvMin, const glm::vec2& uvMax, float alpha) {
+    m_heatmaps.push_back({ texture, static_cast<int>(m_vertices.size()) });
+    glm::vec2 corners[4] = {
+        glm::vec2(x, y),
+        glm::vec2(x, y + height),
+        glm::vec2(x + width, y + height),
+        glm::vec2(x + width, y)
+    };
+    addQuad(corners, uvMin, uvMax, glm::vec4(1.0f, 1.0f, 1.0f, alpha));
+}
+
+void UIBatch::addQuad(const glm::vec2* corners, const glm::vec2& uvMin, const glm::vec2& uvMax, const glm::vec4& color) {
+    UIVertex vertices[4] = {
+        { corners[0], uvMin, color },
+        { corners[1], glm::vec2(uvMin.x, uvMax.y), color },
+        { corners[2], uvMax, color },
+        { corners[3], glm::vec2(uvMax.x, uvMin.y), color }
+    };
+    m_vertices.push_back(vertices[0]);
+    m_vertices.push_back(vertices[1]);
+    m_vertices.push_back(vertices[2]);
+    m_vertices.push_back(vertices[0]);
+    m_vertices.push_back(vertices[2]);
+    m_vertices.push_back(vertices[3]);
+}
+
+} // namespace llmvis
@@ -1,9 +1,14 @@
 #include "LLMVisualization.h"
+#include "Model.h"
+#include "ActivationIndex.h"
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <fstream>
 #include <chrono>
 #include <thread>  // Add this for sleep
 #include <signal.h>
+#include <algorithm>
+#include <cstdlib>
 
 // Global flag for clean shutdown
 volatile sig_atomic_t exitSignal = 0;
@@ -14,7 +19,68 @@ void signalHandler(int signal) {
     std::cout << "Received signal " << signal << ", initiating clean shutdown..." << std::endl;
 }
 
+// Offline pass: run every line of a corpus through the model and record the
+// top-K activating lines of each neuron. Usage:
+//   llm_visualizer --build-index <corpus.txt> <model> [topK]
+// The index is written to <model>.topk, where loadModel() looks for it.
+int buildActivationIndex(const std::string& corpusPath, const std::string& modelPath, int topK) {
+    std::ifstream corpusFile(corpusPath);
+    if (!corpusFile) {
+        std::cerr << "Failed to open corpus: " << corpusPath << std::endl;
+        return -1;
+    }
+    
+    std::vector<std::string> contexts;
+    std::string line;
+    while (std::getline(corpusFile, line)) {
+        if (!line.empty()) {
+            contexts.push_back(line);
+        }
+    }
+    
+    // Layers keep per-instance state, so every worker thread gets its own model
+    int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::unique_ptr<llmvis::Model>> models;
+    for (int i = 0; i < threadCount; i++) {
+        models.push_back(std::make_unique<llmvis::Model>());
+        models.back()->loadFromFile(modelPath);
+    }
+    
+    // Slots for exactly the activations each layer produces. Feedforward and
+    // output grids are wider than the residual they carry, so the widths are
+    // read once a context has gone through
+    if (!contexts.empty()) {
+        models[0]->processInput(contexts[0]);
+    }
+    std::vector<int> layerSizes;
+    for (int i = 0; i < models[0]->getLayerCount(); i++) {
+        layerSizes.push_back(models[0]->getLayer(i)->getActivationWidth());
+    }
+    
+    llmvis::ActivationIndexBuilder builder(layerSizes, topK);
+    builder.build(static_cast<uint32_t>(contexts.size()),
+        [&](int threadIndex, uint32_t contextId, std::vector<std::vector<float>>& activations) {
+            llmvis::Model* model = models[threadIndex].get();
+            model->processInput(contexts[contextId]);
+            for (int layer = 0; layer < model->getLayerCount(); layer++) {
+                activations[layer] = model->getLayer(layer)->getActivations();
+            }
+        },
+        threadCount);
+    
+    for (uint32_t i = 0; i < contexts.size(); i++) {
+        builder.setContextText(i, contexts[i]);
+    }
+    
+    return builder.write(modelPath + ".topk") ? 0 : -1;
+}
+
 int main(int argc, char** argv) {
+    if (argc > 3 && std::string(argv[1]) == "--build-index") {
+        int topK = argc > 4 ? std::atoi(argv[4]) : 16;
+        return buildActivationIndex(argv[2], argv[3], topK);
+    }
+    
     // Register signal handlers for clean termination
     signal(SIGINT, signalHandler);  // Ctrl+C
     signal(SIGTERM, signalHandler); // Termination request